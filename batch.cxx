@@ -0,0 +1,402 @@
+/*
+ * batch.cxx - Implementation of BatchRunner class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "batch.h"
+#include "chunk.h"	// FrameTrack, write_frame_tracks
+#include "session.h"
+#include "source.h"
+#include "stats.h"	// monotonic clock, stop requests
+#include "highgui.h"
+#include <algorithm>
+#include <dirent.h>
+#include <iomanip>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+// types
+class DirectorySource : public FrameSource{
+  /* The images of one directory with the given extension, in name
+     order, DIRECTORY_FPS apart. */
+ public:
+  DirectorySource();
+  ~DirectorySource();
+
+  bool open(const string& directory, const string& format); // false when there are no images
+  IplImage* next_frame(double& timestamp);
+  const string& unreadable() const; // image that ended the source early, if any
+
+ private:
+  vector<string> files;
+  size_t at;
+  IplImage* frame;
+  string _unreadable;
+};
+
+DirectorySource::DirectorySource(){
+  at = 0;
+  frame = NULL;
+}
+
+DirectorySource::~DirectorySource(){
+  if (frame)
+    cvReleaseImage(&frame);
+}
+
+bool DirectorySource::open(const string& directory, const string& format){
+  DIR* dir = opendir(directory.c_str());
+  if (!dir)
+    return false;
+
+  struct dirent* entry;
+  while ((entry = readdir(dir))){
+    string name = entry->d_name;
+    if (name.size() > format.size() &&
+        name.compare(name.size() - format.size(), format.size(), format) == 0)
+      files.push_back(directory + "/" + name);
+  }
+  closedir(dir);
+
+  sort(files.begin(), files.end());
+  return !files.empty();
+}
+
+IplImage* DirectorySource::next_frame(double& timestamp){
+  if (frame)
+    cvReleaseImage(&frame);
+  if (at >= files.size())
+    return NULL;
+
+  frame = cvLoadImage(files[at].c_str(), 1);
+  if (!frame){
+    _unreadable = files[at];
+    return NULL;
+  }
+  timestamp = at / DIRECTORY_FPS;
+  ++at;
+  return frame;
+}
+
+const string& DirectorySource::unreadable() const{
+  return _unreadable;
+}
+
+BatchStatus::BatchStatus(){
+  state = PENDING;
+  frames = 0;
+  seconds = 0.0;
+}
+
+// Constructors
+
+BatchRunner::BatchRunner(const TrackerOptions& options_, int workers, const string& image_format){
+  options = options_;
+  worker_count = MAX(workers, 1);
+  format = image_format;
+  next = 0;
+  seconds = 0.0;
+}
+
+// Action Functions
+
+bool BatchRunner::read_manifest(const string& file){
+  ifstream in(file.c_str());
+  if (!in)
+    return false;
+
+  string line;
+  while (getline(in, line)){
+    istringstream fields(line);
+    BatchJob job;
+    if (!(fields >> job.input) || job.input[0] == '#')
+      continue;
+    if (!(fields >> job.output))
+      return false;
+    _jobs.push_back(job);
+  }
+
+  _status.assign(_jobs.size(), BatchStatus());
+  return !_jobs.empty();
+}
+
+bool BatchRunner::run(const string& journal_file){
+  vector<size_t> crashed;
+  resume(journal_file, crashed);
+
+  journal.open(journal_file.c_str(), ios::out | ios::app);
+  if (!journal)
+    return false;
+  journal << setprecision(3) << fixed;
+  ifstream tail(journal_file.c_str(), ios::in | ios::binary);
+  if (tail.seekg(-1, ios::end) && tail.get() != '\n')
+    journal << endl; // a line cut short must not run into the next one
+  for (size_t i = 0; i < crashed.size(); ++i){
+    write_journal("crashed", crashed[i], &_status[crashed[i]]);
+  }
+
+  // the pool is no bigger than the jobs left to run
+  long pending = 0;
+  for (size_t i = 0; i < _status.size(); ++i){
+    if (_status[i].state == BatchStatus::PENDING)
+      ++pending;
+  }
+  int count = (int)MIN((long)worker_count, pending);
+  vector<Worker> workers(count);
+  for (int i = 0; i < count; ++i){
+    workers[i].owner = this;
+    workers[i].tracker = new Tracker(options);
+  }
+
+  double start = monotonic_seconds();
+  next = 0;
+  pthread_mutex_init(&lock, NULL);
+  vector<bool> started(count, false);
+  for (int i = 1; i < count; ++i){
+    started[i] = pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]) == 0;
+  }
+  if (count > 0)
+    run_worker(&workers[0]); // this thread is a worker too, the only one if none started
+  for (int i = 1; i < count; ++i){
+    if (started[i])
+      pthread_join(workers[i].thread, NULL);
+  }
+  pthread_mutex_destroy(&lock);
+  seconds = monotonic_seconds() - start;
+
+  for (int i = 0; i < count; ++i){
+    delete workers[i].tracker;
+  }
+  journal.close();
+  return true;
+}
+
+void BatchRunner::resume(const string& journal_file, vector<size_t>& crashed){
+  // the last line journaled for a job says how far it got
+  ifstream in(journal_file.c_str());
+  vector<string> last(_jobs.size());
+  vector<int> crashes(_jobs.size(), 0); // since the job last ended
+  vector<BatchStatus> ended(_jobs.size());
+  string line;
+  while (getline(in, line)){
+    istringstream fields(line);
+    string event, input, error;
+    size_t job;
+    BatchStatus status;
+    if (!getline(fields, event, '\t') || !(fields >> job >> status.frames >> status.seconds) ||
+        !fields.ignore(1) || !getline(fields, input, '\t'))
+      continue; // cut short when the process died
+    getline(fields, status.error);
+    if (job >= _jobs.size() || input != _jobs[job].input)
+      continue; // from another manifest
+    if (event == "crashed")
+      ++crashes[job];
+    else if (event != "start")
+      crashes[job] = 0;
+    last[job] = event;
+    ended[job] = status;
+  }
+
+  struct stat info;
+  for (size_t i = 0; i < _jobs.size(); ++i){
+    if (last[i] == "ok" && stat(_jobs[i].output.c_str(), &info) == 0){
+      _status[i] = ended[i];
+      _status[i].state = BatchStatus::RESUMED;
+    }
+    else if (last[i] == "start" || last[i] == "crashed"){
+      if (last[i] == "start"){
+        crashed.push_back(i);
+        ++crashes[i];
+      }
+      if (crashes[i] > CRASH_RETRIES){
+        _status[i].state = BatchStatus::FAILED;
+        _status[i].error = "crashed an earlier run";
+      }
+    }
+  }
+}
+
+void* BatchRunner::run_worker(void* arg){
+  Worker* worker = static_cast<Worker*>(arg);
+  BatchRunner* runner = worker->owner;
+  while (!stop_signaled()){
+    pthread_mutex_lock(&runner->lock);
+    size_t i = runner->next;
+    while (i < runner->_jobs.size() && runner->_status[i].state != BatchStatus::PENDING){
+      ++i;
+    }
+    runner->next = i + 1;
+    if (i < runner->_jobs.size())
+      runner->write_journal("start", i);
+    pthread_mutex_unlock(&runner->lock);
+    if (i >= runner->_jobs.size())
+      break;
+
+    BatchStatus status;
+    runner->process(*worker->tracker, runner->_jobs[i], status);
+
+    pthread_mutex_lock(&runner->lock);
+    runner->_status[i] = status;
+    runner->write_journal(status.state == BatchStatus::DONE ? "ok" :
+                          status.state == BatchStatus::FAILED ? "failed" : "stopped",
+                          i, &status);
+    pthread_mutex_unlock(&runner->lock);
+  }
+  return NULL;
+}
+
+void BatchRunner::process(Tracker& tracker, const BatchJob& job, BatchStatus& status) const{
+  // one sequence through the worker's tracker, from a clean start;
+  // status stays PENDING when a stop was asked for
+  double start = monotonic_seconds();
+  tracker.set_options(options);
+  tracker.restart();
+
+  SessionReplay session(false);
+  DirectorySource directory;
+  FrameSource* source;
+  struct stat info;
+  if (stat(job.input.c_str(), &info) == 0 && S_ISDIR(info.st_mode)){
+    if (!directory.open(job.input, format)){
+      status.state = BatchStatus::FAILED;
+      status.error = "no *" + format + " images";
+      return;
+    }
+    tracker.set_flow(true); // no keys come with images to switch them on
+    tracker.set_track(true);
+    source = &directory;
+  }
+  else if (session.open(job.input)){
+    source = &session;
+  }
+  else{
+    status.state = BatchStatus::FAILED;
+    status.error = "could not read input";
+    return;
+  }
+
+  vector<FrameTrack> tracks;
+  TrackResult result;
+  int track = -1, next_track = 0;
+  IplImage* frame;
+  double timestamp;
+  char key;
+  while ((frame = source->next_frame(timestamp))){
+    if (stop_signaled())
+      return;
+    if (!tracker.process(frame_view(frame, timestamp), result)){
+      status.state = BatchStatus::FAILED;
+      status.error = "unusable frame";
+      return;
+    }
+
+    // a new track whenever tracking starts or moves to another segment
+    if (!result.tracking)
+      track = -1;
+    else if (track < 0 || result.focus_changed)
+      track = next_track++;
+
+    FrameTrack t;
+    t.frame = ++status.frames;
+    t.timestamp = timestamp;
+    t.tracking = result.tracking;
+    t.box = result.track_box;
+    t.track = track;
+    tracks.push_back(t);
+
+    while (source->next_key(key)){
+      tracker.command(key);
+    }
+  }
+  if (!directory.unreadable().empty()){
+    status.state = BatchStatus::FAILED;
+    status.error = "could not read " + directory.unreadable();
+    return;
+  }
+
+  // written aside and renamed, an output that exists is complete
+  string temp = job.output + ".tmp";
+  if (!write_frame_tracks(temp, tracks) || rename(temp.c_str(), job.output.c_str()) != 0){
+    remove(temp.c_str());
+    status.state = BatchStatus::FAILED;
+    status.error = "could not write output";
+    return;
+  }
+
+  status.state = BatchStatus::DONE;
+  status.seconds = monotonic_seconds() - start;
+}
+
+void BatchRunner::write_journal(const string& event, size_t job, const BatchStatus* status){
+  // event job frames seconds input error, tab separated; called with lock held
+  journal << event << "\t" << job << "\t"
+          << (status ? status->frames : 0) << "\t"
+          << (status ? status->seconds : 0.0) << "\t"
+          << _jobs[job].input << "\t"
+          << (status ? status->error : "") << endl;
+}
+
+void BatchRunner::print_report(ostream& out) const{
+  int done = 0, resumed = 0, failed = 0, pending = 0;
+  long frames = 0;
+  double busy = 0.0;
+  out << endl << setprecision(3) << fixed;
+  for (size_t i = 0; i < _jobs.size(); ++i){
+    const BatchStatus& s = _status[i];
+    out << "    * " << _jobs[i].input << " -> " << _jobs[i].output << "\t";
+    switch (s.state){
+      case BatchStatus::DONE:
+        ++done;
+        frames += s.frames;
+        busy += s.seconds;
+        out << s.frames << " frames in " << s.seconds << "s\t[OK]";
+        break;
+      case BatchStatus::RESUMED:
+        ++resumed;
+        out << "done by an earlier run\t[OK]";
+        break;
+      case BatchStatus::FAILED:
+        ++failed;
+        out << s.error << "\t[FAIL]";
+        break;
+      default:
+        ++pending;
+        out << "not run";
+        break;
+    }
+    out << endl;
+  }
+
+  out << "  * " << "Batch of " << _jobs.size() << " jobs on " << worker_count
+      << " workers in " << seconds << "s: " << done << " done, " << resumed
+      << " done before, " << failed << " failed, " << pending << " not run" << endl;
+  if (busy > 0.0)
+    out << "    * " << frames << " frames, " << frames / busy << " fps per worker, "
+        << (seconds > 0.0 ? frames / seconds : 0.0) << " fps overall" << endl;
+}
+
+// Access Functions
+
+const vector<BatchJob>& BatchRunner::jobs() const{
+  return _jobs;
+}
+
+const vector<BatchStatus>& BatchRunner::status() const{
+  return _status;
+}
+
+int BatchRunner::failed() const{
+  int count = 0;
+  for (size_t i = 0; i < _status.size(); ++i){
+    if (_status[i].state == BatchStatus::FAILED)
+      ++count;
+  }
+  return count;
+}
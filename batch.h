@@ -0,0 +1,117 @@
+/*
+ * batch.h - Manifest-driven processing of many sequences
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+// includes
+#include "tracker.h"
+#include "cv.h"
+#include <pthread.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+// constants
+const double DIRECTORY_FPS = 30.0;	// frame rate assumed for image directories
+const int CRASH_RETRIES = 1;	// runs again of a job that took the process down
+
+// types
+struct BatchJob{
+  /* One line of the manifest:
+
+       input  output
+
+     The input is a session recorded with satori -R, or a directory of
+     images processed in name order.  The output gets the tracks, one
+     line per frame as in a chunked replay.  Blank lines and lines
+     starting with # are skipped.
+  */
+  string input;
+  string output;
+};
+
+struct BatchStatus{
+  BatchStatus();
+
+  enum State{ PENDING, DONE, FAILED, RESUMED };
+  State state; // RESUMED jobs were done by an earlier run
+  long frames;
+  double seconds; // wall time of the job
+  string error; // why it failed
+};
+
+class BatchRunner{
+  /* Runs every job of a manifest on a pool of worker threads.  Each
+     worker has one Tracker for all its jobs, restarted between them, so
+     its buffers are allocated once and not once per sequence.
+
+     A job that cannot be read or written fails on its own; the others
+     carry on.  Outputs are written aside and renamed, so an output that
+     exists is complete.
+
+     Progress goes to a journal, one line as each job starts and one as
+     it ends.  Running the same manifest with the same journal again
+     skips the jobs it lists as done, as long as their output is still
+     there, and retries the ones that failed.
+     A job that started but never ended took the whole process down; it
+     is journaled as crashed and tried again CRASH_RETRIES times, then
+     failed.  Jobs stopped by SIGINT or SIGTERM are journaled as such and
+     run again.
+  */
+ public:
+  BatchRunner(const TrackerOptions&, int workers, const string& image_format);
+
+  bool read_manifest(const string& file);
+  bool run(const string& journal_file); // false when the journal can't be written
+  void print_report(ostream&) const;
+
+  // Access Functions
+  const vector<BatchJob>& jobs() const;
+  const vector<BatchStatus>& status() const;
+  int failed() const; // jobs that failed in this run or the ones before
+
+ private:
+  struct Worker{
+    BatchRunner* owner;
+    Tracker* tracker;
+    pthread_t thread;
+  };
+
+  TrackerOptions options;
+  int worker_count;
+  string format; // extension of images in directory inputs
+  vector<BatchJob> _jobs;
+  vector<BatchStatus> _status;
+  size_t next; // next job to hand out
+  double seconds; // wall time of the run
+  ofstream journal;
+  pthread_mutex_t lock; // next, journal
+
+  // methods
+  void resume(const string& journal_file, vector<size_t>& crashed);
+  static void* run_worker(void*);
+  void process(Tracker&, const BatchJob&, BatchStatus&) const;
+  void write_journal(const string& event, size_t job, const BatchStatus* status = NULL);
+
+  // not copyable
+  BatchRunner(const BatchRunner&);
+  BatchRunner& operator=(const BatchRunner&);
+};
+
+#endif
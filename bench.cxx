@@ -0,0 +1,634 @@
+/*
+ * bench.cxx - Component and pipeline benchmarks over synthetic scenes
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * Every benchmark runs the same deterministic SyntheticScene at each
+ * resolution and times only the component under test; rendering and
+ * any set up work are left out of the measurement.  Results are written
+ * one tab separated line per benchmark and resolution, always in the
+ * same order and with the same columns, so two runs can be diffed:
+ *
+ *   name  width  height  iterations  mean_us  p50_us  p95_us  max_us  checksum
+ *
+ * The checksum is derived from the component's output (point counts,
+ * segment counts, box positions, ...) and only changes when behavior
+ * changes, not when speed does.
+ *
+ * The track.match benchmarks time the compact motion history and check
+ * its segments against the float one frame by frame; their checksum is
+ * the number of frames that matched, and any mismatch fails the run.
+ * Stamps keep the exact time of their frame, so both see the same ages,
+ * but cvSegmentMotion() grows segments with cvFloodFill(), which also
+ * stops at neighbors much newer than the pixel they are reached from
+ * and fills in another order.  Where segments of different ages touch,
+ * a few edge pixels can go to the other one, so segments are matched
+ * largest first with a rect overlap of MATCH_IOU and an area within
+ * MATCH_AREA of each other; a missing, extra or split segment fails
+ * either bound.
+ * track.match_tiled does the same for segmentation in bands on
+ * TILED_THREADS cores against cvSegmentMotion(), and fails the run the
+ * same way.
+ *
+ * track.match_bands holds segmentation in bands to the single pass it
+ * stands in for: one 16 bit CompactHistory is segmented in one pass and
+ * in bands on 1 to MAX_BAND_THREADS cores, and every banded list must
+ * have the same segments, in the same order, with the same rect and
+ * area.  It times the banded passes; its checksum is the number of
+ * banded lists that matched, and any mismatch fails the run.
+ *
+ * tracker.keyframes runs a whole Tracker with flow off and keyframes
+ * KEY_INTERVAL frames apart, timing every frame; its checksum is the
+ * number of keyframes that found motion, and a keyframe that found
+ * none fails the run.
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "synth.h"
+#include "flow.h"
+#include "track.h"
+#include "focus.h"
+#include "history.h"
+#include "segment.h"
+#include "tracker.h"
+#include "stats.h"
+#include <iomanip>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <unistd.h>
+
+// constants
+static const CvSize RESOLUTIONS[] = {
+  {320, 240}, {640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160}
+};
+static const int NUM_RESOLUTIONS = sizeof(RESOLUTIONS) / sizeof(RESOLUTIONS[0]);
+static const double FRAME_RATE = 30.0;	// timestamps of synthetic frames
+static const int WARMUP_FRAMES = 3;	// frames run before timing starts
+static const double MATCH_IOU = 0.9;	// segment overlap counted as the same segment
+static const double MATCH_AREA = 0.1;	// area difference, of the larger, counted as the same segment
+static const int TILED_THREADS = 4;	// cores of the track.tiled benchmarks
+static const int MAX_BAND_THREADS = 8;	// most cores of track.match_bands
+static const int KEY_INTERVAL = 4;	// frames between keyframes of tracker.keyframes
+
+// frames where the compact motion history disagreed with the float one
+static long segment_mismatches = 0;
+// frames where segmenting in bands disagreed with cvSegmentMotion()
+static long tiled_mismatches = 0;
+// banded segment lists that differed from a single pass over the same history
+static long band_mismatches = 0;
+// keyframes of a whole tracker that found no motion
+static long keyframe_misses = 0;
+
+// settings shared by all benchmarks
+struct BenchConfig{
+  int frames;		// timed frames per benchmark
+  int objects;		// moving blobs in the scene
+  float speed;		// blob speed in pixels per frame at 640 wide
+  unsigned int seed;	// scene seed
+};
+
+// frames of a scene rendered outside of the timed region
+class BenchFrames{
+ public:
+  BenchFrames(SyntheticScene& scene_) : scene(scene_){
+    color = cvCreateImage(scene.size(), IPL_DEPTH_8U, 3);
+    context.prepare(scene.size());
+  }
+  ~BenchFrames(){
+    cvReleaseImage(&color);
+  }
+
+  void load(int index){
+    scene.render(index, color);
+    context.set_frame(color, index / FRAME_RATE);
+  }
+
+  SyntheticScene& scene;
+  IplImage *color;
+  FrameContext context;
+};
+
+// the processing done by SatoriApp::run_webcam, minus display
+class BenchPipeline{
+ public:
+  BenchPipeline(const CvSize& size){
+    flow.prepare(size);
+    track.prepare(size);
+    focus.prepare(size);
+    focus_time = NULL;
+  }
+
+  void process(FrameContext& frame, int index){
+    // keep a useful number of points alive, as a user pressing 'f' would
+    if (flow.point_count() < MAX_POINTS_TO_TRACK / 4)
+      flow.init(frame);
+    else
+      flow.pair_flow(frame);
+
+    track.update(frame);
+    if (index == WARMUP_FRAMES - 1)
+      track.reset(flow);
+
+    double started = monotonic_seconds();
+    bool changed = false;
+    focus.update(&track.track_box(), track.segments(), flow.grid(),
+                 frame, false, changed);
+    if (changed)
+      track.reset(focus.focus_area(), flow);
+    if (focus_time)
+      focus_time->add(monotonic_seconds() - started);
+  }
+
+  Flow flow;
+  Track track;
+  Focus focus;
+  LatencyHistogram* focus_time;	// when set, times focus updates only
+};
+
+// Benchmarks
+
+static long bench_flow(SyntheticScene& scene, const BenchConfig& config,
+                       LatencyHistogram& hist){
+  BenchFrames frames(scene);
+  Flow flow;
+  long checksum = 0;
+
+  frames.load(0);
+  flow.init(frames.context);
+  for (int i = 1; i <= config.frames; ++i){
+    frames.load(i);
+    frames.context.gray(); // conversion is not part of flow
+
+    double started = monotonic_seconds();
+    flow.pair_flow(frames.context);
+    hist.add(monotonic_seconds() - started);
+
+    checksum += flow.point_count();
+  }
+
+  return checksum;
+}
+
+static long run_segment(SyntheticScene& scene, const BenchConfig& config,
+                        LatencyHistogram& hist, int depth, int threads = 1){
+  BenchFrames frames(scene);
+  Track track;
+  track.set_history_depth(depth);
+  track.set_threads(threads);
+  long checksum = 0;
+
+  for (int i = 0; i < WARMUP_FRAMES + config.frames; ++i){
+    frames.load(i);
+
+    double started = monotonic_seconds();
+    track.update_motion_segments(frames.context);
+    if (i >= WARMUP_FRAMES){
+      hist.add(monotonic_seconds() - started);
+      checksum += track.segments()->total;
+    }
+  }
+
+  return checksum;
+}
+
+static long bench_segment(SyntheticScene& scene, const BenchConfig& config,
+                          LatencyHistogram& hist){
+  return run_segment(scene, config, hist, IPL_DEPTH_32F);
+}
+
+static long bench_segment16(SyntheticScene& scene, const BenchConfig& config,
+                            LatencyHistogram& hist){
+  return run_segment(scene, config, hist, IPL_DEPTH_16U);
+}
+
+static long bench_segment8(SyntheticScene& scene, const BenchConfig& config,
+                           LatencyHistogram& hist){
+  return run_segment(scene, config, hist, IPL_DEPTH_8U);
+}
+
+static long bench_tiled(SyntheticScene& scene, const BenchConfig& config,
+                        LatencyHistogram& hist){
+  return run_segment(scene, config, hist, IPL_DEPTH_32F, TILED_THREADS);
+}
+
+static long bench_tiled16(SyntheticScene& scene, const BenchConfig& config,
+                          LatencyHistogram& hist){
+  return run_segment(scene, config, hist, IPL_DEPTH_16U, TILED_THREADS);
+}
+
+static long bench_masked(SyntheticScene& scene, const BenchConfig& config,
+                         LatencyHistogram& hist){
+  // the right half and the top rows of the frame are excluded
+  IplImage* mask = cvCreateImage(scene.size(), IPL_DEPTH_8U, 1);
+  cvZero(mask);
+  cvRectangle(mask, cvPoint(0, scene.size().height / 8),
+              cvPoint(scene.size().width / 2, scene.size().height), cvScalarAll(255), CV_FILLED);
+
+  BenchFrames frames(scene);
+  Track track;
+  track.set_mask(mask);
+  long checksum = 0;
+
+  for (int i = 0; i < WARMUP_FRAMES + config.frames; ++i){
+    frames.load(i);
+
+    double started = monotonic_seconds();
+    track.update_motion_segments(frames.context);
+    if (i >= WARMUP_FRAMES){
+      hist.add(monotonic_seconds() - started);
+      checksum += track.segments()->total;
+    }
+  }
+
+  cvReleaseImage(&mask);
+  return checksum;
+}
+
+static int larger_comp(const void* a, const void* b, void*){
+  double diff = ((const CvConnectedComp*)b)->area - ((const CvConnectedComp*)a)->area;
+  return diff > 0 ? 1 : diff < 0 ? -1 : 0;
+}
+
+static bool same_segments(CvSeq* a, CvSeq* b){
+  // the same segments, largest first, each overlapping its counterpart
+  // and close to its area
+  if (a->total != b->total)
+    return false;
+
+  cvSeqSort(a, larger_comp, 0);
+  cvSeqSort(b, larger_comp, 0);
+  for (int i = 0; i < a->total; ++i){
+    const CvConnectedComp* x = (const CvConnectedComp*)cvGetSeqElem(a, i);
+    const CvConnectedComp* y = (const CvConnectedComp*)cvGetSeqElem(b, i);
+    if (rect_iou(x->rect, y->rect) < MATCH_IOU ||
+        fabs(x->area - y->area) > MATCH_AREA * MAX(x->area, y->area))
+      return false;
+  }
+  return true;
+}
+
+static long run_match(SyntheticScene& scene, const BenchConfig& config,
+                      LatencyHistogram& hist, int depth, int threads = 1,
+                      long& mismatches = segment_mismatches){
+  BenchFrames frames(scene);
+  Track exact, compact;
+  compact.set_history_depth(depth);
+  compact.set_threads(threads);
+  long matched = 0;
+
+  for (int i = 0; i < WARMUP_FRAMES + config.frames; ++i){
+    frames.load(i);
+    exact.update_motion_segments(frames.context);
+
+    double started = monotonic_seconds();
+    compact.update_motion_segments(frames.context);
+    if (i >= WARMUP_FRAMES){
+      hist.add(monotonic_seconds() - started);
+      if (same_segments(exact.segments(), compact.segments()))
+        ++matched;
+      else
+        ++mismatches;
+    }
+  }
+
+  return matched;
+}
+
+static long bench_match16(SyntheticScene& scene, const BenchConfig& config,
+                          LatencyHistogram& hist){
+  return run_match(scene, config, hist, IPL_DEPTH_16U);
+}
+
+static long bench_match8(SyntheticScene& scene, const BenchConfig& config,
+                         LatencyHistogram& hist){
+  return run_match(scene, config, hist, IPL_DEPTH_8U);
+}
+
+static long bench_match_tiled(SyntheticScene& scene, const BenchConfig& config,
+                              LatencyHistogram& hist){
+  return run_match(scene, config, hist, IPL_DEPTH_32F, TILED_THREADS, tiled_mismatches);
+}
+
+static bool identical_segments(CvSeq* a, CvSeq* b){
+  // the same segments in the same order, exactly
+  if (a->total != b->total)
+    return false;
+
+  for (int i = 0; i < a->total; ++i){
+    const CvConnectedComp* x = (const CvConnectedComp*)cvGetSeqElem(a, i);
+    const CvConnectedComp* y = (const CvConnectedComp*)cvGetSeqElem(b, i);
+    if (x->area != y->area || x->rect.x != y->rect.x || x->rect.y != y->rect.y ||
+        x->rect.width != y->rect.width || x->rect.height != y->rect.height)
+      return false;
+  }
+  return true;
+}
+
+static long bench_match_bands(SyntheticScene& scene, const BenchConfig& config,
+                              LatencyHistogram& hist){
+  // frame differences into one history, segmented in one pass and in bands
+  BenchFrames frames(scene);
+  TrackParams params;
+  CompactHistory history;
+  history.set_depth(IPL_DEPTH_16U);
+  history.prepare(scene.size());
+  IplImage* silh = cvCreateImage(scene.size(), IPL_DEPTH_8U, 1);
+  CvMemStorage* storage = cvCreateMemStorage(0);
+  BandSegmenter bands;
+  WorkerPool workers;
+  long matched = 0;
+
+  for (int i = 0; i < WARMUP_FRAMES + config.frames; ++i){
+    frames.load(i);
+    IplImage* prev = frames.context.gray_ago(GRAY_HISTORY);
+    IplImage* curr = frames.context.gray();
+    if (prev){
+      cvAbsDiff(prev, curr, silh);
+      cvThreshold(silh, silh, params.diff_threshold, 1, CV_THRESH_BINARY);
+    }
+    else{
+      cvZero(silh);
+    }
+    history.update(silh, frames.context.timestamp(), params.mhi_duration);
+    if (i < WARMUP_FRAMES)
+      continue;
+
+    cvClearMemStorage(storage);
+    CvSeq* single = history.segment(storage, params.max_time_delta);
+    for (int threads = 1; threads <= MAX_BAND_THREADS; ++threads){
+      workers.set_threads(threads);
+      double started = monotonic_seconds();
+      CvSeq* banded = history.segment(storage, params.max_time_delta, bands, workers);
+      hist.add(monotonic_seconds() - started);
+      if (identical_segments(single, banded))
+        ++matched;
+      else
+        ++band_mismatches;
+    }
+  }
+
+  cvReleaseMemStorage(&storage);
+  cvReleaseImage(&silh);
+  return matched;
+}
+
+static long bench_camshift(SyntheticScene& scene, const BenchConfig& config,
+                           LatencyHistogram& hist){
+  BenchFrames frames(scene);
+  Track track;
+  long checksum = 0;
+
+  for (int i = 0; i < WARMUP_FRAMES + config.frames; ++i){
+    frames.load(i);
+    track.update_motion_segments(frames.context);
+
+    double started = monotonic_seconds();
+    track.update_camshift(frames.context);
+    if (i >= WARMUP_FRAMES){
+      hist.add(monotonic_seconds() - started);
+      checksum += cvRound(track.track_box().center.x) + cvRound(track.track_box().center.y);
+    }
+    else if (i == WARMUP_FRAMES - 1){
+      track.reset();
+    }
+  }
+
+  return checksum;
+}
+
+static long bench_focus(SyntheticScene& scene, const BenchConfig& config,
+                        LatencyHistogram& hist){
+  BenchFrames frames(scene);
+  BenchPipeline pipeline(scene.size());
+  long checksum = 0;
+
+  for (int i = 0; i < WARMUP_FRAMES + config.frames; ++i){
+    frames.load(i);
+    pipeline.focus_time = i >= WARMUP_FRAMES ? &hist : NULL;
+    pipeline.process(frames.context, i);
+    if (i >= WARMUP_FRAMES)
+      checksum += pipeline.focus.candidates().size();
+  }
+
+  return checksum;
+}
+
+static long bench_intersect(SyntheticScene& scene, const BenchConfig& config,
+                            LatencyHistogram& hist){
+  // the mask intersection of two moving objects, as the old Focus did
+  IplImage* x = cvCreateImage(scene.size(), IPL_DEPTH_8U, 1);
+  IplImage* y = cvCreateImage(scene.size(), IPL_DEPTH_8U, 1);
+  IplImage* dst = cvCreateImage(scene.size(), IPL_DEPTH_8U, 1);
+  int other = scene.object_count() > 1 ? 1 : 0;
+  long checksum = 0;
+
+  for (int i = 0; i < config.frames; ++i){
+    CvPoint corners[4];
+    cvZero(x);
+    cvZero(y);
+    if (scene.object_count() > 0){
+      rect_to_points(scene.object_rect(0, i), corners);
+      cvFillConvexPoly(x, corners, 4, cvScalar(255));
+      rect_to_points(scene.object_rect(other, i), corners);
+      cvFillConvexPoly(y, corners, 4, cvScalar(255));
+    }
+
+    float area = 0.f, x_amt = 0.f, y_amt = 0.f;
+    double started = monotonic_seconds();
+    intersect_amount(x, y, dst, area, x_amt, y_amt);
+    hist.add(monotonic_seconds() - started);
+
+    checksum += (long)area;
+  }
+
+  cvReleaseImage(&x);
+  cvReleaseImage(&y);
+  cvReleaseImage(&dst);
+  return checksum;
+}
+
+static long bench_pipeline(SyntheticScene& scene, const BenchConfig& config,
+                           LatencyHistogram& hist){
+  BenchFrames frames(scene);
+  BenchPipeline pipeline(scene.size());
+  long checksum = 0;
+
+  for (int i = 0; i < WARMUP_FRAMES + config.frames; ++i){
+    frames.load(i);
+
+    double started = monotonic_seconds();
+    pipeline.process(frames.context, i);
+    if (i >= WARMUP_FRAMES){
+      hist.add(monotonic_seconds() - started);
+      checksum += pipeline.flow.point_count() + pipeline.track.segments()->total;
+    }
+  }
+
+  return checksum;
+}
+
+static long bench_keyframes(SyntheticScene& scene, const BenchConfig& config,
+                            LatencyHistogram& hist){
+  // segments only come from keyframes, so every one of them must have
+  // the gray images it differences against even when flow is off
+  TrackerOptions options;
+  options.track = true;
+  options.flow = false;
+  options.keyframe_interval = KEY_INTERVAL;
+  options.adaptive_keyframes = false;
+  Tracker tracker(options);
+  IplImage* color = cvCreateImage(scene.size(), IPL_DEPTH_8U, 3);
+  TrackResult result;
+  long checksum = 0;
+
+  for (int i = 0; i < WARMUP_FRAMES + config.frames; ++i){
+    scene.render(i, color);
+    long keyframes = tracker.keyframes().keyframes;
+
+    double started = monotonic_seconds();
+    tracker.process(frame_view(color, i / FRAME_RATE), result);
+    if (i >= WARMUP_FRAMES){
+      hist.add(monotonic_seconds() - started);
+      if (tracker.keyframes().keyframes == keyframes)
+        continue;
+      if (result.segments.empty())
+        ++keyframe_misses;
+      else
+        ++checksum;
+    }
+  }
+
+  cvReleaseImage(&color);
+  return checksum;
+}
+
+// table of benchmarks, in output order
+typedef long (*BenchFunction)(SyntheticScene&, const BenchConfig&, LatencyHistogram&);
+
+struct Benchmark{
+  const char* name;
+  BenchFunction run;
+};
+
+static const Benchmark BENCHMARKS[] = {
+  {"flow.pair_flow", bench_flow},
+  {"track.segment", bench_segment},
+  {"track.segment16", bench_segment16},
+  {"track.segment8", bench_segment8},
+  {"track.tiled", bench_tiled},
+  {"track.tiled16", bench_tiled16},
+  {"track.masked", bench_masked},
+  {"track.match16", bench_match16},
+  {"track.match8", bench_match8},
+  {"track.match_tiled", bench_match_tiled},
+  {"track.match_bands", bench_match_bands},
+  {"track.camshift", bench_camshift},
+  {"focus.update", bench_focus},
+  {"common.intersect_amount", bench_intersect},
+  {"tracker.keyframes", bench_keyframes},
+  {"pipeline", bench_pipeline}
+};
+static const int NUM_BENCHMARKS = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+static int display_bench_syntax(){
+  cout << endl;
+  cout << "satori_bench: Time satori's components on synthetic scenes." << endl;
+  cout << endl;
+  cout << "Syntax: satori_bench [-n frames -o objects -v speed -s seed -r WxH -b name]" << endl;
+  cout << "  " << "-n (frames)" << ": Timed frames per benchmark (default 30)" << endl;
+  cout << "  " << "-o (objects)" << ": Moving objects in the scene (default 3)" << endl;
+  cout << "  " << "-v (speed)" << ": Object speed in pixels per frame at 640x480 (default 4)" << endl;
+  cout << "  " << "-s (seed)" << ": Scene seed (default 1)" << endl;
+  cout << "  " << "-r (WxH)" << ": Only run at the given resolution" << endl;
+  cout << "  " << "-b (name)" << ": Only run benchmarks whose name starts with name" << endl;
+  cout << "  " << "-?" << ": Display this screen" << endl;
+  cout << endl;
+
+  return 0;
+}
+
+int main(int argc, char *argv[]){
+  BenchConfig config;
+  config.frames = 30;
+  config.objects = 3;
+  config.speed = 4.f;
+  config.seed = 1;
+  CvSize only_size = cvSize(0, 0);
+  string only_bench;
+
+  int optchar;
+  while((optchar = getopt(argc, argv, "n:o:v:s:r:b:?")) != -1){
+    switch(optchar){
+      case 'n':
+        config.frames = atoi(optarg);
+        break;
+      case 'o':
+        config.objects = atoi(optarg);
+        break;
+      case 'v':
+        config.speed = (float)atof(optarg);
+        break;
+      case 's':
+        config.seed = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        if (sscanf(optarg, "%dx%d", &only_size.width, &only_size.height) != 2)
+          return display_bench_syntax();
+        break;
+      case 'b':
+        only_bench = optarg;
+        break;
+      default:
+      case '?':
+        return display_bench_syntax();
+    }
+  }
+
+  cout << "# name\twidth\theight\titerations\tmean_us\tp50_us\tp95_us\tmax_us\tchecksum" << endl;
+  cout << setprecision(1) << fixed;
+
+  for (int r = 0; r < NUM_RESOLUTIONS; ++r){
+    CvSize size = RESOLUTIONS[r];
+    if (only_size.width && (size.width != only_size.width || size.height != only_size.height))
+      continue;
+
+    SyntheticScene scene(size, config.objects, config.speed, config.seed);
+
+    for (int b = 0; b < NUM_BENCHMARKS; ++b){
+      if (only_bench.compare(0, only_bench.size(), BENCHMARKS[b].name, only_bench.size()) != 0)
+        continue;
+
+      LatencyHistogram hist;
+      long checksum = BENCHMARKS[b].run(scene, config, hist);
+
+      cout << BENCHMARKS[b].name << "\t" << size.width << "\t" << size.height
+           << "\t" << hist.count()
+           << "\t" << (hist.count() ? hist.total() / hist.count() * 1e6 : 0.0)
+           << "\t" << hist.percentile(0.50) * 1e6
+           << "\t" << hist.percentile(0.95) * 1e6
+           << "\t" << hist.max() * 1e6
+           << "\t" << checksum << endl;
+    }
+  }
+
+  if (tiled_mismatches > 0)
+    cerr << "[ERROR] Motion segments found in bands differ from a single pass in "
+         << tiled_mismatches << " frames" << endl;
+  if (segment_mismatches > 0)
+    cerr << "[ERROR] Compact motion history segments differ from float ones in "
+         << segment_mismatches << " frames" << endl;
+  if (band_mismatches > 0)
+    cerr << "[ERROR] Motion segments found in bands differ from a single pass over the same history in "
+         << band_mismatches << " lists" << endl;
+  if (keyframe_misses > 0)
+    cerr << "[ERROR] Keyframes of a tracker with flow off found no motion "
+         << keyframe_misses << " times" << endl;
+  if (tiled_mismatches > 0 || segment_mismatches > 0 || band_mismatches > 0 || keyframe_misses > 0)
+    return 1;
+
+  return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * capture.cxx - Implementation of CaptureThread class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "capture.h"
+
+// Constructors
+
+CaptureThread::CaptureThread(FrameSource& source_, int queue_depth) : source(source_){
+  depth = MAX(queue_depth, 1);
+  running = false;
+  done = false;
+  stopping = false;
+  _dropped = 0;
+  source_size = source.frame_size();
+  _captured = 0;
+  held.frame = NULL;
+  held.timestamp = 0.0;
+  holding = false;
+
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&ready, NULL);
+
+  // buffers are sized on the first frame
+  for (int i = 0; i < depth + 2; ++i){
+    Slot slot;
+    slot.frame = NULL;
+    slot.timestamp = 0.0;
+    free_slots.push_back(slot);
+  }
+}
+
+CaptureThread::~CaptureThread(){
+  stop();
+
+  for (size_t i = 0; i < free_slots.size(); ++i){
+    if (free_slots[i].frame)
+      cvReleaseImage(&free_slots[i].frame);
+  }
+  for (size_t i = 0; i < waiting.size(); ++i){
+    if (waiting[i].frame)
+      cvReleaseImage(&waiting[i].frame);
+  }
+  if (holding && held.frame)
+    cvReleaseImage(&held.frame);
+
+  pthread_cond_destroy(&ready);
+  pthread_mutex_destroy(&lock);
+}
+
+// Action Functions
+
+bool CaptureThread::start(){
+  if (running)
+    return true;
+
+  running = pthread_create(&thread, NULL, run_thread, this) == 0;
+  return running;
+}
+
+void CaptureThread::stop(){
+  if (!running)
+    return;
+
+  pthread_mutex_lock(&lock);
+  stopping = true;
+  pthread_mutex_unlock(&lock);
+
+  pthread_join(thread, NULL);
+  running = false;
+}
+
+void* CaptureThread::run_thread(void* self){
+  static_cast<CaptureThread*>(self)->capture_loop();
+  return NULL;
+}
+
+void CaptureThread::capture_loop(){
+  pthread_mutex_lock(&lock);
+  Slot filling = free_slots.back();
+  free_slots.pop_back();
+  pthread_mutex_unlock(&lock);
+
+  for (;;){
+    double timestamp;
+    IplImage* frame = source.next_frame(timestamp);
+
+    pthread_mutex_lock(&lock);
+    bool stop_now = stopping || !frame;
+    pthread_mutex_unlock(&lock);
+    if (stop_now)
+      break;
+
+    // copy out of the source's buffer before it is reused
+    if (!filling.frame || filling.frame->width != frame->width ||
+        filling.frame->height != frame->height ||
+        filling.frame->nChannels != frame->nChannels){
+      if (filling.frame)
+        cvReleaseImage(&filling.frame);
+      filling.frame = cvCreateImage(cvGetSize(frame), frame->depth, frame->nChannels);
+    }
+    filling.frame->origin = frame->origin;
+    cvCopy(frame, filling.frame, 0);
+    filling.timestamp = timestamp;
+
+    pthread_mutex_lock(&lock);
+    ++_captured;
+    waiting.push_back(filling);
+
+    // make room for the next frame, dropping the oldest waiting frame
+    // when the queue is full
+    if ((int)waiting.size() > depth){
+      filling = waiting.front();
+      waiting.pop_front();
+      ++_dropped;
+    }
+    else{
+      filling = free_slots.back();
+      free_slots.pop_back();
+    }
+
+    pthread_cond_signal(&ready);
+    pthread_mutex_unlock(&lock);
+  }
+
+  pthread_mutex_lock(&lock);
+  free_slots.push_back(filling);
+  done = true;
+  pthread_cond_signal(&ready);
+  pthread_mutex_unlock(&lock);
+}
+
+IplImage* CaptureThread::next_frame(double& timestamp){
+  if (!running && !done && !start())
+    return NULL;
+
+  pthread_mutex_lock(&lock);
+  while (waiting.empty() && !done){
+    pthread_cond_wait(&ready, &lock);
+  }
+
+  if (waiting.empty()){
+    pthread_mutex_unlock(&lock);
+    return NULL;
+  }
+
+  // the frame handed out last time is free again
+  if (holding)
+    free_slots.push_back(held);
+  held = waiting.front();
+  holding = true;
+  waiting.pop_front();
+  pthread_mutex_unlock(&lock);
+
+  timestamp = held.timestamp;
+  return held.frame;
+}
+
+// Access Functions
+
+bool CaptureThread::interactive() const{
+  return source.interactive();
+}
+
+CvSize CaptureThread::frame_size() const{
+  return source_size;
+}
+
+long CaptureThread::dropped() const{
+  pthread_mutex_lock(&lock);
+  long count = _dropped;
+  pthread_mutex_unlock(&lock);
+  return count;
+}
+
+long CaptureThread::captured() const{
+  pthread_mutex_lock(&lock);
+  long count = _captured;
+  pthread_mutex_unlock(&lock);
+  return count;
+}
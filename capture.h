@@ -0,0 +1,80 @@
+/*
+ * capture.h - Background capture keeping only the freshest frames
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+// includes
+#include "common.h"
+#include "source.h"
+#include "cv.h"
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+class CaptureThread : public FrameSource{
+  /* Reads another source on its own thread so capture never waits on
+     processing.  At most queue_depth frames are kept; when a new frame
+     arrives and the queue is full the oldest waiting frame is dropped
+     and counted.  With the default depth of one, next_frame() always
+     returns the newest frame captured since the last call.
+
+     depth + 2 buffers are used: one being filled by the capture thread,
+     up to depth waiting, and the one last handed to the caller.
+  */
+ public:
+  CaptureThread(FrameSource& source, int queue_depth = 1);
+  ~CaptureThread();
+
+  bool start();
+  void stop();
+
+  IplImage* next_frame(double& timestamp); // blocks until a frame is ready
+  long dropped() const; // frames captured but never handed out
+  long captured() const; // frames read from the source
+  bool interactive() const;
+  CvSize frame_size() const;
+
+ private:
+  struct Slot{
+    IplImage* frame;
+    double timestamp;
+  };
+
+  FrameSource& source;
+  CvSize source_size; // asked before the thread owns the source
+  int depth;
+  pthread_t thread;
+  bool running; // thread has been started
+  mutable pthread_mutex_t lock;
+  pthread_cond_t ready;
+
+  // guarded by lock
+  deque<Slot> waiting; // captured, not yet handed out, oldest first
+  vector<Slot> free_slots;
+  Slot held; // handed out by the last next_frame()
+  bool holding; // whether held is in use
+  bool done; // source ran dry or stop() was called
+  bool stopping;
+  long _dropped, _captured;
+
+  // methods
+  static void* run_thread(void*);
+  void capture_loop();
+};
+
+#endif
@@ -0,0 +1,317 @@
+/*
+ * chunk.cxx - Implementation of ChunkedReplay class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "chunk.h"
+#include "session.h"
+#include "stats.h"	// monotonic clock, signals
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <unistd.h>
+
+// constants
+static const double STITCH_IOU = 0.5;	// box overlap for two tracks to be one object
+static const int PROGRESS_POLL_MS = 100;	// how often the chunks are checked on for SIGUSR1
+
+StitchReport::StitchReport(){
+  chunks = 0;
+  boundaries = 0;
+  stitched = 0;
+  overlap_iou = 0.0;
+  seconds = 0.0;
+  compared = 0;
+  agreed = 0;
+  sequential_seconds = 0.0;
+}
+
+void StitchReport::print(ostream& out) const{
+  out << endl << "  * " << "Processed in " << chunks << " chunks in "
+      << setprecision(3) << fixed << seconds << "s" << endl;
+  out << "    * " << stitched << " of " << boundaries << " tracked boundaries stitched";
+  if (stitched > 0)
+    out << ", mean overlap IoU " << overlap_iou;
+  out << endl;
+
+  if (compared > 0){
+    out << "    * " << "Sequential run took " << sequential_seconds << "s ("
+        << (seconds > 0.0 ? sequential_seconds / seconds : 0.0) << "x)" << endl;
+    out << "    * " << agreed << " of " << compared << " frames agree with it ("
+        << 100.0 * agreed / compared << "%)" << endl;
+  }
+}
+
+// Constructors
+
+ChunkedReplay::ChunkedReplay(const TrackerOptions& options_, int chunks_, long overlap_){
+  options = options_;
+  chunk_count = MAX(chunks_, 1);
+  overlap = MAX(overlap_, 0L);
+}
+
+// Action Functions
+
+bool ChunkedReplay::run(const string& session_file){
+  // count frames without reading their pixels
+  SessionReplay counter(false);
+  if (!counter.open(session_file))
+    return false;
+  long frames = 0;
+  double timestamp;
+  while (counter.skip_frame(timestamp)){
+    ++frames;
+  }
+  if (frames == 0)
+    return false;
+
+  // equal chunks, each starting overlap frames early
+  int count = (int)MIN((long)chunk_count, frames);
+  long length = (frames + count - 1) / count;
+  vector<Chunk> chunks(count);
+  for (int i = 0; i < count; ++i){
+    Chunk& chunk = chunks[i];
+    chunk.owner = this;
+    chunk.file = session_file;
+    chunk.first = 1 + i * length;
+    chunk.end = MIN(chunk.first + length, frames + 1);
+    chunk.warm = MAX(chunk.first - overlap, 1L);
+    chunk.ok = false;
+    chunk.done = 0;
+    chunk.finished = false;
+  }
+
+  double start = monotonic_seconds();
+  vector<bool> started(count, false);
+  for (int i = 0; i < count; ++i){
+    started[i] = pthread_create(&chunks[i].thread, NULL, run_chunk, &chunks[i]) == 0;
+    if (!started[i])
+      run_chunk(&chunks[i]); // no thread to spare, run it here
+  }
+
+  // this thread answers SIGUSR1 while the chunks run
+  bool running = true;
+  while (running){
+    if (stats_signaled())
+      print_progress(cout, chunks);
+    running = false;
+    for (int i = 0; i < count; ++i){
+      running = running || !chunks[i].finished;
+    }
+    if (running)
+      usleep(PROGRESS_POLL_MS * 1000);
+  }
+  for (int i = 0; i < count; ++i){
+    if (started[i])
+      pthread_join(chunks[i].thread, NULL);
+  }
+
+  _report = StitchReport();
+  _report.chunks = count;
+  _report.seconds = monotonic_seconds() - start;
+  for (int i = 0; i < count; ++i){
+    if (!chunks[i].ok)
+      return false;
+  }
+
+  stitch(chunks);
+  return true;
+}
+
+bool ChunkedReplay::run_sequential(const string& session_file){
+  vector<FrameTrack> sequential;
+  double start = monotonic_seconds();
+  if (!process(session_file, 1, -1, sequential))
+    return false;
+  _report.sequential_seconds = monotonic_seconds() - start;
+
+  // frames agree when neither run tracks, or both do on overlapping boxes
+  _report.compared = MIN(sequential.size(), _tracks.size());
+  _report.agreed = 0;
+  for (long i = 0; i < _report.compared; ++i){
+    const FrameTrack& a = sequential[i];
+    const FrameTrack& b = _tracks[i];
+    if (!a.tracking && !b.tracking)
+      ++_report.agreed;
+    else if (a.tracking && b.tracking &&
+             rect_iou(box_rect(a.box), box_rect(b.box)) >= STITCH_IOU)
+      ++_report.agreed;
+  }
+
+  return true;
+}
+
+bool write_frame_tracks(const string& file, const vector<FrameTrack>& tracks){
+  ofstream out(file.c_str());
+  if (!out)
+    return false;
+
+  out << "# frame timestamp track center_x center_y width height angle" << endl;
+  out << setprecision(3) << fixed;
+  for (size_t i = 0; i < tracks.size(); ++i){
+    const FrameTrack& t = tracks[i];
+    out << t.frame << " " << t.timestamp << " " << t.track << " "
+        << t.box.center.x << " " << t.box.center.y << " "
+        << t.box.size.width << " " << t.box.size.height << " "
+        << t.box.angle << endl;
+  }
+
+  return out.good();
+}
+
+bool ChunkedReplay::write_tracks(const string& file) const{
+  return write_frame_tracks(file, _tracks);
+}
+
+void* ChunkedReplay::run_chunk(void* arg){
+  Chunk* chunk = static_cast<Chunk*>(arg);
+  chunk->ok = chunk->owner->process(chunk->file, chunk->warm, chunk->end, chunk->tracks,
+                                    &chunk->done);
+  chunk->finished = true;
+  return NULL;
+}
+
+void ChunkedReplay::print_progress(ostream& out, const vector<Chunk>& chunks) const{
+  out << endl << "  * " << "Chunked replay progress" << endl;
+  for (size_t i = 0; i < chunks.size(); ++i){
+    const Chunk& c = chunks[i];
+    out << "    * " << "Chunk " << i << ": " << c.done << " of " << c.end - c.warm
+        << " frames" << (c.finished ? ", finished" : "") << endl;
+  }
+}
+
+bool ChunkedReplay::process(const string& file, long warm, long end,
+                            vector<FrameTrack>& tracks, volatile long* done) const{
+  // frames [warm, end) through a fresh tracker, end < 0 for all of them;
+  // tracks are numbered from 0 within this run.  Without a progress
+  // counter this runs on the calling thread and answers SIGUSR1 itself
+  SessionReplay session(false);
+  if (!session.open(file))
+    return false;
+
+  Tracker tracker(options);
+  char key;
+  double timestamp;
+  long index = 0;
+
+  // earlier keys still decide what is switched on
+  while (index + 1 < warm && session.skip_frame(timestamp)){
+    ++index;
+    while (session.next_key(key)){
+      tracker.command(key);
+    }
+  }
+
+  TrackResult result;
+  int track = -1, next_track = 0;
+  IplImage* frame;
+  while ((end < 0 || index + 1 < end) && (frame = session.next_frame(timestamp))){
+    if (stop_signaled())
+      return false;
+    ++index;
+    tracker.process(frame_view(frame, timestamp), result);
+    if (done)
+      *done = index - warm + 1;
+    else if (stats_signaled())
+      tracker.stats().print(cout);
+
+    // a new track whenever tracking starts or moves to another segment
+    if (!result.tracking)
+      track = -1;
+    else if (track < 0 || result.focus_changed)
+      track = next_track++;
+
+    FrameTrack t;
+    t.frame = index;
+    t.timestamp = timestamp;
+    t.tracking = result.tracking;
+    t.box = result.track_box;
+    t.track = track;
+    tracks.push_back(t);
+
+    while (session.next_key(key)){
+      tracker.command(key);
+    }
+  }
+
+  return true;
+}
+
+void ChunkedReplay::stitch(vector<Chunk>& chunks){
+  // give tracks session-wide numbers, carrying a track over a boundary
+  // when both chunks followed the same object through the overlap
+  _tracks.clear();
+  int next_track = 0;
+  double iou_total = 0.0;
+
+  for (size_t c = 0; c < chunks.size(); ++c){
+    Chunk& chunk = chunks[c];
+    map<int, int> numbers; // chunk track -> session track
+
+    if (c > 0){
+      Chunk& prev = chunks[c - 1];
+      long last = chunk.first - 1; // last frame of the previous chunk
+      const FrameTrack* before = NULL;
+      const FrameTrack* after = NULL;
+      if (last >= prev.warm && last - prev.warm < (long)prev.tracks.size())
+        before = &prev.tracks[last - prev.warm];
+      if (last >= chunk.warm && last - chunk.warm < (long)chunk.tracks.size())
+        after = &chunk.tracks[last - chunk.warm];
+
+      bool tracked = (before && before->tracking) || (after && after->tracking);
+      if (tracked)
+        ++_report.boundaries;
+
+      if (before && after && before->tracking && after->tracking){
+        // compare the overlap frames both runs spent on these two tracks
+        double iou = 0.0;
+        int frames = 0;
+        long from = MAX(chunk.warm, prev.warm);
+        for (long f = from; f < chunk.first; ++f){
+          const FrameTrack& p = prev.tracks[f - prev.warm];
+          const FrameTrack& n = chunk.tracks[f - chunk.warm];
+          if (p.track != before->track || n.track != after->track)
+            continue;
+          iou += rect_iou(box_rect(p.box), box_rect(n.box));
+          ++frames;
+        }
+
+        if (frames > 0 && iou / frames >= STITCH_IOU){
+          numbers[after->track] = _tracks.back().track;
+          ++_report.stitched;
+          iou_total += iou / frames;
+        }
+      }
+    }
+
+    // keep the chunk's own frames
+    for (size_t i = chunk.first - chunk.warm; i < chunk.tracks.size(); ++i){
+      FrameTrack t = chunk.tracks[i];
+      if (t.track >= 0){
+        map<int, int>::iterator found = numbers.find(t.track);
+        if (found == numbers.end())
+          found = numbers.insert(make_pair(t.track, next_track++)).first;
+        t.track = found->second;
+      }
+      _tracks.push_back(t);
+    }
+  }
+
+  if (_report.stitched > 0)
+    _report.overlap_iou = iou_total / _report.stitched;
+}
+
+// Access Functions
+
+const vector<FrameTrack>& ChunkedReplay::tracks() const{
+  return _tracks;
+}
+
+const StitchReport& ChunkedReplay::report() const{
+  return _report;
+}
@@ -0,0 +1,112 @@
+/*
+ * chunk.h - Chunk-parallel processing of one recorded session
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _CHUNK_H_
+#define _CHUNK_H_
+
+// includes
+#include "tracker.h"
+#include "cv.h"
+#include <pthread.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+// types
+struct FrameTrack{
+  /* The object followed in one frame. */
+  long frame; // 1 for the first frame of the session
+  double timestamp;
+  bool tracking;
+  CvBox2D box;
+  int track; // stays the same while one object is followed, -1 when idle
+};
+
+// one line per frame: frame timestamp track center_x center_y width height angle
+bool write_frame_tracks(const string& file, const vector<FrameTrack>&);
+
+struct StitchReport{
+  StitchReport();
+  void print(ostream&) const;
+
+  int chunks;
+  int boundaries; // chunk boundaries with a track on either side
+  int stitched; // of those, tracks matched across the overlap
+  double overlap_iou; // mean box overlap of the stitched boundaries
+  double seconds; // wall time of the chunked run
+
+  // against a sequential run, when one was made
+  long compared; // frames compared
+  long agreed; // both idle, or both tracking with overlapping boxes
+  double sequential_seconds;
+};
+
+class ChunkedReplay{
+  /* Splits a recorded session into chunks processed by their own
+     Tracker on their own thread.  Each chunk starts overlap frames
+     before its first frame so the motion history and CAMSHIFT are warm
+     when its own frames begin; keys recorded before that are applied
+     without processing frames, so every chunk runs with the options the
+     session had at that point.
+
+     Tracks are stitched at each boundary by comparing the boxes both
+     chunks found in the overlap: when the previous chunk's track and the
+     next chunk's warmed-up track overlap well enough, they are one.
+
+     SIGINT and SIGTERM stop every chunk, failing the run; SIGUSR1
+     prints how far each chunk got.
+  */
+ public:
+  ChunkedReplay(const TrackerOptions&, int chunks, long overlap);
+
+  bool run(const string& session_file); // chunked, in parallel
+  bool run_sequential(const string& session_file); // reference run, compared with the chunked one
+  bool write_tracks(const string& file) const; // one line per frame
+
+  // Access Functions
+  const vector<FrameTrack>& tracks() const; // stitched, one per frame
+  const StitchReport& report() const;
+
+ private:
+  struct Chunk{
+    const ChunkedReplay* owner;
+    string file;
+    long warm; // first frame processed
+    long first; // first frame kept
+    long end; // one past the last frame
+    vector<FrameTrack> tracks; // from warm on
+    bool ok;
+    volatile long done; // frames processed so far
+    volatile bool finished;
+    pthread_t thread;
+  };
+
+  TrackerOptions options;
+  int chunk_count;
+  long overlap;
+  vector<FrameTrack> _tracks;
+  StitchReport _report;
+
+  // methods
+  static void* run_chunk(void*);
+  bool process(const string& file, long warm, long end, vector<FrameTrack>&,
+               volatile long* done = NULL) const; // false when stopped
+  void print_progress(ostream&, const vector<Chunk>&) const;
+  void stitch(vector<Chunk>&);
+};
+
+#endif
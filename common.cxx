@@ -62,3 +62,69 @@ void rect_to_points(const CvRect& rect, CvPoint points[]){
   points[2] = cvPoint(rect.x+rect.width, rect.y+rect.height);
   points[3] = cvPoint(rect.x, rect.y+rect.height);
 }
+
+bool point_in_convex_poly(const CvPoint* v, int n, int x, int y){
+  // true when (x,y) is inside or on the border of the convex polygon v,
+  // whichever way it is wound
+  int sign = 0;
+  for (int i = 0; i < n; ++i){
+    const CvPoint& a = v[i];
+    const CvPoint& b = v[(i + 1) % n];
+    long cross = (long)(b.x - a.x) * (y - a.y) - (long)(b.y - a.y) * (x - a.x);
+    if (cross == 0)
+      continue;
+    int s = cross > 0 ? 1 : -1;
+    if (sign == 0)
+      sign = s;
+    else if (s != sign)
+      return false;
+  }
+  return true;
+}
+
+CvSize scale_size(const CvSize& size, double scale){
+  return cvSize(MAX(cvRound(size.width * scale), 1),
+                MAX(cvRound(size.height * scale), 1));
+}
+
+CvPoint2D32f scale_point(const CvPoint2D32f& pt, double scale){
+  return cvPoint2D32f(pt.x * scale, pt.y * scale);
+}
+
+CvRect scale_rect(const CvRect& rect, double scale){
+  // scale the corners so adjoining rects stay adjoining
+  int x0 = cvRound(rect.x * scale), y0 = cvRound(rect.y * scale);
+  int x1 = cvRound((rect.x + rect.width) * scale);
+  int y1 = cvRound((rect.y + rect.height) * scale);
+  return cvRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+CvBox2D scale_box(const CvBox2D& box, double scale){
+  CvBox2D scaled = box;
+  scaled.center = scale_point(box.center, scale);
+  scaled.size.width = (float)(box.size.width * scale);
+  scaled.size.height = (float)(box.size.height * scale);
+  return scaled;
+}
+
+CvRect box_rect(const CvBox2D& box){
+  CvPoint2D32f v[4];
+  cvBoxPoints(box, v);
+
+  float x0 = v[0].x, x1 = v[0].x, y0 = v[0].y, y1 = v[0].y;
+  for (int i = 1; i < 4; ++i){
+    x0 = MIN(x0, v[i].x);
+    x1 = MAX(x1, v[i].x);
+    y0 = MIN(y0, v[i].y);
+    y1 = MAX(y1, v[i].y);
+  }
+  return cvRect(cvFloor(x0), cvFloor(y0), cvCeil(x1) - cvFloor(x0), cvCeil(y1) - cvFloor(y0));
+}
+
+double rect_iou(const CvRect& a, const CvRect& b){
+  int x0 = MAX(a.x, b.x), y0 = MAX(a.y, b.y);
+  int x1 = MIN(a.x + a.width, b.x + b.width), y1 = MIN(a.y + a.height, b.y + b.height);
+  double inter = (x1 > x0 && y1 > y0) ? (double)(x1 - x0) * (y1 - y0) : 0.0;
+  double uni = (double)a.width * a.height + (double)b.width * b.height - inter;
+  return uni > 0.0 ? inter / uni : 0.0;
+}
@@ -15,7 +15,6 @@ using namespace std;
 const bool DEFAULT_VERBOSITY = true;	// assume verbose
 const int MAX_POINTS_TO_TRACK = 500;	// maximum number of points to track
 const int WINDOW_SIZE = 5;	// size of neighborhood about a pixel to determine corners
-static CvSize FRAME_SIZE = cvSize(640, 480);
 
 #define IMAGE_CONSISTENCY_FAILED -1;
 #define NO_IMAGES -2;
@@ -26,5 +25,16 @@ void draw_points(CvPoint2D32f*, int, IplImage*, const CvScalar&);
 void intersect_amount(IplImage*, IplImage*, IplImage*, 
                       float&, float&, float&);
 void rect_to_points(const CvRect& rect, CvPoint points[]);
+bool point_in_convex_poly(const CvPoint*, int, int, int);
+
+// mapping between processing scales
+CvSize scale_size(const CvSize&, double); // rounded, never below 1x1
+CvPoint2D32f scale_point(const CvPoint2D32f&, double);
+CvRect scale_rect(const CvRect&, double);
+CvBox2D scale_box(const CvBox2D&, double);
+
+// comparing results
+CvRect box_rect(const CvBox2D&); // upright bounding rectangle
+double rect_iou(const CvRect&, const CvRect&); // intersection over union, 0 when both empty
 
 #endif
@@ -0,0 +1,168 @@
+/*
+ * control.cxx - Implementation of CommandChannel class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ */
+
+#include "control.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char ESC_KEY = 27;
+
+int listen_unix(const string& path){
+  struct sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path))
+    return -1;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(path.c_str()); // a stale socket from an earlier run
+
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0){
+    close(fd);
+    return -1;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+char command_key(const string& line){
+  // strip surrounding white space
+  size_t first = line.find_first_not_of(" \t\r");
+  if (first == string::npos)
+    return 0;
+  string word = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+
+  if (word == "flow" || word == "f")
+    return 'f';
+  if (word == "track" || word == "t")
+    return 't';
+  if (word == "reset" || word == "r")
+    return 'r';
+  if (word == "points" || word == "p")
+    return 'p';
+  if (word == "quit" || word == "q")
+    return ESC_KEY;
+
+  return 0;
+}
+
+// Constructors
+
+CommandChannel::CommandChannel(){
+  stdin_fd = -1;
+  listen_fd = -1;
+}
+
+CommandChannel::~CommandChannel(){
+  for (size_t i = 0; i < clients.size(); ++i){
+    close(clients[i]);
+  }
+  if (listen_fd >= 0){
+    close(listen_fd);
+    unlink(socket_path.c_str());
+  }
+}
+
+// Action Functions
+
+bool CommandChannel::listen_stdin(){
+  stdin_fd = STDIN_FILENO;
+  return true;
+}
+
+bool CommandChannel::listen_socket(const string& path){
+  listen_fd = listen_unix(path);
+  if (listen_fd < 0)
+    return false;
+
+  socket_path = path;
+  return true;
+}
+
+void CommandChannel::read_fd(int fd, string& buffer, bool& closed){
+  char data[256];
+  ssize_t n = read(fd, data, sizeof(data));
+  closed = n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR);
+  if (n <= 0)
+    return;
+
+  buffer.append(data, n);
+
+  // complete lines become commands
+  size_t end;
+  while ((end = buffer.find('\n')) != string::npos){
+    char key = command_key(buffer.substr(0, end));
+    if (key)
+      pending += key;
+    buffer.erase(0, end + 1);
+  }
+}
+
+bool CommandChannel::poll(char& key){
+  if (pending.empty()){
+    // new clients
+    if (listen_fd >= 0){
+      int client;
+      while ((client = accept(listen_fd, NULL, NULL)) >= 0){
+        fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+        clients.push_back(client);
+        partial.push_back("");
+      }
+    }
+
+    // one pollfd per client, then stdin
+    vector<struct pollfd> fds;
+    for (size_t i = 0; i < clients.size(); ++i){
+      struct pollfd p = {clients[i], POLLIN, 0};
+      fds.push_back(p);
+    }
+    if (stdin_fd >= 0){
+      struct pollfd p = {stdin_fd, POLLIN, 0};
+      fds.push_back(p);
+    }
+
+    if (!fds.empty() && ::poll(&fds[0], fds.size(), 0) > 0){
+      for (int i = (int)fds.size() - 1; i >= 0; --i){
+        if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+          continue;
+
+        bool is_stdin = fds[i].fd == stdin_fd;
+        bool closed = false;
+        read_fd(fds[i].fd, is_stdin ? stdin_partial : partial[i], closed);
+        if (!closed)
+          continue;
+
+        if (is_stdin){
+          stdin_fd = -1; // end of input, keep running
+        }
+        else{
+          close(clients[i]);
+          clients.erase(clients.begin() + i);
+          partial.erase(partial.begin() + i);
+        }
+      }
+    }
+  }
+
+  if (pending.empty())
+    return false;
+
+  key = pending[0];
+  pending.erase(0, 1);
+  return true;
+}
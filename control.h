@@ -0,0 +1,57 @@
+/*
+ * control.h - Commands for headless runs over stdin or a Unix socket
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ */
+
+#ifndef _CONTROL_H_
+#define _CONTROL_H_
+
+// includes
+#include <string>
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+class CommandChannel{
+  /* Collects the same commands the highgui window takes as keys, one per
+     line, from stdin and/or clients of a Unix stream socket.  A line may
+     be the key itself ("f") or its name:
+
+       flow   (f)   toggle flow processing and feature tracking
+       track  (t)   toggle motion segmentation and object identification
+       reset  (r)   find and track a moving object
+       points (p)   use point density and count in tracking decision
+       quit         stop processing (ESC)
+
+     poll() never blocks, so it can be called once per frame.
+  */
+ public:
+  CommandChannel();
+  ~CommandChannel();
+
+  bool listen_stdin();
+  bool listen_socket(const string& path);
+
+  bool poll(char& key); // next pending command, false when there is none
+
+ private:
+  int stdin_fd; // -1 when not read or at end of file
+  int listen_fd; // -1 when there is no socket
+  string socket_path;
+  vector<int> clients;
+  vector<string> partial; // unterminated input per client
+  string stdin_partial; // unterminated input from stdin
+  string pending; // parsed commands not yet returned
+
+  // methods
+  void read_fd(int fd, string& buffer, bool& closed);
+};
+
+int listen_unix(const string& path); // listening socket at path, or -1
+char command_key(const string& line); // key for a command line, 0 if unknown
+
+#endif
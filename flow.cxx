@@ -9,7 +9,20 @@
  */
 
 #include "flow.h" 	// flow header file
+#include "pool.h"	// recycled frame buffers
+#include "snapshot.h"	// checkpoints
 #include "img_template.tpl"	// provides efficient access to pixels
+#include <string.h>
+#include <algorithm>
+
+// orders point indices by x, ties by index
+struct ByX{
+    const CvPoint2D32f* points;
+    ByX(const CvPoint2D32f* p) : points(p){}
+    bool operator()(int a, int b) const{
+        return points[a].x < points[b].x || (points[a].x == points[b].x && a < b);
+    }
+};
 
 // Constructors
 
@@ -18,68 +31,317 @@ Flow::Flow(){
 
     // set up state of machine
     flow_pixels = NULL;
+    eig = NULL;
+    temp = NULL;
     _point_count = 0;
-    lk_flags = 0;
+    grid_scale = 1.0;
+    set_params(TrackParams());
 
     // set up state of machine for new run
     prev_points = (CvPoint2D32f*)cvAlloc(MAX_POINTS_TO_TRACK*sizeof(prev_points[0]));	// initially NULL
     points = (CvPoint2D32f*)cvAlloc(MAX_POINTS_TO_TRACK*sizeof(points[0]));	// initially NULL
     flow_pixels = (char*)cvAlloc(MAX_POINTS_TO_TRACK);		// initially NULL
+
+    // trajectories of the points
+    _ids = (int*)cvAlloc(MAX_POINTS_TO_TRACK*sizeof(_ids[0]));
+    ages = (int*)cvAlloc(MAX_POINTS_TO_TRACK*sizeof(ages[0]));
+    trails = (CvPoint2D32f*)cvAlloc(MAX_POINTS_TO_TRACK*TRAIL_LENGTH*sizeof(trails[0]));
+    trail_head = 0;
+    next_id = 0;
 }
 
 Flow::~Flow(){
     // Destructor
+    cvFree(&prev_points);
+    cvFree(&points);
+    cvFree(&flow_pixels);
+    cvFree(&_ids);
+    cvFree(&ages);
+    cvFree(&trails);
+    ImagePool::shared().release(eig);
+    ImagePool::shared().release(temp);
 }
 
 // Action Functions
-void Flow::init(IplImage *initial_img){
+void Flow::prepare(const CvSize& size){
+    // scratch images for feature detection and the point index
+    exclusion.prepare(size);
+    if (eig && eig->width == size.width && eig->height == size.height)
+        return;
+
+    ImagePool& pool = ImagePool::shared();
+    pool.release(eig);
+    pool.release(temp);
+    eig = pool.acquire(size, IPL_DEPTH_32F, 1);
+    temp = pool.acquire(size, IPL_DEPTH_32F, 1);
+    _grid.prepare(scale_size(size, grid_scale), MAX_POINTS_TO_TRACK);
+}
+
+void Flow::set_grid_scale(double scale){
+    // the grid lives in the coordinates of whoever queries it
+    grid_scale = scale;
+}
+
+void Flow::set_params(const TrackParams& params){
+    // buffers hold MAX_POINTS_TO_TRACK points, fewer may be asked for
+    window_size = MAX(params.window_size, 3);
+    max_points = MIN(MAX(params.max_points, 1), MAX_POINTS_TO_TRACK);
+    quality = params.feature_quality;
+    min_distance = params.feature_distance;
+    cluster_radius = params.cluster_radius;
+    cluster_velocity = params.cluster_velocity;
+    cluster_min_speed = params.cluster_min_speed;
+    cluster_min_points = MAX(params.cluster_min_points, 1);
+}
+
+void Flow::set_mask(const IplImage* mask){
+    exclusion.set_source(mask);
+}
+
+void Flow::init(FrameContext& frame){
     // get initial set for feature detection
-    IplImage* eig = cvCreateImage(cvGetSize(initial_img), 32, 1);
-    IplImage* temp = cvCreateImage(cvGetSize(initial_img), 32, 1);
-    double quality = 0.01;
-    double min_distance = 10;
-    _point_count = MAX_POINTS_TO_TRACK;
-
-    // detect features to track
-    cvGoodFeaturesToTrack(initial_img, eig, temp, points, &_point_count, 
-                          quality, min_distance, 0, 3, 0, 0.04);
+    IplImage* initial_img = frame.gray();
+    prepare(frame.size());
+    _point_count = max_points;
+
+    // detect features to track, only within the kept part of a mask
+    if (!exclusion.active()){
+        cvGoodFeaturesToTrack(initial_img, eig, temp, points, &_point_count, 
+                              quality, min_distance, 0, 3, 0, 0.04);
+    }
+    else if (exclusion.bounds().width > 0 && exclusion.bounds().height > 0){
+        const CvRect& area = exclusion.bounds();
+        IplImage* mask = const_cast<IplImage*>(exclusion.image());
+        cvSetImageROI(initial_img, area);
+        cvSetImageROI(eig, area);
+        cvSetImageROI(temp, area);
+        cvSetImageROI(mask, area);
+        cvGoodFeaturesToTrack(initial_img, eig, temp, points, &_point_count, 
+                              quality, min_distance, mask, 3, 0, 0.04);
+        cvResetImageROI(initial_img);
+        cvResetImageROI(eig);
+        cvResetImageROI(temp);
+        cvResetImageROI(mask);
+        for (int i = 0; i < _point_count; i++){
+            points[i].x += area.x;
+            points[i].y += area.y;
+        }
+    }
+    else{
+        _point_count = 0;
+    }
     cvFindCornerSubPix(initial_img, points, _point_count, 
-                       cvSize(WINDOW_SIZE,WINDOW_SIZE), cvSize(-1,-1), 
+                       cvSize(window_size,window_size), cvSize(-1,-1), 
                        cvTermCriteria(CV_TERMCRIT_ITER|CV_TERMCRIT_EPS,20,0.03));
+    start_trails();
+
+    // index points for region queries
+    _grid.build(points, _point_count, scale_size(frame.size(), grid_scale), grid_scale);
+}
+
+void Flow::pair_flow(FrameContext& frame){
+    IplImage* curr = frame.gray();
+    IplImage* prev = frame.prev_gray();
+
+    if (prev){
+        // last frame's points become the starting positions
+        CV_SWAP(prev_points, points, swap_points);
+
+        // calculate flow and track points (modified Lucas & Kanade algorithm),
+        // reusing pyramids the context already holds
+        int lk_flags = 0;
+        if (frame.prev_pyramid_ready())
+            lk_flags |= CV_LKFLOW_PYR_A_READY;
+        if (frame.pyramid_ready())
+            lk_flags |= CV_LKFLOW_PYR_B_READY;
 
-    // release temporary images
-    cvReleaseImage(&eig);
-    cvReleaseImage(&temp);
+        cvCalcOpticalFlowPyrLK(prev, curr, 
+                               frame.prev_pyramid(), frame.pyramid(), 
+                               prev_points, points, _point_count, 
+                               cvSize(window_size,window_size), 3, flow_pixels, 
+                               0, cvTermCriteria(CV_TERMCRIT_ITER|CV_TERMCRIT_EPS,20,0.03), lk_flags);
+        frame.set_pyramid_ready();
 
-    // update points
-    CV_SWAP(prev_points, points, swap_points);
+        // survivors keep their id and trajectory, moved down over lost points
+        trail_head = (trail_head + 1) % TRAIL_LENGTH;
+        int k = 0;
+        for(int i = 0; i < _point_count; i++){
+            if (!flow_pixels[i]){
+                continue;
+            }
+
+            if (k != i){
+                _ids[k] = _ids[i];
+                ages[k] = ages[i];
+                memcpy(&trails[k*TRAIL_LENGTH], &trails[i*TRAIL_LENGTH], TRAIL_LENGTH*sizeof(trails[0]));
+            }
+            points[k] = points[i];
+            trails[k*TRAIL_LENGTH + trail_head] = points[k];
+            ++ages[k];
+            ++k;
+        }
+        _point_count = k;
+    }
+
+    // index points for region queries
+    _grid.build(points, _point_count, scale_size(frame.size(), grid_scale), grid_scale);
 }
 
-void Flow::pair_flow(IplImage* img1, IplImage* img1_pyr,
-                     IplImage* img2, IplImage* img2_pyr){
-    // calculate flow and track points (modified Lucas & Kanade algorithm)
-    cvCalcOpticalFlowPyrLK(img1, img2, 
-                           img1_pyr, img2_pyr, 
-                           prev_points, points, _point_count, 
-                           cvSize(WINDOW_SIZE,WINDOW_SIZE), 3, flow_pixels, 
-                           0, cvTermCriteria(CV_TERMCRIT_ITER|CV_TERMCRIT_EPS,20,0.03), lk_flags);
+void Flow::save(ostream& out) const{
+    // points in flow coordinates and the grid size they are indexed at
+    CvSize grid_size = _grid.size();
+    put_value(out, grid_size);
+    put_value(out, _point_count);
+    out.write(reinterpret_cast<const char*>(points), _point_count * sizeof(points[0]));
+}
+
+bool Flow::load(istream& in){
+    CvSize grid_size;
+    int count;
+    if (!get_value(in, grid_size) || !get_value(in, count) ||
+        count < 0 || count > MAX_POINTS_TO_TRACK)
+        return false;
 
-    lk_flags |= CV_LKFLOW_PYR_A_READY; // A pyramid will be ready > 1st time
+    in.read(reinterpret_cast<char*>(points), count * sizeof(points[0]));
+    if (!in.good())
+        return false;
 
-    int k = 0;
-    for(int i = 0; i < _point_count; i++){
-        if (!flow_pixels[i]){
+    _point_count = count;
+    start_trails();
+    _grid.build(points, _point_count, grid_size, grid_scale);
+    return true;
+}
+
+void Flow::clear(){
+    // a new stream, features are found again by the next init
+    _point_count = 0;
+    if (eig)
+        _grid.build(points, 0, _grid.size(), grid_scale);
+}
+
+void Flow::start_trails(){
+    for (int i = 0; i < _point_count; i++){
+        _ids[i] = next_id++;
+        ages[i] = 1;
+        trails[i*TRAIL_LENGTH + trail_head] = points[i];
+    }
+}
+
+bool Flow::motion_window(CvRect& window, const CvRect* near){
+    // points are grouped when they are within cluster_radius of each
+    // other and move alike over their trails; the largest group, or the
+    // one with most points in near, gives the window.  Only points are
+    // visited, never the frame.
+    int n = _point_count;
+    order.clear();
+    velocity.resize(n);
+    double min_speed2 = cluster_min_speed * cluster_min_speed;
+    for (int i = 0; i < n; i++){
+        int span = MIN(ages[i], TRAIL_LENGTH) - 1;
+        if (span < 2)
             continue;
+        const CvPoint2D32f& from = trails[i*TRAIL_LENGTH + (trail_head + TRAIL_LENGTH - span) % TRAIL_LENGTH];
+        velocity[i].x = (points[i].x - from.x) / span;
+        velocity[i].y = (points[i].y - from.y) / span;
+        if (velocity[i].x * velocity[i].x + velocity[i].y * velocity[i].y >= min_speed2)
+            order.push_back(i);
+    }
+    if ((int)order.size() < cluster_min_points)
+        return false;
+
+    // sweep in x order so only points within the radius are compared
+    parent.resize(n);
+    for (int i = 0; i < n; i++){
+        parent[i] = i;
+    }
+    sort(order.begin(), order.end(), ByX(points));
+
+    double radius2 = cluster_radius * cluster_radius;
+    double velocity2 = cluster_velocity * cluster_velocity;
+    for (size_t a = 0; a < order.size(); a++){
+        const CvPoint2D32f& p = points[order[a]];
+        const CvPoint2D32f& v = velocity[order[a]];
+        for (size_t b = a + 1; b < order.size(); b++){
+            const CvPoint2D32f& q = points[order[b]];
+            if (q.x - p.x > cluster_radius)
+                break;
+            const CvPoint2D32f& w = velocity[order[b]];
+            double dx = q.x - p.x, dy = q.y - p.y;
+            double du = w.x - v.x, dv = w.y - v.y;
+            if (dx * dx + dy * dy <= radius2 && du * du + dv * dv <= velocity2)
+                parent[find_root(order[a])] = find_root(order[b]);
+        }
+    }
+
+    // size, bounds and points in near of every group, kept at its root
+    CvRect near_flow = near ? scale_rect(*near, 1.0 / grid_scale) : cvRect(0, 0, 0, 0);
+    vector<int> count(n, 0), inside(n, 0);
+    vector<CvRect> bounds(n);
+    for (size_t a = 0; a < order.size(); a++){
+        int i = order[a], r = find_root(i);
+        int x = cvRound(points[i].x), y = cvRound(points[i].y);
+        if (count[r]++ == 0){
+            bounds[r] = cvRect(x, y, 1, 1);
         }
+        else{
+            int x1 = MAX(bounds[r].x + bounds[r].width, x + 1);
+            int y1 = MAX(bounds[r].y + bounds[r].height, y + 1);
+            bounds[r].x = MIN(bounds[r].x, x);
+            bounds[r].y = MIN(bounds[r].y, y);
+            bounds[r].width = x1 - bounds[r].x;
+            bounds[r].height = y1 - bounds[r].y;
+        }
+        if (near && x >= near_flow.x && x < near_flow.x + near_flow.width &&
+            y >= near_flow.y && y < near_flow.y + near_flow.height)
+            ++inside[r];
+    }
 
-        points[k++] = points[i];
+    int best = -1;
+    for (size_t a = 0; a < order.size(); a++){
+        int r = order[a];
+        if (parent[r] != r || count[r] < cluster_min_points)
+            continue;
+        if (near && inside[r] == 0)
+            continue;
+        if (best < 0 || (near ? inside[r] > inside[best] : count[r] > count[best]))
+            best = r;
     }
-    _point_count = k;
+    if (best < 0)
+        return false;
 
-    // update points
-    CV_SWAP(prev_points, points, swap_points);
+    // the points sit on corners inside the object, pad to its edges
+    CvRect r = bounds[best];
+    int x0 = MAX(r.x - window_size, 0), y0 = MAX(r.y - window_size, 0);
+    int x1 = MIN(r.x + r.width + window_size, eig->width);
+    int y1 = MIN(r.y + r.height + window_size, eig->height);
+    window = scale_rect(cvRect(x0, y0, x1 - x0, y1 - y0), grid_scale);
+    return window.width > 0 && window.height > 0;
+}
+
+int Flow::find_root(int i){
+    while (parent[i] != i){
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
 }
 
 int Flow::point_count(){
     return _point_count;
 }
+
+const PointGrid& Flow::grid() const{
+    return _grid;
+}
+
+const int* Flow::ids() const{
+    return _ids;
+}
+
+int Flow::trail(int i, CvPoint2D32f* out) const{
+    int length = MIN(ages[i], TRAIL_LENGTH);
+    for (int k = 0; k < length; k++){
+        out[k] = trails[i*TRAIL_LENGTH + (trail_head + TRAIL_LENGTH - length + 1 + k) % TRAIL_LENGTH];
+    }
+    return length;
+}
@@ -17,6 +17,10 @@
 
 // includes
 #include "common.h"
+#include "grid.h"
+#include "frame.h"
+#include "params.h"
+#include "mask.h"
 #include "cv.h"
 #include "highgui.h"
 #include <iostream>
@@ -28,6 +32,9 @@
 // namespace preparation
 using namespace std;
 
+// constants
+const int TRAIL_LENGTH = 8;	// past positions kept per feature point
+
 // types
 class Flow{
  public:
@@ -37,11 +44,21 @@ class Flow{
 
     // Access Functions
     int point_count();
+    const PointGrid& grid() const;	// spatial index over current points
+    const int* ids() const;		// per point, stable for as long as it is followed
+    int trail(int i, CvPoint2D32f* out) const;	// up to TRAIL_LENGTH positions of point i, oldest first
     
     // Action Functions
-    void init(IplImage*);
-    void pair_flow(IplImage* prev, IplImage* prev_pyr,
-                   IplImage* curr, IplImage* curr_pyr);	// calculate the flow between two images
+    void prepare(const CvSize&);	// allocate buffers for this frame size
+    void set_grid_scale(double);	// index points at this multiple of the flow scale
+    void set_params(const TrackParams&);	// window, point count and corner settings
+    void set_mask(const IplImage*);	// no corners where this mask is zero (not owned)
+    void init(FrameContext&);		// find features in the current frame
+    void pair_flow(FrameContext&);	// flow from the previous frame to the current one
+    void clear();			// forget every point, buffers are kept
+    bool motion_window(CvRect& window, const CvRect* near = 0);	// group of points moving together, grid coordinates
+    void save(ostream&) const;		// snapshot of the tracked points
+    bool load(istream&);
     
     // Current points tracked
     CvPoint2D32f *points;
@@ -49,11 +66,32 @@ class Flow{
     // State of machine
     bool ran;				// whether differences have been calculated
     char* flow_pixels;
+    IplImage *eig, *temp;		// scratch for feature detection
+    ExclusionMask exclusion;		// static mask at the flow size
     int _point_count;
-    int lk_flags;
+    double grid_scale;			// from flow to grid coordinates
+    int window_size;			// corner and flow search window
+    int max_points;			// points found by init
+    double quality, min_distance;	// corner detection settings
+    double cluster_radius, cluster_velocity, cluster_min_speed;
+    int cluster_min_points;
+
+    // Trajectories, indexed like points
+    int *_ids;
+    int *ages;				// frames each point has been followed
+    CvPoint2D32f *trails;		// ring of TRAIL_LENGTH positions per point
+    int trail_head;			// ring slot of the current positions
+    int next_id;
+    vector<int> order, parent;		// clustering scratch
+    vector<CvPoint2D32f> velocity;
 
     // Points to track
     CvPoint2D32f *prev_points, *swap_points;
+    PointGrid _grid;
+
+    // methods
+    void start_trails();		// every point starts a new trajectory
+    int find_root(int);
 };
 
 #endif
@@ -9,86 +9,92 @@
  */
 
 #include "focus.h"
+#include "snapshot.h"
 #include "img_template.tpl"
 
 Focus::Focus(){
+  cam_point_count = 0;
+  cam_density = 0.f;
+  frame_size = cvSize(0, 0);
+  last_focus_area.area = 0;
+  last_focus_area.value = cvScalarAll(0);
+  last_focus_area.rect = cvRect(0, 0, 0, 0);
+  last_focus_area.contour = NULL;
 }
 
 Focus::~Focus(){
-  cvReleaseImage(&poly_img);
-  cvReleaseImage(&point_img);
-  cvReleaseImage(&and_img);
+}
+
+void Focus::prepare(const CvSize& frame_size_){
+  frame_size = frame_size_;
+  ranked.reserve(64);
+}
+
+void Focus::clear(){
+  cam_point_count = 0;
+  cam_density = 0.f;
+  last_focus_area.area = 0;
+  last_focus_area.value = cvScalarAll(0);
+  last_focus_area.rect = cvRect(0, 0, 0, 0);
+  last_focus_area.contour = NULL;
+  ranked.clear();
+}
+
+void Focus::set_params(const TrackParams& params_){
+  params = params_;
 }
 
 void Focus::update(const CvBox2D* track_box, 
-                   const CvConnectedComp* motion_seg,
-                   CvPoint2D32f* feature_points,
-                   int num_points,
-                   const CvSize& frame_size_,
+                   CvSeq* motion_segs,
+                   const PointGrid& feature_points,
+                   const FrameContext& frame,
                    const bool& points_decide,
                    bool& changed){
-  frame_size = frame_size_;
+  frame_size = frame.size();
   changed = false;
 
-  if (!poly_img) {
-    poly_img = cvCreateImage(frame_size, 8, 1);
-    point_img = cvCreateImage(frame_size, 8, 1);
-    and_img = cvCreateImage(frame_size, 8, 1);
-  }
+  if (track_box && motion_segs){
+    // Score every motion segment against the CAMSHIFT box in one pass
+    rank_candidates(track_box, motion_segs, feature_points);
+    if (ranked.empty())
+      return;
 
-  if (track_box && motion_seg && feature_points){
-    cvZero(poly_img);
-    cvZero(point_img);
-    cvZero(and_img);
-
-    // Check if CAMSHIFT box and motion segment largely intersect
-    draw_box(track_box, poly_img, cvScalar(255));
-    draw_comp(motion_seg, point_img, cvScalar(255));
-    float intersect_area = 0.f, cam_amt = 0.f, seg_amt = 0.f;
-    float frame_area = FRAME_SIZE.width * FRAME_SIZE.height;
-    intersect_amount(point_img, poly_img, and_img,
-                     intersect_area, seg_amt, cam_amt);
-    //    CvRect camshift_rect = cvBoundingRect(poly_img);
-    CvRect seg_rect = cvBoundingRect(point_img);
-    float cam_seg_size_ratio = (float)(track_box->size.width*track_box->size.height) / float(seg_rect.width*seg_rect.height);
-    float cam_frame_size_ratio = (float)(track_box->size.width*track_box->size.height) / (float)(FRAME_SIZE.width*FRAME_SIZE.height);
-    float seg_frame_size_ratio = (float)(seg_rect.width*seg_rect.height) / (float)(FRAME_SIZE.width*FRAME_SIZE.height);
+    const FocusCandidate& best = ranked[0];
+    float intersect_area = best.overlap_area, cam_amt = best.cam_amt, seg_amt = best.seg_amt;
+    float frame_area = frame_size.width * frame_size.height;
+    float cam_frame_size_ratio = (float)(track_box->size.width*track_box->size.height) / frame_area;
+    float seg_frame_size_ratio = best.seg_frame_size_ratio;
 
     // Number of points intersected in segment vs camshift window
-    CvPoint seg_pts[4];
-    rect_to_points(seg_rect, seg_pts);
-    int seg_point_count = intersect_count(seg_pts, 4, feature_points, num_points);
-    int cam_point_count = intersect_count(track_box, feature_points, num_points);
-    float seg_cam_point_count_ratio = (float)seg_point_count / (float)cam_point_count;
+    float seg_cam_point_count_ratio = (float)best.point_count / (float)cam_point_count;
     
-    // Calculate feature density for both CAMSHIFTed box and motion segment
-    float cam_density = density(track_box, feature_points, num_points);
-    float seg_density = density(motion_seg, feature_points, num_points);
-    float seg_cam_density_ratio = seg_density / cam_density;
+    // Feature density for both CAMSHIFTed box and motion segment
+    float seg_cam_density_ratio = best.density / cam_density;
 
     // Decide whether to change focus
     if (points_decide){
-          if ((seg_cam_density_ratio > 1.08f || seg_cam_point_count_ratio > 0.6f) && 
-              cam_frame_size_ratio > 0.6f && 
-              (seg_amt < 0.5f || cam_amt < 0.5f)) {
+          if ((seg_cam_density_ratio > params.focus_density_gain ||
+               seg_cam_point_count_ratio > params.focus_point_share) && 
+              cam_frame_size_ratio > params.focus_box_size && 
+              (seg_amt < params.focus_overlap || cam_amt < params.focus_overlap)) {
             changed = true;
           }
     }
     else{
       // the first clause detects when a better region to track exists
       // the second clause detects camshift drifting
-      if ((seg_amt < 0.15f &&  // <15% of largest motion segment (LMS) intersects with camshift window
-           seg_frame_size_ratio > 0.02f) || // LMS' area is >2% of the frame area
-          (intersect_area > frame_area * 0.01f && // intersection area is >1% of frame area
-           cam_frame_size_ratio > 0.2f && // camshift window's area is >20% of frame area
-           cam_amt < 0.55f)) { // <55% of camshift window intersects with LMS
+      if ((seg_amt < params.focus_seg_overlap &&  // <15% of best motion segment (BMS) intersects with camshift window
+           seg_frame_size_ratio > params.focus_seg_size) || // BMS' area is >2% of the frame area
+          (intersect_area > frame_area * params.focus_drift_area && // intersection area is >1% of frame area
+           cam_frame_size_ratio > params.focus_drift_box_size && // camshift window's area is >20% of frame area
+           cam_amt < params.focus_drift_overlap)) { // <55% of camshift window intersects with BMS
         changed = true;
-        if (seg_amt < 0.15f && seg_frame_size_ratio > 0.02f){
-        }
-        else {
-        }
       }
     }
+
+    if (changed){
+      last_focus_area = best.comp;
+    }
     /*
     cout << "density ";
     
@@ -132,68 +138,150 @@ void Focus::update(const CvBox2D* track_box,
   }
 }
 
+void Focus::save(ostream& out) const{
+  put_value(out, last_focus_area.rect);
+  put_value(out, last_focus_area.area);
+}
+
+bool Focus::load(istream& in){
+  CvRect rect;
+  double area;
+  if (!get_value(in, rect) || !get_value(in, area))
+    return false;
+
+  last_focus_area.rect = rect;
+  last_focus_area.area = area;
+  return true;
+}
+
 const CvConnectedComp& Focus::focus_area(){
   return last_focus_area;
 }
 
-float Focus::density(const CvBox2D* box, CvPoint2D32f* pts, int num_pts){
-  CvPoint2D32f v_float[4];
-  cvBoxPoints(*box, v_float);
+const vector<FocusCandidate>& Focus::candidates() const{
+  return ranked;
+}
+
+int Focus::intersect_count(CvPoint* verts, int num_verts, 
+                           const PointGrid& pts){
+  return pts.count_in_poly(verts, num_verts);
+}
+
+int Focus::intersect_count(const CvBox2D* box, const PointGrid& pts){
+  return pts.count_in_box(box);
+}
+
+static float clipped_area(const CvPoint2D32f* poly, int num_verts, const CvRect& rect){
+  // area of a convex polygon clipped to rect (Sutherland-Hodgman), rect
+  // spans x..x+width like draw_comp
+  CvPoint2D32f buf[2][8];
+  float lo[2] = {(float)rect.x, (float)rect.y};
+  float hi[2] = {(float)(rect.x + rect.width), (float)(rect.y + rect.height)};
+  int n = num_verts, src = 0;
+
+  for (int i = 0; i < n; ++i){
+    buf[src][i] = poly[i];
+  }
+
+  for (int edge = 0; edge < 4 && n > 0; ++edge){
+    int axis = edge % 2;
+    bool upper = edge >= 2;
+    float limit = upper ? hi[axis] : lo[axis];
+    CvPoint2D32f* in = buf[src];
+    CvPoint2D32f* out = buf[1 - src];
+    int m = 0;
 
+    for (int i = 0; i < n; ++i){
+      const CvPoint2D32f& a = in[i];
+      const CvPoint2D32f& b = in[(i + 1) % n];
+      float av = axis ? a.y : a.x, bv = axis ? b.y : b.x;
+      bool a_in = upper ? av <= limit : av >= limit;
+      bool b_in = upper ? bv <= limit : bv >= limit;
+
+      if (a_in && m < 8)
+        out[m++] = a;
+      if (a_in != b_in && m < 8){
+        float t = (limit - av) / (bv - av);
+        out[m++] = cvPoint2D32f(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y));
+      }
+    }
+
+    n = m;
+    src = 1 - src;
+  }
+
+  float area = 0.f;
+  for (int i = 0; i < n; ++i){
+    const CvPoint2D32f& a = buf[src][i];
+    const CvPoint2D32f& b = buf[src][(i + 1) % n];
+    area += a.x * b.y - b.x * a.y;
+  }
+
+  return fabsf(area) * 0.5f;
+}
+
+static bool better_candidate(const FocusCandidate& a, const FocusCandidate& b){
+  return a.score > b.score;
+}
+
+void Focus::rank_candidates(const CvBox2D* track_box, CvSeq* motion_segs,
+                            const PointGrid& pts){
+  int num_segs = motion_segs->total;
+  float frame_area = (float)(frame_size.width * frame_size.height);
+  float box_area = track_box->size.width * track_box->size.height;
+
+  ranked.resize(num_segs);
+  for (int i = 0; i < num_segs; ++i){
+    FocusCandidate& c = ranked[i];
+    c.comp = *reinterpret_cast<CvConnectedComp*>(cvGetSeqElem(motion_segs, i));
+    c.point_count = 0;
+  }
+
+  CvPoint2D32f v_float[4];
+  cvBoxPoints(*track_box, v_float);
   CvPoint v[4];
   for (int i = 0; i < 4; ++i){
     v[i] = cvPointFrom32f(v_float[i]);
   }
-  
-  float count = (float)intersect_count(v, 4, pts, num_pts);
 
-  return count / (float)(box->size.width * box->size.height);
-}
+  // single sweep over the feature points counts the points of the track
+  // box and of every segment together
+  const CvPoint* p = pts.points();
+  int num_pts = pts.count();
+  cam_point_count = 0;
+  for (int k = 0; k < num_pts; ++k){
+    if (point_in_convex_poly(v, 4, p[k].x, p[k].y))
+      ++cam_point_count;
 
-float Focus::density(const CvConnectedComp* comp, CvPoint2D32f* pts, int num_pts){
-  CvPoint v[4];
-  v[0] = cvPoint(comp->rect.x, comp->rect.y);
-  v[1] = cvPoint(comp->rect.x + comp->rect.width, comp->rect.y);
-  v[2] = cvPoint(comp->rect.x + comp->rect.width, comp->rect.y + comp->rect.height);
-  v[3] = cvPoint(comp->rect.x, comp->rect.y + comp->rect.height);
-  
-  float count = (float)intersect_count(v, 4, pts, num_pts);
-  return count / (float)(comp->rect.width * comp->rect.height);
-}
+    for (int i = 0; i < num_segs; ++i){
+      const CvRect& r = ranked[i].comp.rect;
+      if (p[k].x >= r.x && p[k].x <= r.x + r.width &&
+          p[k].y >= r.y && p[k].y <= r.y + r.height)
+        ++ranked[i].point_count;
+    }
+  }
+  cam_density = (float)cam_point_count / box_area;
 
-int Focus::intersect_count(CvPoint* verts, int num_verts, 
-                           CvPoint2D32f* pts, int num_pts){
-  cvZero(poly_img);
-  cvZero(point_img);
-  cvZero(and_img);
-  
-  // Draw polygon
-  cvFillConvexPoly(poly_img, verts, num_verts, cvScalar(255));
-  
-  // Draw points
-  draw_points(pts, num_pts, point_img, cvScalar(255));
-  
-  cvAnd(poly_img, point_img, and_img);
-
-  int count = cvCountNonZero(and_img);
-
-  return count;
-}
+  // mean feature density of the frame, segments are rewarded for having
+  // more features than average
+  float frame_density = (float)num_pts / frame_area;
+
+  for (int i = 0; i < num_segs; ++i){
+    FocusCandidate& c = ranked[i];
+    float seg_area = (float)MAX(c.comp.rect.width * c.comp.rect.height, 1);
+
+    c.density = (float)c.point_count / seg_area;
+    c.overlap_area = clipped_area(v_float, 4, c.comp.rect);
+    c.seg_amt = c.overlap_area / seg_area;
+    c.cam_amt = box_area > 0.f ? c.overlap_area / box_area : 0.f;
+    c.seg_frame_size_ratio = seg_area / frame_area;
+    c.cam_seg_size_ratio = box_area / seg_area;
+
+    // bigger segments first, weighted by feature richness and by how
+    // much of it is already tracked so the focus does not flicker
+    float feature_ratio = num_pts > 0 ? c.density / frame_density : 1.f;
+    c.score = c.seg_frame_size_ratio * (1.f + feature_ratio) * (1.f + c.seg_amt);
+  }
 
-int Focus::intersect_count(const CvBox2D* box, CvPoint2D32f* pts, int num_pts){
-  cvZero(poly_img);
-  cvZero(point_img);
-  cvZero(and_img);
-  
-  // Draw polygon
-  draw_box(box, poly_img, cvScalar(255));
-  
-  // Draw points
-  draw_points(pts, num_pts, point_img, cvScalar(255));
-  
-  cvAnd(poly_img, point_img, and_img);
-
-  int count = cvCountNonZero(and_img);
-
-  return count;
+  sort(ranked.begin(), ranked.end(), better_candidate);
 }
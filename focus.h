@@ -17,6 +17,9 @@
 
 // includes
 #include "common.h"
+#include "grid.h"
+#include "frame.h"
+#include "params.h"
 #include "cv.h"
 #include "highgui.h"
 #include <iostream>
@@ -28,12 +31,28 @@
 // namespace preparation
 using namespace std;
 
+// types
+struct FocusCandidate{
+  CvConnectedComp comp; // the motion segment
+  int point_count; // feature points inside the segment
+  float density; // feature points per pixel of segment
+  float overlap_area; // area shared with the track box
+  float seg_amt; // fraction of the segment covered by the track box
+  float cam_amt; // fraction of the track box covered by the segment
+  float seg_frame_size_ratio; // segment area over frame area
+  float cam_seg_size_ratio; // track box area over segment area
+  float score; // ranking score, higher is a better focus
+};
+
 class Focus{
   /* This class is used to identify and update the focus of the scene.
      There are two conditions that will cause a refocus:
        - The track box from CAMSHIFT has a low feature density
-       - The largest motion segment has a significantly higher feature density
-         than the track box
+       - The best ranked motion segment has a significantly higher feature
+         density than the track box
+
+     All motion segments are scored together in one sweep over the feature
+     points and kept ranked, best first, in candidates().
 
      Another option is to consider the historical feature density of the last motion segment
      used to seed CAMSHIFT and only reinit CAMSHIFT with a new motion segment if it does
@@ -45,29 +64,35 @@ class Focus{
   ~Focus();
 
   // methods
+  void prepare(const CvSize&); // frame size and candidate storage
+  void set_params(const TrackParams&); // ratios deciding focus changes
+  void clear(); // no focus area yet
   void update(const CvBox2D* track_box, 
-              const CvConnectedComp* motion_area,
-              CvPoint2D32f* feature_points,
-              int num_points,
-              const CvSize& frame_size_, // size of frames
+              CvSeq* motion_segs, // every candidate segment
+              const PointGrid& feature_points,
+              const FrameContext& frame, // frame being processed
               const bool& density_decide,
-              bool& changed=false); // check if focus change is needed
+              bool& changed); // check if focus change is needed
+
+  void save(ostream&) const; // snapshot of the last focus area
+  bool load(istream&);
 
   const CvConnectedComp& focus_area(); // the last focus area
-  int intersect_count(const CvBox2D*, CvPoint2D32f*, int);
-  int intersect_count(CvPoint*, int, CvPoint2D32f*, int);
+  const vector<FocusCandidate>& candidates() const; // best first
+  int intersect_count(const CvBox2D*, const PointGrid&);
+  int intersect_count(CvPoint*, int, const PointGrid&);
   
  private:
   // variables
   CvConnectedComp last_focus_area;
-  IplImage *poly_img; // used for finding feature intersection
-  IplImage *point_img; // used for finding feature intersection
-  IplImage *and_img; // used for finding feature intersection
+  vector<FocusCandidate> ranked; // segments scored by the last update
+  int cam_point_count; // feature points in the last track box
+  float cam_density; // feature density of the last track box
   CvSize frame_size; // gets updated by calls to update
+  TrackParams params;
 
   // methods
-  float density(const CvBox2D*, CvPoint2D32f*, int);
-  float density(const CvConnectedComp*, CvPoint2D32f*, int);
+  void rank_candidates(const CvBox2D*, CvSeq*, const PointGrid&);
 };
 
 #endif
@@ -0,0 +1,236 @@
+/*
+ * frame.cxx - Implementation of FrameContext class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "frame.h"
+#include "pool.h"
+#include "snapshot.h"
+
+// Constructors
+
+FrameContext::FrameContext(){
+  _size = cvSize(0, 0);
+  frame = NULL;
+  _timestamp = 0.0;
+  _gray = _hsv = _hue = _mask = _pyramid = NULL;
+  for (int i = 0; i < GRAY_HISTORY; ++i){
+    _older_gray[i] = NULL;
+  }
+  _prev_pyramid = NULL;
+  have = prev_have = older_grays = 0;
+  mask_smin = mask_vmin = mask_vmax = -1;
+  _conversions = 0;
+}
+
+FrameContext::~FrameContext(){
+  release_buffers();
+}
+
+// Action Functions
+
+void FrameContext::prepare(const CvSize& size){
+  if (_gray && size.width == _size.width && size.height == _size.height)
+    return;
+
+  release_buffers();
+  ImagePool& pool = ImagePool::shared();
+  _size = size;
+  _gray = pool.acquire(size, IPL_DEPTH_8U, 1);
+  _hsv = pool.acquire(size, IPL_DEPTH_8U, 3);
+  _hue = pool.acquire(size, IPL_DEPTH_8U, 1);
+  _mask = pool.acquire(size, IPL_DEPTH_8U, 1);
+  _pyramid = pool.acquire(size, IPL_DEPTH_8U, 1);
+  for (int i = 0; i < GRAY_HISTORY; ++i){
+    _older_gray[i] = pool.acquire(size, IPL_DEPTH_8U, 1);
+  }
+  _prev_pyramid = pool.acquire(size, IPL_DEPTH_8U, 1);
+  have = prev_have = older_grays = 0;
+}
+
+void FrameContext::release_buffers(){
+  ImagePool& pool = ImagePool::shared();
+  pool.release(_gray);
+  pool.release(_hsv);
+  pool.release(_hue);
+  pool.release(_mask);
+  pool.release(_pyramid);
+  for (int i = 0; i < GRAY_HISTORY; ++i){
+    pool.release(_older_gray[i]);
+  }
+  pool.release(_prev_pyramid);
+  frame = NULL;
+  have = prev_have = older_grays = 0;
+}
+
+void FrameContext::set_frame(IplImage* bgr, double timestamp){
+  prepare(cvGetSize(bgr));
+
+  // kept grays move one frame back, the oldest buffer is reused
+  IplImage* oldest = _older_gray[GRAY_HISTORY - 1];
+  for (int i = GRAY_HISTORY - 1; i > 0; --i){
+    _older_gray[i] = _older_gray[i - 1];
+  }
+  older_grays = (older_grays << 1) & ((1u << GRAY_HISTORY) - 1);
+
+  // this frame's gray and pyramid become the previous ones
+  IplImage* swap_temp;
+  if (have & HAVE_GRAY){
+    _older_gray[0] = _gray;
+    _gray = oldest;
+    older_grays |= 1;
+    CV_SWAP(_prev_pyramid, _pyramid, swap_temp);
+    prev_have = have & (HAVE_GRAY | HAVE_PYRAMID);
+  }
+  else{
+    _older_gray[0] = oldest;
+    prev_have = 0;
+  }
+
+  frame = bgr;
+  _timestamp = timestamp;
+  have = 0;
+  _conversions = 0;
+}
+
+void FrameContext::clear(){
+  have = prev_have = older_grays = 0;
+}
+
+void FrameContext::save(ostream& out) const{
+  bool saved = (have & HAVE_GRAY) != 0;
+  put_value(out, saved);
+  if (saved)
+    put_image(out, _gray);
+  put_value(out, older_grays);
+  for (int i = 0; i < GRAY_HISTORY; ++i){
+    if (older_grays & (1u << i))
+      put_image(out, _older_gray[i]);
+  }
+}
+
+bool FrameContext::load(istream& in){
+  bool saved;
+  if (!get_value(in, saved))
+    return false;
+
+  have = prev_have = older_grays = 0;
+  if (saved && (!_gray || !get_image(in, _gray)))
+    return false;
+
+  unsigned older;
+  if (!get_value(in, older))
+    return false;
+  for (int i = 0; i < GRAY_HISTORY; ++i){
+    if ((older & (1u << i)) && (!_older_gray[i] || !get_image(in, _older_gray[i])))
+      return false;
+  }
+
+  have = saved ? HAVE_GRAY : 0;
+  older_grays = older & ((1u << GRAY_HISTORY) - 1);
+  return true;
+}
+
+// Access Functions
+
+IplImage* FrameContext::color() const{
+  return frame;
+}
+
+double FrameContext::timestamp() const{
+  return _timestamp;
+}
+
+const CvSize& FrameContext::size() const{
+  return _size;
+}
+
+IplImage* FrameContext::gray(){
+  if (!(have & HAVE_GRAY)){
+    if (frame->nChannels == 1)
+      cvCopy(frame, _gray, 0);
+    else
+      cvCvtColor(frame, _gray, CV_BGR2GRAY);
+    _gray->origin = frame->origin;
+    have |= HAVE_GRAY;
+    ++_conversions;
+  }
+
+  return _gray;
+}
+
+IplImage* FrameContext::hsv(){
+  if (!(have & HAVE_HSV)){
+    cvCvtColor(frame, _hsv, CV_BGR2HSV);
+    _hsv->origin = frame->origin;
+    have |= HAVE_HSV;
+    ++_conversions;
+  }
+
+  return _hsv;
+}
+
+IplImage* FrameContext::hue(){
+  if (!(have & HAVE_HUE)){
+    cvSplit(hsv(), _hue, 0, 0, 0);
+    _hue->origin = frame->origin;
+    have |= HAVE_HUE;
+    ++_conversions;
+  }
+
+  return _hue;
+}
+
+IplImage* FrameContext::mask(int smin, int vmin, int vmax){
+  if (!(have & HAVE_MASK) || smin != mask_smin || vmin != mask_vmin || vmax != mask_vmax){
+    cvInRangeS(hsv(), cvScalar(0, smin, MIN(vmin, vmax), 0),
+               cvScalar(180, 256, MAX(vmin, vmax), 0), _mask);
+    _mask->origin = frame->origin;
+    mask_smin = smin;
+    mask_vmin = vmin;
+    mask_vmax = vmax;
+    have |= HAVE_MASK;
+    ++_conversions;
+  }
+
+  return _mask;
+}
+
+IplImage* FrameContext::pyramid(){
+  return _pyramid;
+}
+
+bool FrameContext::pyramid_ready() const{
+  return (have & HAVE_PYRAMID) != 0;
+}
+
+void FrameContext::set_pyramid_ready(){
+  have |= HAVE_PYRAMID;
+}
+
+IplImage* FrameContext::prev_gray(){
+  return gray_ago(1);
+}
+
+IplImage* FrameContext::gray_ago(int frames){
+  if (frames < 1 || frames > GRAY_HISTORY || !(older_grays & (1u << (frames - 1))))
+    return NULL;
+  return _older_gray[frames - 1];
+}
+
+IplImage* FrameContext::prev_pyramid(){
+  return _prev_pyramid;
+}
+
+bool FrameContext::prev_pyramid_ready() const{
+  return (prev_have & HAVE_PYRAMID) != 0;
+}
+
+int FrameContext::conversions() const{
+  return _conversions;
+}
@@ -0,0 +1,99 @@
+/*
+ * frame.h - One frame and the images derived from it
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+// includes
+#include "cv.h"
+#include <iostream>
+
+// namespace preparation
+using namespace std;
+
+// constants
+const int GRAY_HISTORY = 3;	// frames back gray images are kept for, motion is differenced that far
+
+class FrameContext{
+  /* The frame every component is working on.  Derived images (gray,
+     HSV, hue, the CAMSHIFT mask and the LK pyramid) are computed the
+     first time any component asks for them and handed out as is for the
+     rest of the frame, so each is computed at most once per frame.
+
+     The gray images of the last GRAY_HISTORY frames and the pyramid of
+     the previous one are kept when they were computed, which is all
+     frame differencing and optical flow need.  Derived images belong to
+     the context and stay valid until the next set_frame(); the frame
+     itself is not copied.
+  */
+ public:
+  FrameContext();
+  ~FrameContext();
+
+  // Action Functions
+  void prepare(const CvSize&); // allocate buffers for this frame size
+  void set_frame(IplImage* bgr, double timestamp); // start the next frame
+  void clear(); // forget the previous frame
+  void save(ostream&) const; // grays of the current and kept frames, if computed
+  bool load(istream&); // the current gray becomes the previous one of the next frame
+
+  // Access Functions
+  IplImage* color() const; // the frame as given
+  double timestamp() const; // seconds
+  const CvSize& size() const;
+
+  IplImage* gray();
+  IplImage* hsv();
+  IplImage* hue(); // hue plane of hsv()
+  IplImage* mask(int smin, int vmin, int vmax); // hsv() within saturation/value range
+  IplImage* pyramid(); // LK pyramid buffer for gray()
+  bool pyramid_ready() const; // pyramid() holds the pyramid of gray()
+  void set_pyramid_ready(); // cvCalcOpticalFlowPyrLK built it
+
+  IplImage* prev_gray(); // NULL unless the last frame's gray was computed
+  IplImage* gray_ago(int frames); // gray of that many frames back, up to GRAY_HISTORY, or NULL
+  IplImage* prev_pyramid();
+  bool prev_pyramid_ready() const;
+
+  int conversions() const; // derived images computed for this frame
+
+ private:
+  enum{
+    HAVE_GRAY = 1,
+    HAVE_HSV = 2,
+    HAVE_HUE = 4,
+    HAVE_MASK = 8,
+    HAVE_PYRAMID = 16
+  };
+
+  CvSize _size;
+  IplImage *frame;
+  double _timestamp;
+  IplImage *_gray, *_hsv, *_hue, *_mask, *_pyramid;
+  IplImage *_older_gray[GRAY_HISTORY]; // of the frame before, the one before that, ...
+  IplImage *_prev_pyramid;
+  unsigned have, prev_have; // HAVE_ bits of this and the last frame
+  unsigned older_grays; // bit i set when _older_gray[i] was computed
+  int mask_smin, mask_vmin, mask_vmax; // range _mask was computed for
+  int _conversions;
+
+  // methods
+  void release_buffers();
+
+  // not copyable
+  FrameContext(const FrameContext&);
+  FrameContext& operator=(const FrameContext&);
+};
+
+#endif
@@ -0,0 +1,273 @@
+/*
+ * grid.cxx - Implementation of PointGrid class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "grid.h"
+#include <limits.h>
+
+const int PointGrid::CELL_SIZE = 16;
+
+static inline int cell_end(int cell, int limit){
+  // last pixel covered by a cell, cells on the frame border are partial
+  return MIN((cell + 1) * PointGrid::CELL_SIZE, limit) - 1;
+}
+
+// Constructors
+
+PointGrid::PointGrid(){
+  frame_size = cvSize(0, 0);
+  cols = rows = 0;
+  cell_start = NULL;
+  cell_pts = NULL;
+  cell_bounds = NULL;
+  point_capacity = cell_capacity = 0;
+  _count = 0;
+}
+
+PointGrid::~PointGrid(){
+  delete [] cell_start;
+  delete [] cell_pts;
+  delete [] cell_bounds;
+}
+
+// Action Functions
+
+void PointGrid::reserve(int num_pts, int num_cells){
+  if (num_pts > point_capacity){
+    delete [] cell_pts;
+    cell_pts = new CvPoint[num_pts];
+    point_capacity = num_pts;
+  }
+
+  if (num_cells > cell_capacity){
+    delete [] cell_start;
+    delete [] cell_bounds;
+    cell_start = new int[num_cells + 2];
+    cell_bounds = new CvRect[num_cells];
+    cell_capacity = num_cells;
+  }
+}
+
+void PointGrid::prepare(const CvSize& size, int max_points){
+  int num_cells = ((size.width + CELL_SIZE - 1) / CELL_SIZE) *
+                  ((size.height + CELL_SIZE - 1) / CELL_SIZE);
+  reserve(max_points, num_cells);
+}
+
+void PointGrid::clear(){
+  _count = 0;
+  if (cell_start)
+    memset(cell_start, 0, (cols * rows + 2) * sizeof(cell_start[0]));
+}
+
+static inline CvPoint snap(const CvPoint2D32f& pt, double scale){
+  return scale == 1.0 ? cvPointFrom32f(pt) : cvPointFrom32f(scale_point(pt, scale));
+}
+
+void PointGrid::build(const CvPoint2D32f* pts, int num_pts, const CvSize& frame_size_,
+                      double scale){
+  frame_size = frame_size_;
+  cols = (frame_size.width + CELL_SIZE - 1) / CELL_SIZE;
+  rows = (frame_size.height + CELL_SIZE - 1) / CELL_SIZE;
+  int num_cells = cols * rows;
+
+  reserve(num_pts, num_cells);
+  memset(cell_start, 0, (num_cells + 2) * sizeof(cell_start[0]));
+
+  // count points per cell (shifted by two so the scatter below leaves
+  // cell_start[c] at the first point of cell c)
+  for (int i = 0; i < num_pts; ++i){
+    CvPoint p = snap(pts[i], scale);
+    if (p.x < 0 || p.y < 0 || p.x >= frame_size.width || p.y >= frame_size.height)
+      continue;
+    cell_start[(p.y / CELL_SIZE) * cols + p.x / CELL_SIZE + 2]++;
+  }
+  for (int c = 2; c < num_cells + 2; ++c){
+    cell_start[c] += cell_start[c - 1];
+  }
+
+  // scatter points into their cells
+  _count = 0;
+  for (int i = 0; i < num_pts; ++i){
+    CvPoint p = snap(pts[i], scale);
+    if (p.x < 0 || p.y < 0 || p.x >= frame_size.width || p.y >= frame_size.height)
+      continue;
+    cell_pts[cell_start[(p.y / CELL_SIZE) * cols + p.x / CELL_SIZE + 1]++] = p;
+    ++_count;
+  }
+
+  // bounds of each cell's points, so fully covered cells never need
+  // their points visited
+  for (int c = 0; c < num_cells; ++c){
+    CvRect& b = cell_bounds[c];
+    if (cell_start[c] == cell_start[c + 1]){
+      b = cvRect(0, 0, 0, 0);
+      continue;
+    }
+    int x0 = INT_MAX, y0 = INT_MAX, x1 = -1, y1 = -1;
+    for (int i = cell_start[c]; i < cell_start[c + 1]; ++i){
+      x0 = MIN(x0, cell_pts[i].x);
+      y0 = MIN(y0, cell_pts[i].y);
+      x1 = MAX(x1, cell_pts[i].x);
+      y1 = MAX(y1, cell_pts[i].y);
+    }
+    b = cvRect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+  }
+}
+
+// Access Functions
+
+int PointGrid::count() const{
+  return _count;
+}
+
+const CvSize& PointGrid::size() const{
+  return frame_size;
+}
+
+const CvPoint* PointGrid::points() const{
+  return cell_pts;
+}
+
+bool PointGrid::clip(const CvRect& r, int& x0, int& y0, int& x1, int& y1) const{
+  x0 = MAX(r.x, 0);
+  y0 = MAX(r.y, 0);
+  x1 = MIN(r.x + r.width, frame_size.width - 1);
+  y1 = MIN(r.y + r.height, frame_size.height - 1);
+
+  return _count > 0 && x0 <= x1 && y0 <= y1;
+}
+
+int PointGrid::count_in_rect(const CvRect& rect) const{
+  int x0, y0, x1, y1;
+  if (!clip(rect, x0, y0, x1, y1))
+    return 0;
+
+  int count = 0;
+  for (int cy = y0 / CELL_SIZE; cy <= y1 / CELL_SIZE; ++cy){
+    bool row_inside = cy * CELL_SIZE >= y0 && cell_end(cy, frame_size.height) <= y1;
+
+    for (int cx = x0 / CELL_SIZE; cx <= x1 / CELL_SIZE; ++cx){
+      int c = cy * cols + cx;
+      if (row_inside && cx * CELL_SIZE >= x0 && cell_end(cx, frame_size.width) <= x1){
+        count += cell_start[c + 1] - cell_start[c];
+        continue;
+      }
+
+      for (int i = cell_start[c]; i < cell_start[c + 1]; ++i){
+        const CvPoint& p = cell_pts[i];
+        if (p.x >= x0 && p.x <= x1 && p.y >= y0 && p.y <= y1)
+          ++count;
+      }
+    }
+  }
+
+  return count;
+}
+
+int PointGrid::count_in_box(const CvBox2D* box) const{
+  CvPoint2D32f v_float[4];
+  cvBoxPoints(*box, v_float);
+
+  CvPoint v[4];
+  for (int i = 0; i < 4; ++i){
+    v[i] = cvPointFrom32f(v_float[i]);
+  }
+
+  return count_in_poly(v, 4);
+}
+
+int PointGrid::count_in_poly(const CvPoint* verts, int num_verts) const{
+  if (num_verts < 1)
+    return 0;
+
+  // only the cells under the polygon's bounding rect are visited
+  int bx0 = verts[0].x, by0 = verts[0].y, bx1 = verts[0].x, by1 = verts[0].y;
+  for (int i = 1; i < num_verts; ++i){
+    bx0 = MIN(bx0, verts[i].x);
+    by0 = MIN(by0, verts[i].y);
+    bx1 = MAX(bx1, verts[i].x);
+    by1 = MAX(by1, verts[i].y);
+  }
+
+  int x0, y0, x1, y1;
+  if (!clip(cvRect(bx0, by0, bx1 - bx0, by1 - by0), x0, y0, x1, y1))
+    return 0;
+
+  int count = 0;
+  for (int cy = y0 / CELL_SIZE; cy <= y1 / CELL_SIZE; ++cy){
+    int py0 = cy * CELL_SIZE, py1 = cell_end(cy, frame_size.height);
+
+    for (int cx = x0 / CELL_SIZE; cx <= x1 / CELL_SIZE; ++cx){
+      int c = cy * cols + cx;
+      if (cell_start[c] == cell_start[c + 1])
+        continue;
+
+      // a cell whose corners are all inside a convex polygon is inside it
+      int px0 = cx * CELL_SIZE, px1 = cell_end(cx, frame_size.width);
+      if (point_in_convex_poly(verts, num_verts, px0, py0) &&
+          point_in_convex_poly(verts, num_verts, px1, py0) &&
+          point_in_convex_poly(verts, num_verts, px1, py1) &&
+          point_in_convex_poly(verts, num_verts, px0, py1)){
+        count += cell_start[c + 1] - cell_start[c];
+        continue;
+      }
+
+      for (int i = cell_start[c]; i < cell_start[c + 1]; ++i){
+        const CvPoint& p = cell_pts[i];
+        if (p.x >= x0 && p.x <= x1 && p.y >= y0 && p.y <= y1 &&
+            point_in_convex_poly(verts, num_verts, p.x, p.y))
+          ++count;
+      }
+    }
+  }
+
+  return count;
+}
+
+CvRect PointGrid::bounds_in_rect(const CvRect& rect) const{
+  int x0, y0, x1, y1;
+  if (!clip(rect, x0, y0, x1, y1))
+    return cvRect(0, 0, 0, 0);
+
+  int bx0 = INT_MAX, by0 = INT_MAX, bx1 = -1, by1 = -1;
+  for (int cy = y0 / CELL_SIZE; cy <= y1 / CELL_SIZE; ++cy){
+    bool row_inside = cy * CELL_SIZE >= y0 && cell_end(cy, frame_size.height) <= y1;
+
+    for (int cx = x0 / CELL_SIZE; cx <= x1 / CELL_SIZE; ++cx){
+      int c = cy * cols + cx;
+      if (cell_start[c] == cell_start[c + 1])
+        continue;
+
+      if (row_inside && cx * CELL_SIZE >= x0 && cell_end(cx, frame_size.width) <= x1){
+        const CvRect& b = cell_bounds[c];
+        bx0 = MIN(bx0, b.x);
+        by0 = MIN(by0, b.y);
+        bx1 = MAX(bx1, b.x + b.width - 1);
+        by1 = MAX(by1, b.y + b.height - 1);
+        continue;
+      }
+
+      for (int i = cell_start[c]; i < cell_start[c + 1]; ++i){
+        const CvPoint& p = cell_pts[i];
+        if (p.x >= x0 && p.x <= x1 && p.y >= y0 && p.y <= y1){
+          bx0 = MIN(bx0, p.x);
+          by0 = MIN(by0, p.y);
+          bx1 = MAX(bx1, p.x);
+          by1 = MAX(by1, p.y);
+        }
+      }
+    }
+  }
+
+  if (bx1 < 0)
+    return cvRect(0, 0, 0, 0);
+
+  return cvRect(bx0, by0, bx1 - bx0 + 1, by1 - by0 + 1);
+}
@@ -0,0 +1,72 @@
+/*
+ * grid.h - Uniform grid index over tracked feature points
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _GRID_H_
+#define _GRID_H_
+
+// includes
+#include "common.h"
+#include "cv.h"
+
+// namespace preparation
+using namespace std;
+
+class PointGrid{
+  /* Buckets the feature points of one frame into square cells so that
+     region queries only visit the cells they overlap.  Cells that lie
+     completely inside the queried region are counted without looking at
+     their points; only the cells on the region border are tested point
+     by point.
+
+     Points are snapped to pixels the same way draw_points() rasterizes
+     them and points outside the frame are dropped, so counts agree with
+     the old mask based queries (except that two points landing on the
+     same pixel are counted twice).
+  */
+ public:
+  static const int CELL_SIZE; // side of a grid cell in pixels
+
+  PointGrid();
+  ~PointGrid();
+
+  // Action Functions
+  void prepare(const CvSize& frame_size, int max_points); // size storage up front
+  void build(const CvPoint2D32f* pts, int num_pts, const CvSize& frame_size,
+             double scale = 1.0); // points are multiplied by scale first
+  void clear();
+
+  // Access Functions
+  int count() const; // number of indexed points
+  int count_in_rect(const CvRect&) const; // rect is inclusive, like draw_comp
+  int count_in_box(const CvBox2D*) const;
+  int count_in_poly(const CvPoint*, int) const; // convex polygon only
+  CvRect bounds_in_rect(const CvRect&) const; // same result as cvBoundingRect
+  const CvSize& size() const;
+  const CvPoint* points() const; // all count() indexed points, in cell order
+
+ private:
+  CvSize frame_size;
+  int cols, rows;
+  int *cell_start; // offsets of each cell's points in cell_pts
+  CvPoint *cell_pts; // indexed points ordered by cell
+  CvRect *cell_bounds; // bounding rect of the points in each cell
+  int point_capacity, cell_capacity;
+  int _count;
+
+  // methods
+  void reserve(int num_pts, int num_cells);
+  bool clip(const CvRect&, int&, int&, int&, int&) const; // to frame corners
+};
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * history.cxx - Implementation of CompactHistory class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "history.h"
+#include "pool.h"
+#include "img_template.tpl"
+
+// Constructors
+
+CompactHistory::CompactHistory(){
+  _depth = IPL_DEPTH_8U;
+  size = cvSize(0, 0);
+  area = cvRect(0, 0, 0, 0);
+  stamps = visited = NULL;
+  current = 0;
+  oldest = 1;
+  pending_threshold = 1;
+  pending_offset = 0;
+  _rebases = 0;
+}
+
+CompactHistory::~CompactHistory(){
+  release();
+}
+
+// Settings Functions
+
+void CompactHistory::set_depth(int depth){
+  if (depth == _depth)
+    return;
+
+  release();
+  _depth = depth;
+}
+
+int CompactHistory::depth() const{
+  return _depth;
+}
+
+// Action Functions
+
+void CompactHistory::prepare(const CvSize& size_){
+  if (stamps && size_.width == size.width && size_.height == size.height)
+    return;
+
+  release();
+  ImagePool& pool = ImagePool::shared();
+  size = size_;
+  area = cvRect(0, 0, size.width, size.height);
+  stamps = pool.acquire(size, _depth, 1);
+  visited = pool.acquire(size, IPL_DEPTH_8U, 1);
+  times.assign(max_stamp() + 1, 0.f);
+  clear();
+}
+
+void CompactHistory::release(){
+  ImagePool& pool = ImagePool::shared();
+  pool.release(stamps);
+  pool.release(visited);
+  size = cvSize(0, 0);
+}
+
+void CompactHistory::clear(){
+  if (stamps)
+    cvZero(stamps);
+  current = 0;
+  oldest = 1;
+}
+
+void CompactHistory::set_area(const CvRect& area_){
+  int x0 = MIN(MAX(area_.x, 0), size.width), y0 = MIN(MAX(area_.y, 0), size.height);
+  int x1 = MIN(MAX(area_.x + area_.width, x0), size.width);
+  int y1 = MIN(MAX(area_.y + area_.height, y0), size.height);
+  area = cvRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+int CompactHistory::max_stamp() const{
+  return _depth == IPL_DEPTH_16U ? 65535 : 255;
+}
+
+void CompactHistory::update(const IplImage* silh, double timestamp, double duration){
+  begin_update(cvGetSize(silh), timestamp, duration);
+  update_rows(silh, area);
+}
+
+void CompactHistory::begin_update(const CvSize& frame_size, double timestamp, double duration){
+  prepare(frame_size);
+
+  // stamps whose frames are older than the duration are dead
+  float expired = (float)(timestamp - duration);
+  while (oldest <= current && times[oldest] < expired){
+    ++oldest;
+  }
+
+  // out of stamps, shift the live ones down to start at 1
+  int threshold = oldest; // live stamps before the shift
+  int offset = 0;
+  if (current == max_stamp()){
+    offset = oldest - 1;
+    if (offset == 0){ // all live, drop the older half
+      offset = max_stamp() / 2;
+      threshold = offset + 1;
+    }
+    for (int s = offset + 1; s <= current; ++s){
+      times[s - offset] = times[s];
+    }
+    current -= offset;
+    oldest = threshold - offset;
+    ++_rebases;
+  }
+
+  times[++current] = (float)timestamp;
+  pending_threshold = threshold;
+  pending_offset = offset;
+}
+
+void CompactHistory::update_rows(const IplImage* silh, const CvRect& band) const{
+  // the part of band within the area
+  int x0 = MAX(band.x, area.x), y0 = MAX(band.y, area.y);
+  int x1 = MIN(band.x + band.width, area.x + area.width);
+  int y1 = MIN(band.y + band.height, area.y + area.height);
+  if (x1 <= x0 || y1 <= y0)
+    return;
+
+  CvRect rows = cvRect(x0, y0, x1 - x0, y1 - y0);
+  if (_depth == IPL_DEPTH_16U)
+    update_stamps<unsigned short>(silh, rows);
+  else
+    update_stamps<unsigned char>(silh, rows);
+}
+
+template<class T> void CompactHistory::update_stamps(const IplImage* silh, const CvRect& rows) const{
+  // one pass: stamp moving pixels, clear dead ones, shift the rest
+  Image<T> history = Image<T>(stamps).sub(rows);
+  BwImage moved = BwImage(silh).sub(rows);
+  T stamp = (T)current;
+  int threshold = pending_threshold, offset = pending_offset;
+  typename Image<T>::row_iterator h = history.begin();
+  for (BwImage::row_iterator s = moved.begin(); s != moved.end(); ++s, ++h){
+    T* IMAGE_RESTRICT row = (*h).begin();
+    const unsigned char* IMAGE_RESTRICT m = (*s).begin();
+    int width = (*s).size();
+    for (int x = 0; x < width; ++x){
+      int v = row[x];
+      row[x] = m[x] ? stamp : v < threshold ? 0 : (T)(v - offset);
+    }
+  }
+}
+
+CvSeq* CompactHistory::segment(CvMemStorage* storage, double seg_thresh){
+  if (!stamps)
+    return cvCreateSeq(0, sizeof(CvSeq), sizeof(CvConnectedComp), storage);
+
+  if (_depth == IPL_DEPTH_16U)
+    return segment_stamps<unsigned short>(storage, (float)seg_thresh);
+  return segment_stamps<unsigned char>(storage, (float)seg_thresh);
+}
+
+CvSeq* CompactHistory::segment(CvMemStorage* storage, double seg_thresh,
+                               BandSegmenter& bands, WorkerPool& workers){
+  if (!stamps)
+    return cvCreateSeq(0, sizeof(CvSeq), sizeof(CvConnectedComp), storage);
+  return bands.segment(stamps, times, current, area, seg_thresh, storage, workers);
+}
+
+template<class T> CvSeq* CompactHistory::segment_stamps(CvMemStorage* storage, float seg_thresh){
+  CvSeq* segs = cvCreateSeq(0, sizeof(CvSeq), sizeof(CvConnectedComp), storage);
+  if (current == 0)
+    return segs;
+
+  Image<T> history(stamps);
+  Image<unsigned char> done(visited);
+  cvZero(visited);
+  T stamp = (T)current;
+  const int dx[4] = {1, -1, 0, 0};
+  const int dy[4] = {0, 0, 1, -1};
+
+  for (int y = area.y; y < area.y + area.height; ++y){
+    T* row = history[y];
+    for (int x = area.x; x < area.x + area.width; ++x){
+      if (row[x] != stamp || done[y][x])
+        continue;
+
+      // grow a segment from a pixel that moved this frame
+      int x0 = x, x1 = x, y0 = y, y1 = y;
+      long pixels = 0;
+      done[y][x] = 1;
+      stack.clear();
+      stack.push_back(y * size.width + x);
+      while (!stack.empty()){
+        int px = stack.back() % size.width, py = stack.back() / size.width;
+        stack.pop_back();
+        ++pixels;
+        x0 = MIN(x0, px);
+        x1 = MAX(x1, px);
+        y0 = MIN(y0, py);
+        y1 = MAX(y1, py);
+
+        float reach = times[history[py][px]] - seg_thresh;
+        for (int i = 0; i < 4; ++i){
+          int nx = px + dx[i], ny = py + dy[i];
+          if (nx < 0 || ny < 0 || nx >= size.width || ny >= size.height || done[ny][nx])
+            continue;
+          int v = history[ny][nx];
+          if (v == 0 || times[v] < reach)
+            continue;
+          done[ny][nx] = 1;
+          stack.push_back(ny * size.width + nx);
+        }
+      }
+
+      CvConnectedComp comp;
+      comp.area = (double)pixels;
+      comp.value = cvRealScalar(segs->total + 1);
+      comp.rect = cvRect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+      comp.contour = NULL;
+      cvSeqPush(segs, &comp);
+    }
+  }
+
+  return segs;
+}
+
+void CompactHistory::get_ages(int y, unsigned short* ages, double duration) const{
+  float now = current ? times[current] : 0.f;
+  bool wide = _depth == IPL_DEPTH_16U;
+  const char* row = stamps->imageData + y * stamps->widthStep;
+  for (int x = 0; x < size.width; ++x){
+    int v = wide ? ((const unsigned short*)row)[x] : ((const unsigned char*)row)[x];
+    double age = v >= oldest ? now - times[v] : duration;
+    ages[x] = age < duration ? (unsigned short)(1 + MIN(cvRound(age * 1000), 65534)) : 0;
+  }
+}
+
+void CompactHistory::set_ages(const unsigned short* ages, double timestamp, double duration){
+  // ages are binned into evenly spaced stamps, leaving room above them
+  int duration_ms = MAX(cvRound(duration * 1000), 1);
+  int levels = MIN(max_stamp() / 2, duration_ms + 1);
+  clear();
+  for (int s = 1; s <= levels; ++s){
+    times[s] = (float)(timestamp - (double)(levels - s) * duration / MAX(levels - 1, 1));
+  }
+  current = levels;
+
+  bool wide = _depth == IPL_DEPTH_16U;
+  for (int y = 0; y < size.height; ++y){
+    char* row = stamps->imageData + y * stamps->widthStep;
+    for (int x = 0; x < size.width; ++x){
+      int age = ages[y * size.width + x];
+      int v = 0;
+      if (age > 0 && age - 1 < duration_ms)
+        v = levels - (int)((long)(age - 1) * (levels - 1) / duration_ms);
+      if (wide)
+        ((unsigned short*)row)[x] = (unsigned short)v;
+      else
+        ((unsigned char*)row)[x] = (unsigned char)v;
+    }
+  }
+}
+
+// Access Functions
+
+long CompactHistory::rebases() const{
+  return _rebases;
+}
@@ -0,0 +1,102 @@
+/*
+ * history.h - Motion history image with integer frame stamps
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+// includes
+#include "segment.h"
+#include "workers.h"
+#include "cv.h"
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+class CompactHistory{
+  /* A motion history image that stores an 8 or 16 bit stamp per pixel
+     instead of a float time, a quarter or half of the memory traffic of
+     cvUpdateMotionHistory() and cvSegmentMotion().
+
+     Every update takes the next stamp and remembers the time of its
+     frame; 0 means no motion.  Stamps older than the history duration
+     are dead and cleared as the update passes over them.  When stamps
+     run out, the live ones are shifted down to start at 1 as part of
+     that same pass.  Should more frames than stamps fall within the
+     duration (over 254 frames a second with 8 bits), the older half is
+     dropped early.
+
+     Segments are found the way cvSegmentMotion() finds them: grown from
+     pixels that moved in the last frame through 4-neighbors that moved
+     no more than seg_thresh seconds before the pixel they are reached
+     from.
+
+     Updates and segmentation can be limited to an area of the frame;
+     pixels outside it are never visited and must hold no motion.
+
+     An update can also be split up: begin_update() does the
+     bookkeeping, then update_rows() stamps any bands of rows, at the
+     same time from several threads if need be, until every row of the
+     area was stamped once.
+  */
+ public:
+  CompactHistory();
+  ~CompactHistory();
+
+  // Settings Functions
+  void set_depth(int depth); // IPL_DEPTH_8U or IPL_DEPTH_16U, clears the history
+  int depth() const;
+
+  // Action Functions
+  void prepare(const CvSize&); // allocate buffers for this frame size
+  void release(); // hand buffers back to the pool
+  void clear(); // no motion anywhere
+  void set_area(const CvRect&); // pixels updates and segmentation visit, after prepare
+  void update(const IplImage* silh, double timestamp, double duration);
+  void begin_update(const CvSize&, double timestamp, double duration);
+  void update_rows(const IplImage* silh, const CvRect& band) const; // after begin_update
+  CvSeq* segment(CvMemStorage*, double seg_thresh); // CvConnectedComp sequence
+  CvSeq* segment(CvMemStorage*, double seg_thresh, BandSegmenter&, WorkerPool&); // in bands
+
+  // snapshots, as ms since the last update plus one, 0 for no motion
+  void get_ages(int row, unsigned short* ages, double duration) const;
+  void set_ages(const unsigned short* ages, double timestamp, double duration); // whole image
+
+  // Access Functions
+  long rebases() const; // times stamps ran out and were shifted down
+
+ private:
+  int _depth;
+  CvSize size;
+  CvRect area; // pixels visited, the whole frame unless set_area was called
+  IplImage *stamps;
+  IplImage *visited; // pixels already in a segment
+  vector<float> times; // frame time of each stamp
+  vector<int> stack; // pixels waiting to be grown from
+  int current; // stamp of the last update, 0 before the first
+  int oldest; // oldest live stamp
+  int pending_threshold, pending_offset; // of the update begun last
+  long _rebases;
+
+  // methods
+  int max_stamp() const;
+  template<class T> void update_stamps(const IplImage* silh, const CvRect& rows) const;
+  template<class T> CvSeq* segment_stamps(CvMemStorage*, float seg_thresh);
+
+  // not copyable
+  CompactHistory(const CompactHistory&);
+  CompactHistory& operator=(const CompactHistory&);
+};
+
+#endif
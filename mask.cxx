@@ -0,0 +1,192 @@
+/*
+ * mask.cxx - Implementation of ExclusionMask class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "mask.h"
+#include "pool.h"
+#include "img_template.tpl"
+#include <string.h>
+
+// constants
+static const int TILE_SIZE = 32;	// tile side in pixels
+
+// Constructors
+
+ExclusionMask::ExclusionMask(){
+  source = NULL;
+  dirty = false;
+  scaled = NULL;
+  size = cvSize(0, 0);
+  _bounds = cvRect(0, 0, 0, 0);
+  kept_pixels = 0;
+  tiles_x = tiles_y = 0;
+}
+
+ExclusionMask::~ExclusionMask(){
+  release();
+}
+
+// Settings Functions
+
+void ExclusionMask::set_source(const IplImage* source_){
+  source = source_;
+  dirty = true;
+}
+
+// Action Functions
+
+void ExclusionMask::prepare(const CvSize& size_){
+  if (!dirty && size_.width == size.width && size_.height == size.height)
+    return;
+
+  release();
+  dirty = false;
+  size = size_;
+  _bounds = cvRect(0, 0, size.width, size.height);
+  kept_pixels = (long)size.width * size.height;
+  if (!source)
+    return;
+
+  scaled = ImagePool::shared().acquire(size, IPL_DEPTH_8U, 1);
+  if (source->width == size.width && source->height == size.height)
+    cvCopy(source, scaled);
+  else
+    cvResize(source, scaled, CV_INTER_NN); // masks stay binary
+  classify();
+}
+
+void ExclusionMask::release(){
+  ImagePool::shared().release(scaled);
+  size = cvSize(0, 0);
+  tiles.clear();
+  tiles_x = tiles_y = 0;
+}
+
+void ExclusionMask::classify(){
+  // one pass over the mask for the tile states and the kept bounds
+  tiles_x = (size.width + TILE_SIZE - 1) / TILE_SIZE;
+  tiles_y = (size.height + TILE_SIZE - 1) / TILE_SIZE;
+  vector<int> counts(tiles_x * tiles_y, 0);
+  int x0 = size.width, y0 = size.height, x1 = -1, y1 = -1;
+  kept_pixels = 0;
+
+  BwImage mask(scaled);
+  for (int y = 0; y < size.height; ++y){
+    const unsigned char* row = mask[y];
+    int* tile_counts = &counts[(y / TILE_SIZE) * tiles_x];
+    for (int x = 0; x < size.width; ++x){
+      if (!row[x])
+        continue;
+      ++tile_counts[x / TILE_SIZE];
+      x0 = MIN(x0, x);
+      x1 = MAX(x1, x);
+      y0 = MIN(y0, y);
+      y1 = MAX(y1, y);
+    }
+  }
+
+  tiles.resize(counts.size());
+  for (int ty = 0; ty < tiles_y; ++ty){
+    for (int tx = 0; tx < tiles_x; ++tx){
+      int w = MIN(TILE_SIZE, size.width - tx * TILE_SIZE);
+      int h = MIN(TILE_SIZE, size.height - ty * TILE_SIZE);
+      int count = counts[ty * tiles_x + tx];
+      kept_pixels += count;
+      tiles[ty * tiles_x + tx] = count == 0 ? TILE_EXCLUDED :
+                                 count == w * h ? TILE_KEPT : TILE_MIXED;
+    }
+  }
+
+  if (x1 < 0)
+    _bounds = cvRect(0, 0, 0, 0); // nothing kept
+  else
+    _bounds = cvRect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
+
+void ExclusionMask::apply(IplImage* img) const{
+  if (scaled)
+    apply_tiles(img, cvRect(0, 0, size.width, size.height));
+}
+
+void ExclusionMask::apply_within_bounds(IplImage* img) const{
+  if (scaled)
+    apply_tiles(img, _bounds);
+}
+
+void ExclusionMask::apply_within(IplImage* img, const CvRect& area) const{
+  // bands of one image may be applied at the same time, from several threads
+  if (!scaled)
+    return;
+  int x0 = MAX(area.x, _bounds.x), y0 = MAX(area.y, _bounds.y);
+  int x1 = MIN(area.x + area.width, _bounds.x + _bounds.width);
+  int y1 = MIN(area.y + area.height, _bounds.y + _bounds.height);
+  if (x1 > x0 && y1 > y0)
+    apply_tiles(img, cvRect(x0, y0, x1 - x0, y1 - y0));
+}
+
+void ExclusionMask::apply_tiles(IplImage* img, const CvRect& area) const{
+  if (area.width <= 0 || area.height <= 0)
+    return;
+
+  BwImage pixels(img), mask(scaled);
+  int tx0 = area.x / TILE_SIZE, tx1 = (area.x + area.width - 1) / TILE_SIZE;
+  int ty0 = area.y / TILE_SIZE, ty1 = (area.y + area.height - 1) / TILE_SIZE;
+  for (int ty = ty0; ty <= ty1; ++ty){
+    for (int tx = tx0; tx <= tx1; ++tx){
+      int state = tiles[ty * tiles_x + tx];
+      if (state == TILE_KEPT)
+        continue;
+
+      // the tile's part of area, in both images
+      CvRect tile = cvRect(tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+      int x0 = MAX(tile.x, area.x), y0 = MAX(tile.y, area.y);
+      tile.width = MIN(tile.x + TILE_SIZE, area.x + area.width) - x0;
+      tile.height = MIN(tile.y + TILE_SIZE, area.y + area.height) - y0;
+      tile.x = x0;
+      tile.y = y0;
+      BwImage out = pixels.sub(tile);
+      BwImage keep = mask.sub(tile);
+
+      BwImage::row_iterator o = out.begin(), k = keep.begin();
+      for (; o != out.end(); ++o, ++k){
+        RowSpan<unsigned char> row = *o;
+        if (state == TILE_EXCLUDED){
+          memset(row.begin(), 0, row.size());
+          continue;
+        }
+
+        // mask pixels are 0 or not, a select the compiler vectorizes
+        unsigned char* IMAGE_RESTRICT dst = row.begin();
+        const unsigned char* IMAGE_RESTRICT m = (*k).begin();
+        for (int x = 0; x < row.size(); ++x){
+          dst[x] = m[x] ? dst[x] : 0;
+        }
+      }
+    }
+  }
+}
+
+// Access Functions
+
+bool ExclusionMask::active() const{
+  return scaled != NULL;
+}
+
+const IplImage* ExclusionMask::image() const{
+  return scaled;
+}
+
+const CvRect& ExclusionMask::bounds() const{
+  return _bounds;
+}
+
+double ExclusionMask::kept() const{
+  long total = (long)size.width * size.height;
+  return total > 0 ? (double)kept_pixels / total : 1.0;
+}
@@ -0,0 +1,77 @@
+/*
+ * mask.h - Static exclusion mask of a stream
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _MASK_H_
+#define _MASK_H_
+
+// includes
+#include "cv.h"
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+class ExclusionMask{
+  /* The parts of a stream not worth processing: burned-in timestamps,
+     swaying trees, sky.  The source mask may be any size and is scaled
+     to each component's frame size; its zero pixels are excluded.
+
+     The scaled mask is cut into square tiles, each fully excluded, fully
+     kept or mixed, and the bounds of all kept pixels are kept as well.
+     Kernels restrict themselves to bounds(), and apply() leaves kept
+     tiles alone and clears excluded ones without reading the mask, so
+     only mixed tiles cost a pixel-by-pixel pass.
+  */
+ public:
+  ExclusionMask();
+  ~ExclusionMask();
+
+  // Settings Functions
+  void set_source(const IplImage*); // 8 bit, 1 channel, not owned; NULL for no mask
+
+  // Action Functions
+  void prepare(const CvSize&); // scale the source to this size, if it changed
+  void release();
+  void apply(IplImage*) const; // zero every excluded pixel of an 8 bit image
+  void apply_within_bounds(IplImage*) const; // leaving pixels outside bounds() alone
+  void apply_within(IplImage*, const CvRect& area) const; // the part of area within bounds()
+
+  // Access Functions
+  bool active() const; // a source is set and prepared
+  const IplImage* image() const; // scaled mask, NULL when not active
+  const CvRect& bounds() const; // kept pixels, the whole frame when not active
+  double kept() const; // fraction of the frame kept
+
+ private:
+  enum TileState{ TILE_EXCLUDED, TILE_MIXED, TILE_KEPT };
+
+  const IplImage* source;
+  bool dirty; // source changed since the last prepare
+  IplImage* scaled;
+  CvSize size;
+  CvRect _bounds;
+  long kept_pixels;
+  int tiles_x, tiles_y;
+  vector<unsigned char> tiles; // TileState, row by row
+
+  // methods
+  void classify();
+  void apply_tiles(IplImage*, const CvRect& area) const;
+
+  // not copyable
+  ExclusionMask(const ExclusionMask&);
+  ExclusionMask& operator=(const ExclusionMask&);
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * params.cxx - Implementation of TrackParams
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "params.h"
+#include "common.h"	// MAX_POINTS_TO_TRACK, WINDOW_SIZE
+
+// every parameter by name, exactly one of the members is set
+struct ParamField{
+  const char* name;
+  int TrackParams::* i;
+  double TrackParams::* d;
+};
+
+static const ParamField FIELDS[] = {
+  {"diff_threshold", &TrackParams::diff_threshold, NULL},
+  {"mhi_duration", NULL, &TrackParams::mhi_duration},
+  {"max_time_delta", NULL, &TrackParams::max_time_delta},
+  {"hdims", &TrackParams::hdims, NULL},
+  {"vmin", &TrackParams::vmin, NULL},
+  {"vmax", &TrackParams::vmax, NULL},
+  {"smin", &TrackParams::smin, NULL},
+  {"lost_density", NULL, &TrackParams::lost_density},
+  {"reacquire_density", NULL, &TrackParams::reacquire_density},
+  {"reacquire_scale", NULL, &TrackParams::reacquire_scale},
+  {"reacquire_models", &TrackParams::reacquire_models, NULL},
+  {"window_size", &TrackParams::window_size, NULL},
+  {"max_points", &TrackParams::max_points, NULL},
+  {"feature_quality", NULL, &TrackParams::feature_quality},
+  {"feature_distance", NULL, &TrackParams::feature_distance},
+  {"cluster_radius", NULL, &TrackParams::cluster_radius},
+  {"cluster_velocity", NULL, &TrackParams::cluster_velocity},
+  {"cluster_min_speed", NULL, &TrackParams::cluster_min_speed},
+  {"cluster_min_points", &TrackParams::cluster_min_points, NULL},
+  {"focus_density_gain", NULL, &TrackParams::focus_density_gain},
+  {"focus_point_share", NULL, &TrackParams::focus_point_share},
+  {"focus_box_size", NULL, &TrackParams::focus_box_size},
+  {"focus_overlap", NULL, &TrackParams::focus_overlap},
+  {"focus_seg_overlap", NULL, &TrackParams::focus_seg_overlap},
+  {"focus_seg_size", NULL, &TrackParams::focus_seg_size},
+  {"focus_drift_area", NULL, &TrackParams::focus_drift_area},
+  {"focus_drift_box_size", NULL, &TrackParams::focus_drift_box_size},
+  {"focus_drift_overlap", NULL, &TrackParams::focus_drift_overlap}
+};
+static const int NUM_FIELDS = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+static const ParamField* find_field(const string& name){
+  for (int i = 0; i < NUM_FIELDS; ++i){
+    if (name == FIELDS[i].name)
+      return &FIELDS[i];
+  }
+  return NULL;
+}
+
+// Constructors
+
+TrackParams::TrackParams(){
+  diff_threshold = 30;
+  mhi_duration = 1.0;
+  max_time_delta = 0.5;
+
+  hdims = 16;
+  vmin = 10;
+  vmax = 256;
+  smin = 30;
+
+  lost_density = 0.05;
+  reacquire_density = 0.3;
+  reacquire_scale = 0.25;
+  reacquire_models = 4;
+
+  window_size = WINDOW_SIZE;
+  max_points = MAX_POINTS_TO_TRACK;
+  feature_quality = 0.01;
+  feature_distance = 10;
+
+  cluster_radius = 30;
+  cluster_velocity = 1.0;
+  cluster_min_speed = 0.5;
+  cluster_min_points = 6;
+
+  focus_density_gain = 1.08;
+  focus_point_share = 0.6;
+  focus_box_size = 0.6;
+  focus_overlap = 0.5;
+
+  focus_seg_overlap = 0.15;
+  focus_seg_size = 0.02;
+  focus_drift_area = 0.01;
+  focus_drift_box_size = 0.2;
+  focus_drift_overlap = 0.55;
+}
+
+// Settings Functions
+
+bool TrackParams::set(const string& name, double value){
+  const ParamField* field = find_field(name);
+  if (!field)
+    return false;
+
+  if (field->i)
+    this->*(field->i) = (int)(value < 0 ? value - 0.5 : value + 0.5);
+  else
+    this->*(field->d) = value;
+  return true;
+}
+
+// Access Functions
+
+bool TrackParams::get(const string& name, double& value) const{
+  const ParamField* field = find_field(name);
+  if (!field)
+    return false;
+
+  value = field->i ? (double)(this->*(field->i)) : this->*(field->d);
+  return true;
+}
+
+void TrackParams::print(ostream& out) const{
+  TrackParams defaults;
+  bool first = true;
+  for (int i = 0; i < NUM_FIELDS; ++i){
+    double value, default_value;
+    get(FIELDS[i].name, value);
+    defaults.get(FIELDS[i].name, default_value);
+    if (value == default_value)
+      continue;
+
+    out << (first ? "" : " ") << FIELDS[i].name << "=" << value;
+    first = false;
+  }
+  if (first)
+    out << "defaults";
+}
+
+vector<string> TrackParams::names(){
+  vector<string> all;
+  for (int i = 0; i < NUM_FIELDS; ++i){
+    all.push_back(FIELDS[i].name);
+  }
+  return all;
+}
@@ -0,0 +1,80 @@
+/*
+ * params.h - Runtime tuning parameters of the tracking components
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _PARAMS_H_
+#define _PARAMS_H_
+
+// includes
+#include <iostream>
+#include <string>
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+struct TrackParams{
+  /* Every knob of Flow, Track and Focus that used to be a constant.  The
+     defaults are the values those constants had.  Parameters can also
+     be read and written by name, for command lines and tuning sweeps.
+  */
+  TrackParams();
+
+  // motion segmentation
+  int diff_threshold; // gray level change that counts as motion
+  double mhi_duration; // seconds motion stays in the history
+  double max_time_delta; // seconds between neighbors for one segment
+
+  // camshift color model
+  int hdims; // hue histogram bins
+  int vmin, vmax, smin; // value and saturation range of usable pixels
+
+  // finding a lost object again by its color
+  double lost_density; // mean backprojection in the window, over 255, below which the object is lost
+  double reacquire_density; // mean backprojection a remembered color needs to be taken up again
+  double reacquire_scale; // search resolution as a fraction of the tracking frame
+  int reacquire_models; // color models remembered, 0 to never search
+
+  // feature points
+  int window_size; // corner and flow search window, pixels
+  int max_points; // points found by init, at most MAX_POINTS_TO_TRACK
+  double feature_quality; // corner quality relative to the best corner
+  double feature_distance; // minimum pixels between corners
+
+  // grouping feature point trajectories into objects
+  double cluster_radius; // flow pixels between neighbors of one object
+  double cluster_velocity; // pixels per frame their motion may differ by
+  double cluster_min_speed; // pixels per frame a point must move
+  int cluster_min_points; // points an object needs
+
+  // focus changes decided by feature points
+  double focus_density_gain; // segment density over box density
+  double focus_point_share; // segment points over box points
+  double focus_box_size; // box area over frame area
+  double focus_overlap; // coverage of segment or box below which they differ
+
+  // focus changes decided by overlap
+  double focus_seg_overlap; // segment coverage below which a better region exists
+  double focus_seg_size; // segment area over frame area
+  double focus_drift_area; // shared area over frame area for drifting
+  double focus_drift_box_size; // box area over frame area for drifting
+  double focus_drift_overlap; // box coverage below which the box drifted
+
+  bool set(const string& name, double value); // false for unknown names
+  bool get(const string& name, double& value) const;
+  void print(ostream&) const; // name=value pairs that differ from the defaults
+
+  static vector<string> names();
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * pool.cxx - Implementation of ImagePool class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "pool.h"
+
+bool ImagePool::Key::operator<(const Key& other) const{
+  if (width != other.width)
+    return width < other.width;
+  if (height != other.height)
+    return height < other.height;
+  if (depth != other.depth)
+    return depth < other.depth;
+  return channels < other.channels;
+}
+
+// Constructors
+
+ImagePool::ImagePool(){
+  _allocations = 0;
+  pthread_mutex_init(&lock, NULL);
+}
+
+ImagePool::~ImagePool(){
+  clear();
+  pthread_mutex_destroy(&lock);
+}
+
+ImagePool& ImagePool::shared(){
+  static ImagePool pool;
+  return pool;
+}
+
+// Action Functions
+
+IplImage* ImagePool::acquire(const CvSize& size, int depth, int channels){
+  Key key = {size.width, size.height, depth, channels};
+  IplImage* img = NULL;
+
+  pthread_mutex_lock(&lock);
+  multimap<Key, IplImage*>::iterator found = idle_images.find(key);
+  if (found != idle_images.end()){
+    img = found->second;
+    idle_images.erase(found);
+  }
+  else{
+    ++_allocations;
+  }
+  pthread_mutex_unlock(&lock);
+
+  if (!img)
+    img = cvCreateImage(size, depth, channels);
+
+  return img;
+}
+
+void ImagePool::release(IplImage*& img){
+  if (!img)
+    return;
+
+  // leave no state behind for the next user
+  cvResetImageROI(img);
+  img->origin = IPL_ORIGIN_TL;
+
+  Key key = {img->width, img->height, img->depth, img->nChannels};
+  pthread_mutex_lock(&lock);
+  idle_images.insert(make_pair(key, img));
+  pthread_mutex_unlock(&lock);
+
+  img = NULL;
+}
+
+void ImagePool::clear(){
+  pthread_mutex_lock(&lock);
+  for (multimap<Key, IplImage*>::iterator i = idle_images.begin(); i != idle_images.end(); ++i){
+    cvReleaseImage(&i->second);
+  }
+  idle_images.clear();
+  pthread_mutex_unlock(&lock);
+}
+
+// Access Functions
+
+long ImagePool::allocations() const{
+  pthread_mutex_lock(&lock);
+  long count = _allocations;
+  pthread_mutex_unlock(&lock);
+  return count;
+}
+
+int ImagePool::idle() const{
+  pthread_mutex_lock(&lock);
+  int count = (int)idle_images.size();
+  pthread_mutex_unlock(&lock);
+  return count;
+}
@@ -0,0 +1,61 @@
+/*
+ * pool.h - Shared, size keyed pool of working images
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+// includes
+#include "cv.h"
+#include <map>
+#include <pthread.h>
+
+// namespace preparation
+using namespace std;
+
+class ImagePool{
+  /* Keeps released images around, keyed by size, depth and channels, so
+     components can hand their working buffers back and the next
+     component (or the next stream) of the same frame size gets them
+     without allocating.  All components use the shared() pool; it is
+     safe to use from several threads.
+  */
+ public:
+  ImagePool();
+  ~ImagePool(); // frees idle images; images still out are the holder's
+
+  IplImage* acquire(const CvSize&, int depth, int channels); // contents undefined
+  void release(IplImage*&); // hand back and NULL the pointer (NULL is ok)
+  void clear(); // free every idle image
+
+  long allocations() const; // images created so far
+  int idle() const; // images waiting to be reused
+
+  static ImagePool& shared();
+
+ private:
+  struct Key{
+    int width, height, depth, channels;
+    bool operator<(const Key&) const;
+  };
+
+  multimap<Key, IplImage*> idle_images;
+  long _allocations;
+  mutable pthread_mutex_t lock;
+
+  // not copyable
+  ImagePool(const ImagePool&);
+  ImagePool& operator=(const ImagePool&);
+};
+
+#endif
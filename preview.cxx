@@ -0,0 +1,114 @@
+/*
+ * preview.cxx - Implementation of PreviewServer class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "preview.h"
+#include "control.h"	// listen_unix
+#include "stats.h"	// monotonic clock
+#include <errno.h>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const char* STREAM_HEADER =
+  "HTTP/1.0 200 OK\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Content-Type: multipart/x-mixed-replace; boundary=satoriframe\r\n\r\n";
+static const int JPEG_QUALITY = 70;
+
+// Constructors
+
+PreviewServer::PreviewServer(double max_fps){
+  listen_fd = -1;
+  interval = max_fps > 0.0 ? 1.0 / max_fps : 0.0;
+  last_sent = 0.0;
+}
+
+PreviewServer::~PreviewServer(){
+  for (size_t i = 0; i < clients.size(); ++i){
+    close(clients[i]);
+  }
+  if (listen_fd >= 0){
+    close(listen_fd);
+    unlink(socket_path.c_str());
+  }
+}
+
+// Action Functions
+
+bool PreviewServer::listen(const string& path){
+  listen_fd = listen_unix(path);
+  if (listen_fd < 0)
+    return false;
+
+  socket_path = path;
+  return true;
+}
+
+void PreviewServer::accept_clients(){
+  if (listen_fd < 0)
+    return;
+
+  int client;
+  while ((client = accept(listen_fd, NULL, NULL)) >= 0){
+    fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+    if (write_all(client, STREAM_HEADER, strlen(STREAM_HEADER)))
+      clients.push_back(client);
+    else
+      close(client);
+  }
+}
+
+bool PreviewServer::write_all(int fd, const char* data, size_t size){
+  // a short or failed write would corrupt the stream, so it drops the client
+  while (size > 0){
+    ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool PreviewServer::due(){
+  accept_clients();
+  return !clients.empty() && monotonic_seconds() - last_sent >= interval;
+}
+
+void PreviewServer::send(const IplImage* frame){
+  if (clients.empty())
+    return;
+
+  int params[] = {CV_IMWRITE_JPEG_QUALITY, JPEG_QUALITY, 0};
+  CvMat* jpeg = cvEncodeImage(".jpg", frame, params);
+  if (!jpeg)
+    return;
+  last_sent = monotonic_seconds();
+
+  stringstream part;
+  part << "--satoriframe\r\n"
+       << "Content-Type: image/jpeg\r\n"
+       << "Content-Length: " << jpeg->cols << "\r\n\r\n";
+  string head = part.str();
+
+  for (int i = (int)clients.size() - 1; i >= 0; --i){
+    if (!write_all(clients[i], head.data(), head.size()) ||
+        !write_all(clients[i], (const char*)jpeg->data.ptr, jpeg->cols) ||
+        !write_all(clients[i], "\r\n", 2)){
+      close(clients[i]);
+      clients.erase(clients.begin() + i);
+    }
+  }
+
+  cvReleaseMat(&jpeg);
+}
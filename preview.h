@@ -0,0 +1,59 @@
+/*
+ * preview.h - Low rate MJPEG preview of annotated frames on a Unix socket
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _PREVIEW_H_
+#define _PREVIEW_H_
+
+// includes
+#include "common.h"
+#include "cv.h"
+#include "highgui.h"
+#include <string>
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+class PreviewServer{
+  /* Serves annotated frames as an HTTP multipart/x-mixed-replace MJPEG
+     stream to every client of a Unix stream socket, e.g.
+
+       curl --unix-socket /tmp/satori.mjpeg http://localhost/ > out.mjpeg
+
+     Frames are sent at most max_fps times a second and only when someone
+     is connected, so due() lets the caller skip annotation entirely.
+     Writes never block; a client that cannot keep up is disconnected.
+  */
+ public:
+  PreviewServer(double max_fps = 2.0);
+  ~PreviewServer();
+
+  bool listen(const string& path);
+
+  bool due(); // would a frame sent now go out to anybody?
+  void send(const IplImage* frame);
+
+ private:
+  int listen_fd;
+  string socket_path;
+  vector<int> clients;
+  double interval; // seconds between frames
+  double last_sent; // monotonic time of the last frame
+
+  // methods
+  void accept_clients();
+  bool write_all(int fd, const char* data, size_t size);
+};
+
+#endif
@@ -31,7 +31,7 @@ int main(int argc, char *argv[]){
   int optchar;							// for option input
 
   // handle input flags
-  while((optchar = getopt(argc, argv, "i:f:s?o:w:")) != -1){	// read in arguments
+  while((optchar = getopt(argc, argv, "i:f:s?o:w:S:R:P:Fq:HU:M:m:x:X:B:C:N:K:j:W:Ak:YZ:IQ:T:E:G:Vb:J:D:")) != -1){	// read in arguments
     switch(optchar){
       case 'i':			// input directory
         input_directory = new string(optarg);
@@ -49,6 +49,99 @@ int main(int argc, char *argv[]){
       case 'w':
         webcam = true;
         break;
+      case 'S':                 // statistics dump
+        stats_file = new string(optarg);
+        break;
+      case 'R':                 // record webcam session
+        record_file = new string(optarg);
+        break;
+      case 'P':                 // replay recorded session
+        replay_file = new string(optarg);
+        break;
+      case 'F':                 // replay as fast as possible
+        replay_paced = false;
+        break;
+      case 'q':                 // capture queue depth
+        capture_queue = atoi(optarg);
+        break;
+      case 'H':                 // headless live mode
+        headless = true;
+        webcam = true;
+        break;
+      case 'U':                 // command socket
+        control_socket = new string(optarg);
+        break;
+      case 'M':                 // preview socket
+        preview_socket = new string(optarg);
+        break;
+      case 'm':                 // preview frame rate
+        preview_fps = atof(optarg);
+        break;
+      case 'x':                 // processing scale
+        process_scale = atof(optarg);
+        break;
+      case 'B':                 // shared memory frame ring
+        ring_name = new string(optarg);
+        break;
+      case 'C':                 // checkpoint file
+        checkpoint_file = new string(optarg);
+        break;
+      case 'N':                 // frames between checkpoints
+        checkpoint_every = atol(optarg);
+        break;
+      case 'K':                 // resume from checkpoint
+        resume_file = new string(optarg);
+        break;
+      case 'I':                 // track index
+        write_index = true;
+        break;
+      case 'Q':                 // track index query
+        index_query = new string(optarg);
+        break;
+      case 'G':                 // idle mode
+        idle_gate = true;
+        idle_poll_ms = atoi(optarg);
+        break;
+      case 'E':                 // exclusion mask
+        mask_file = new string(optarg);
+        break;
+      case 'T':                 // tracking parameter
+        param_settings.push_back(optarg);
+        break;
+      case 'Z':                 // motion history depth
+        history_bits = atoi(optarg);
+        break;
+      case 'k':                 // keyframe interval
+        keyframe_interval = atoi(optarg);
+        break;
+      case 'Y':                 // adaptive keyframe interval
+        adaptive_keyframes = true;
+        break;
+      case 'V':                 // seed from point trajectories
+        trajectory_seeding = true;
+        break;
+      case 'D':                 // motion segmentation threads
+        motion_threads = atoi(optarg);
+        break;
+      case 'b':                 // batch manifest
+        batch_manifest = new string(optarg);
+        break;
+      case 'J':                 // batch journal
+        batch_journal = new string(optarg);
+        break;
+      case 'j':                 // chunk-parallel replay
+        replay_chunks = atoi(optarg);
+        break;
+      case 'W':                 // chunk warm-up overlap
+        chunk_overlap = atol(optarg);
+        break;
+      case 'A':                 // compare chunks with a sequential replay
+        chunk_compare = true;
+        break;
+      case 'X':                 // flow and track scales
+        if(sscanf(optarg, "%lf,%lf", &flow_scale, &track_scale) != 2)
+          return display_program_syntax();
+        break;
       default:                  // display syntax help
       case '?':
         return display_program_syntax();
@@ -69,8 +162,91 @@ int main(int argc, char *argv[]){
   // to store calculated flow information and intermediary data
   SatoriApp* app = new SatoriApp();
 
+  // answer a question about recorded motion and stop
+  if(index_query){
+    CvRect region;
+    double from, to;
+    if(sscanf(index_query->c_str(), "%d,%d,%d,%d,%lf,%lf", &region.x, &region.y,
+              &region.width, &region.height, &from, &to) != 6)
+      return display_program_syntax();
+    int result = app->query_index(*output_directory + "tracks.idx", region, from, to);
+    delete app;
+    return result;
+  }
+
+  // SIGUSR1 prints timings, SIGINT/SIGTERM stop processing cleanly
+  install_stats_signals();
+
+  // headless live mode takes commands from stdin and the command socket
+  CommandChannel commands;
+  PreviewServer preview(preview_fps);
+  if(headless){
+    commands.listen_stdin();
+    if(control_socket && !commands.listen_socket(*control_socket)){
+      cout << "[ERROR] Could not listen on " << *control_socket << "!" << endl;
+      return INVALID_SOCKET;
+    }
+    if(preview_socket && !preview.listen(*preview_socket)){
+      cout << "[ERROR] Could not listen on " << *preview_socket << "!" << endl;
+      return INVALID_SOCKET;
+    }
+    app->set_headless(&commands, preview_socket ? &preview : NULL);
+  }
+
+  // live frames may be processed below capture resolution
+  app->set_scale(process_scale, flow_scale, track_scale);
+  app->set_keyframes(keyframe_interval, adaptive_keyframes);
+  app->set_trajectory_seeding(trajectory_seeding);
+  app->set_motion_threads(motion_threads);
+  app->set_history_depth(history_bits);
+  for(size_t i = 0; i < param_settings.size(); ++i){
+    size_t eq = param_settings[i].find('=');
+    if(eq == string::npos ||
+       !app->set_param(param_settings[i].substr(0, eq), atof(param_settings[i].c_str() + eq + 1))){
+      cout << "[ERROR] Unknown tracking parameter (" << param_settings[i] << ")!" << endl;
+      return display_program_syntax();
+    }
+  }
+  app->set_idle(idle_gate, idle_poll_ms);
+  if(mask_file && !app->set_mask(*mask_file)){
+    cout << "[ERROR] Could not read mask image (" << *mask_file << ")!" << endl;
+    return display_program_syntax();
+  }
+  if(write_index)
+    app->set_index(*output_directory + "tracks.idx");
+
+  // live runs can survive a restart
+  app->set_checkpoint(checkpoint_file ? *checkpoint_file : "",
+                      checkpoint_file ? checkpoint_every : 0,
+                      resume_file ? *resume_file : "");
+
   // resolve input path name and find directory
-  if(!webcam){
+  if(batch_manifest){	// many sequences, one tracker per worker
+    if(verbose)
+      cout << "  * " << "Processing manifest " << *batch_manifest << " on " << replay_chunks << " workers" << endl;
+    app->run_batch(*batch_manifest,
+                   batch_journal ? *batch_journal : *output_directory + "batch.journal",
+                   replay_chunks, *file_format, verbose);
+  }
+  else if(replay_file && replay_chunks > 1){	// one recording over several cores
+    if(verbose)
+      cout << "  * " << "Replaying session " << *replay_file << " in " << replay_chunks << " chunks" << endl;
+    app->replay_chunked(*replay_file, replay_chunks, chunk_overlap, chunk_compare,
+                        *output_directory + "tracks.txt", verbose);
+  }
+  else if(replay_file){	// replaying a recorded session
+    if(verbose)
+      cout << "  * " << "Replaying session " << *replay_file << endl;
+    app->replay(*replay_file, replay_paced, verbose);
+  }
+  else if(ring_name){	// frames from a co-located producer
+    if(verbose)
+      cout << "  * " << "Reading frames from ring " << *ring_name << endl;
+    if(!headless)
+      display_program_commands();
+    app->run_shm(*ring_name, record_file ? *record_file : "", verbose);
+  }
+  else if(!webcam){
     fs::path full_path(fs::initial_path<fs::path>());
     full_path = fs::system_complete(fs::path(input_directory->c_str(), fs::native));
     if(!fs::exists(full_path) || !fs::is_directory(full_path)){
@@ -84,7 +260,7 @@ int main(int argc, char *argv[]){
 
     // recurse through directory and handle all valid files
     fs::directory_iterator end_iter;
-    for(fs::directory_iterator dir_itr(full_path); dir_itr != end_iter; ++dir_itr){
+    for(fs::directory_iterator dir_itr(full_path); dir_itr != end_iter && !stop_signaled(); ++dir_itr){
 
       // make sure is regular (i.e. non-directory) file
       if(fs::is_regular(dir_itr->status())){
@@ -108,6 +284,8 @@ int main(int argc, char *argv[]){
             else
               cout << "[FAIL]" << endl;
           }
+          if(stats_signaled())
+            app->get_stats().print(cout);
         }
       }
     }
@@ -117,14 +295,20 @@ int main(int argc, char *argv[]){
   }
   else{	// using webcam
     display_program_commands();
-    app->run_webcam(true);
+    app->run_webcam(true, record_file ? *record_file : "", capture_queue);
   }
   
   // output a video to the proper folder
-  if (save_output){
+  if (save_output && !stop_signaled()){
       
       app->animate(out_path.native_directory_string());
   }
+
+  // report where the time went
+  if(verbose)
+    app->get_stats().print(cout);
+  if(stats_file && !app->get_stats().dump(*stats_file))
+    cout << "[ERROR] Could not write statistics to " << *stats_file << "!" << endl;
          
   delete app;
 
@@ -150,6 +334,36 @@ int display_program_syntax(){
   cout << "  " << "-i (directory)" << ": Process all image files from the given directory (default \"" << DEFAULT_INPUT_DIRECTORY << "/\")" << endl;
   cout << "  " << "-f (file format)" << ": Read any images with the given file extension (default *" << DEFAULT_FILE_FORMAT << ")" << endl;
   cout << "  " << "-s" << ": Disable program output" << endl;
+  cout << "  " << "-S (file)" << ": Write per-stage timing statistics to the given file at exit" << endl;
+  cout << "  " << "-R (file)" << ": Record the webcam session (frames and commands) to the given file" << endl;
+  cout << "  " << "-P (file)" << ": Replay a recorded session instead of reading a webcam" << endl;
+  cout << "  " << "-j (chunks)" << ": Replay in this many chunks on separate cores, writing stitched tracks to tracks.txt in the output directory" << endl;
+  cout << "  " << "-W (frames)" << ": Warm-up frames each chunk runs before its own (default 150)" << endl;
+  cout << "  " << "-A" << ": Also replay the chunked session sequentially and report how well they agree" << endl;
+  cout << "  " << "-b (manifest)" << ": Process every 'input output' line of the manifest (sessions or image directories) on -j workers" << endl;
+  cout << "  " << "-J (file)" << ": Batch journal, jobs it lists as done are skipped (default batch.journal in the output directory)" << endl;
+  cout << "  " << "-B (name)" << ": Read frames in place from the POSIX shared memory ring of that name (see satori_shmprod)" << endl;
+  cout << "  " << "-F" << ": Replay as fast as possible instead of at the recorded pace" << endl;
+  cout << "  " << "-H" << ": Run the live loop without a window, reading commands (flow, track, reset, points, quit) from stdin" << endl;
+  cout << "  " << "-U (socket)" << ": When headless, also read commands from clients of this Unix socket" << endl;
+  cout << "  " << "-M (socket)" << ": When headless, stream annotated frames as MJPEG to clients of this Unix socket" << endl;
+  cout << "  " << "-m (fps)" << ": Preview stream frame rate (default 2)" << endl;
+  cout << "  " << "-x (scale)" << ": Process live frames at this fraction of the capture resolution (default 1)" << endl;
+  cout << "  " << "-X (flow,track)" << ": Run flow and tracking at these further fractions of the processing resolution (default 1,1)" << endl;
+  cout << "  " << "-Z (bits)" << ": Keep the motion history as 32 bit times or 16 or 8 bit frame stamps (default 32)" << endl;
+  cout << "  " << "-G (ms)" << ": Skip frames while a tiny frame difference stays quiet, sleeping this long after each live one" << endl;
+  cout << "  " << "-E (image)" << ": Never process the regions that are black in this image (scaled to the frame)" << endl;
+  cout << "  " << "-T (name=value)" << ": Set a tracking parameter, repeat for more (see satori_tune -? for names)" << endl;
+  cout << "  " << "-k (frames)" << ": Run motion segmentation and focus every this many frames, sooner when points are lost or the box drifts (default 1)" << endl;
+  cout << "  " << "-Y" << ": Stretch the keyframe interval while the focus holds still" << endl;
+  cout << "  " << "-V" << ": Start tracking on the largest group of feature points moving together, when flow finds one" << endl;
+  cout << "  " << "-D (threads)" << ": Split motion segmentation over this many cores, in bands of rows (default 1)" << endl;
+  cout << "  " << "-I" << ": Keep every track box and motion segment in tracks.idx in the output directory" << endl;
+  cout << "  " << "-Q (x,y,w,h,from,to)" << ": List motion in tracks.idx within the region between the two times (seconds of history, each run continuing after the last), then exit" << endl;
+  cout << "  " << "-C (file)" << ": Save tracker state to this file periodically and at exit" << endl;
+  cout << "  " << "-N (frames)" << ": Frames between saves of the tracker state (default 300)" << endl;
+  cout << "  " << "-K (file)" << ": Resume from saved tracker state, skipping the frames it covers when replaying" << endl;
+  cout << "  " << "-q (frames)" << ": Frames the capture thread keeps waiting, older ones are dropped (default 1, 0 captures without a thread)" << endl;
   cout << "  " << "-?" << ": Display this screen" << endl;
   cout << endl;
 
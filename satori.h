@@ -15,7 +15,9 @@
 // includes
 #include <iostream>
 #include <string>
+#include <vector>
 #include <unistd.h>
+#include <stdio.h>
 #include "boost/filesystem.hpp"   // includes all needed Boost.Filesystem declarations
 
 // namespace preparation
@@ -38,10 +40,43 @@ bool verbose = true;							// print extra information?
 string *output_directory = new string(DEFAULT_OUTPUT_DIRECTORY);	// directory to write images to
 bool webcam = false;							// getting input from a webcam?
 bool save_output = false;                                               // true when animation should be saved
+string *stats_file = NULL;						// file to dump timing statistics to
+string *record_file = NULL;						// file to record a webcam session to
+string *replay_file = NULL;						// recorded session to replay
+string *ring_name = NULL;						// shared memory frame ring to read
+bool replay_paced = true;						// replay at the recorded frame rate?
+int capture_queue = 1;							// frames kept by the capture thread (0 = no thread)
+bool headless = false;							// live mode without a window?
+string *control_socket = NULL;						// Unix socket taking commands when headless
+string *preview_socket = NULL;						// Unix socket streaming MJPEG when headless
+double preview_fps = 2.0;						// preview frame rate
+double process_scale = 1.0;						// live processing resolution vs capture
+double flow_scale = 1.0;						// flow resolution vs processing
+double track_scale = 1.0;						// track resolution vs processing
+string *checkpoint_file = NULL;						// file to save tracker state to
+long checkpoint_every = 300;						// frames between checkpoints
+string *resume_file = NULL;						// checkpoint to continue from
+int history_bits = 32;							// motion history depth (32, 16 or 8)
+int keyframe_interval = 1;						// frames between segmentation runs
+bool adaptive_keyframes = false;					// stretch the interval while focus holds
+bool trajectory_seeding = false;					// seed CAMSHIFT from moving point groups
+int motion_threads = 1;							// cores motion segmentation is split over
+bool write_index = false;						// keep a track index in the output directory
+string *index_query = NULL;						// x,y,w,h,from,to to look up in the index
+int replay_chunks = 1;							// replay split over this many cores
+long chunk_overlap = 150;						// warm-up frames before each chunk
+bool chunk_compare = false;						// also replay sequentially and compare
+string *batch_manifest = NULL;						// sequences to process in a batch
+string *batch_journal = NULL;						// progress of the batch, for resuming
+vector<string> param_settings;						// name=value tracking parameters
+string *mask_file = NULL;						// static exclusion mask image
+bool idle_gate = false;							// skip frames while nothing moves
+int idle_poll_ms = 0;							// sleep after skipped live frames
 
 // error codes
 #define INVALID_INPUT_DIRECTORY 1
 #define INVALID_OUTPUT_DIRECTORY 2
+#define INVALID_SOCKET 3
 
 // prototypes
 void display_program_header();				// display title block
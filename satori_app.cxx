@@ -24,13 +24,22 @@ SatoriApp::SatoriApp(){
   need_flow_init = false;
   need_track_init = true;
 
-  // which components should be executed in run loop
-  do_flow = false;
-  do_track = false;
+  // components time their stages into our statistics
+  tracker.set_stats(&stats);
 
-  // set pyramids to NULL in order to avoid destructor ugliness
-  prev_pyramid = NULL;
-  pyramid = NULL;
+  // live loop uses a highgui window unless made headless
+  headless = false;
+  commands = NULL;
+  preview = NULL;
+
+  // no checkpoints unless asked for
+  checkpoint_every = 0;
+
+  // every pixel is processed unless masked
+  exclusion_mask = NULL;
+
+  // every frame is processed unless idle mode is on
+  idle_poll_ms = 0;
 }
 
 SatoriApp::~SatoriApp(){
@@ -46,9 +55,8 @@ SatoriApp::~SatoriApp(){
   for(int k = 0; k < annotated_images.size(); k++){
     cvReleaseImage(&annotated_images[k]);
   }
-
-  if(prev_pyramid) cvReleaseImage(&prev_pyramid);
-  if(pyramid) cvReleaseImage(&pyramid);
+  if(exclusion_mask)
+    cvReleaseImage(&exclusion_mask);
 }
 
 // Access Functions
@@ -57,21 +65,124 @@ int SatoriApp::get_size(){
   return orig_images.size();
 }
 
+const Stats& SatoriApp::get_stats() const{
+  return stats;
+}
+
+// Settings Functions
+
+void SatoriApp::set_headless(CommandChannel* commands_, PreviewServer* preview_){
+  // run the live loop without a window: commands come from the channel and
+  // annotated frames optionally go to the preview server
+  headless = true;
+  commands = commands_;
+  preview = preview_;
+}
+
+void SatoriApp::set_scale(double scale_, double flow_scale_, double track_scale_){
+  // live frames are resized by scale once on ingest, flow and track may
+  // work at a further fraction of that
+  TrackerOptions options = tracker.options();
+  options.scale = scale_;
+  options.flow_scale = flow_scale_;
+  options.track_scale = track_scale_;
+  tracker.set_options(options);
+}
+
+void SatoriApp::set_history_depth(int bits){
+  // compact stamps cut the motion history's memory traffic by 2-4x
+  TrackerOptions options = tracker.options();
+  options.history_depth = bits == 8 ? IPL_DEPTH_8U : bits == 16 ? IPL_DEPTH_16U : IPL_DEPTH_32F;
+  tracker.set_options(options);
+}
+
+void SatoriApp::set_keyframes(int interval, bool adaptive){
+  // motion segmentation and focus only run on keyframes, CAMSHIFT and
+  // flow carry the track in between
+  TrackerOptions options = tracker.options();
+  options.keyframe_interval = interval;
+  options.adaptive_keyframes = adaptive;
+  tracker.set_options(options);
+}
+
+void SatoriApp::set_trajectory_seeding(bool seed){
+  // coherent point motion gives a window without a motion segment
+  TrackerOptions options = tracker.options();
+  options.seed_from_trajectories = seed;
+  tracker.set_options(options);
+}
+
+void SatoriApp::set_motion_threads(int threads){
+  // bands of rows on separate cores, for frames too large for one
+  TrackerOptions options = tracker.options();
+  options.motion_threads = threads;
+  tracker.set_options(options);
+}
+
+bool SatoriApp::set_param(string name, double value){
+  TrackerOptions options = tracker.options();
+  if (!options.params.set(name, value))
+    return false;
+  tracker.set_options(options);
+  return true;
+}
+
+bool SatoriApp::set_mask(string mask_file){
+  // timestamps, trees and sky are painted black, the tracker keeps a copy
+  IplImage* loaded = cvLoadImage(mask_file.c_str(), CV_LOAD_IMAGE_GRAYSCALE);
+  if (!loaded)
+    return false;
+
+  TrackerOptions options = tracker.options();
+  options.mask = loaded;
+  tracker.set_options(options);
+  if (exclusion_mask)
+    cvReleaseImage(&exclusion_mask);
+  exclusion_mask = loaded;
+  return true;
+}
+
+void SatoriApp::set_idle(bool gate, int poll_ms){
+  // quiet cameras only pay for a tiny frame difference
+  TrackerOptions options = tracker.options();
+  options.idle_gate = gate;
+  tracker.set_options(options);
+  idle_poll_ms = gate ? MAX(poll_ms, 0) : 0;
+}
+
+void SatoriApp::set_checkpoint(string save_file, long every, string resume_file_){
+  // tracker state is saved to save_file every so many frames and when the
+  // loop ends, and taken from resume_file before the first frame
+  checkpoint_file = save_file;
+  checkpoint_every = every;
+  resume_file = resume_file_;
+}
+
+void SatoriApp::set_index(string index_file_){
+  // boxes and segments of live frames are appended to the index, which
+  // is created with the first frame or continued if it exists
+  index_file = index_file_;
+}
+
 // Action Functions
 
 bool SatoriApp::add(string filename){
   
   // load the image
   IplImage *img = NULL, *gray = NULL;
+  stats.begin(STAGE_CAPTURE);
   img = cvLoadImage(filename.c_str(),1);  // scan in color
+  stats.end(STAGE_CAPTURE);
   if(!img) return false;
 
   // store the image
   orig_images.push_back(img);
 
   // convert to grayscale
+  stats.begin(STAGE_CONVERT);
   gray = cvCreateImage(cvGetSize(img), IPL_DEPTH_8U, 1);
   cvCvtColor(img, gray, CV_BGR2GRAY);
+  stats.end(STAGE_CONVERT);
 
   // store the gray image
   gray_images.push_back(gray);
@@ -86,112 +197,323 @@ int SatoriApp::run(){
 
 int SatoriApp::run_webcam(bool verbose){
   // capture input from webcam
+  return run_webcam(verbose, "", 1);
+}
+
+int SatoriApp::run_webcam(bool verbose, string record_file, int queue_depth){
+  // capture input from webcam, recording the session when a file is given;
+  // with a queue depth > 0 capture runs on its own thread and only the
+  // freshest frames are processed
+
+  CameraSource camera(0);  // capture from default device
+  if(!camera.opened()){
+    return -1;
+  }
 
-  CvCapture* capture = 0;
-  capture = cvCaptureFromCAM(0);  // capture from default device
-  if(!capture){
+  SessionWriter recorder;
+  if(!record_file.empty() && !recorder.open(record_file)){
+    cout << "[ERROR] Could not record session to " << record_file << "!" << endl;
     return -1;
   }
 
-  IplImage *frame = NULL;
-  frame = cvQueryFrame(capture);
-  FRAME_SIZE = cvGetSize(frame);
+  if(queue_depth < 1)
+    return run_source(camera, recorder.is_open() ? &recorder : NULL, verbose);
 
-  cvNamedWindow("Webcam_Capture", 0 );
+  CaptureThread capture(camera, queue_depth);
+  int result = run_source(capture, recorder.is_open() ? &recorder : NULL, verbose);
+  capture.stop();
 
-  IplImage *image = NULL, *prev_grey = NULL, *grey = NULL, *ann_image = NULL;
-  bool changed = false;
-  bool points_decide = false;
+  if(verbose)
+    cout << "  * " << "Captured " << capture.captured() << " frames, dropped "
+         << capture.dropped() << endl;
+
+  return result;
+}
+
+int SatoriApp::replay(string session_file, bool paced, bool verbose){
+  // run a recorded session through the live processing path
+
+  SessionReplay session(paced);
+  if(!session.open(session_file)){
+    cout << "[ERROR] Could not read session from " << session_file << "!" << endl;
+    return -1;
+  }
+
+  return run_source(session, NULL, verbose);
+}
+
+int SatoriApp::replay_chunked(string session_file, int chunks, long overlap, bool compare,
+                              string tracks_file, bool verbose){
+  // split a recorded session over several trackers, then stitch their
+  // tracks together; optionally check the result against one tracker
+
+  ChunkedReplay chunked(tracker.options(), chunks, overlap);
+  if(!chunked.run(session_file) || (compare && !chunked.run_sequential(session_file))){
+    if(stop_signaled())
+      cout << "  * " << "Stopped before the chunks were done, no tracks written" << endl;
+    else
+      cout << "[ERROR] Could not replay session from " << session_file << "!" << endl;
+    return -1;
+  }
+
+  if(!tracks_file.empty() && !chunked.write_tracks(tracks_file))
+    cout << "[ERROR] Could not write tracks to " << tracks_file << "!" << endl;
+  if(verbose)
+    chunked.report().print(cout);
+
+  return 0;
+}
+
+int SatoriApp::run_batch(string manifest_file, string journal_file, int workers,
+                         string image_format, bool verbose){
+  // many sequences on a pool of trackers, each reused from job to job;
+  // jobs the journal lists as done are skipped
+
+  BatchRunner batch(tracker.options(), workers, image_format);
+  if(!batch.read_manifest(manifest_file)){
+    cout << "[ERROR] Could not read manifest " << manifest_file << "!" << endl;
+    return -1;
+  }
+  if(!batch.run(journal_file)){
+    cout << "[ERROR] Could not write journal " << journal_file << "!" << endl;
+    return -1;
+  }
+
+  if(verbose)
+    batch.print_report(cout);
+  return batch.failed() > 0 ? -1 : 0;
+}
+
+int SatoriApp::query_index(string index_file, CvRect region, double from, double to){
+  // list the motion recorded in a region between two times
+
+  TrackIndex history;
+  if(!history.open(index_file)){
+    cout << "[ERROR] Could not read track index " << index_file << "!" << endl;
+    return -1;
+  }
+
+  vector<IndexEntry> hits;
+  double started = monotonic_seconds();
+  history.query(region, from, to, hits);
+  double elapsed = monotonic_seconds() - started;
+
+  for(size_t i = 0; i < hits.size(); ++i){
+    const IndexEntry& e = hits[i];
+    cout << e.frame << " " << e.timestamp << " "
+         << (e.kind == ENTRY_TRACK ? "track" : "segment") << " "
+         << e.rect.x << " " << e.rect.y << " " << e.rect.width << " " << e.rect.height << endl;
+  }
+  cout << "  * " << hits.size() << " entries of " << history.entries() << " in "
+       << elapsed * 1e3 << " ms (" << history.partitions() << " partitions)" << endl;
+
+  return 0;
+}
+
+int SatoriApp::run_shm(string ring_name, string record_file, bool verbose){
+  // process frames in place as a co-located producer publishes them
+
+  ShmRingSource ring;
+  if(!ring.open(ring_name)){
+    cout << "[ERROR] Could not attach to frame ring " << ring_name << "!" << endl;
+    return -1;
+  }
+
+  SessionWriter recorder;
+  if(!record_file.empty() && !recorder.open(record_file)){
+    cout << "[ERROR] Could not record session to " << record_file << "!" << endl;
+    return -1;
+  }
+
+  int result = run_source(ring, recorder.is_open() ? &recorder : NULL, verbose);
+
+  if(verbose)
+    cout << "  * " << "Dropped " << ring.dropped() << " ring frames, "
+         << ring.overwritten() << " overwritten while in use" << endl;
+
+  return result;
+}
+
+int SatoriApp::run_source(FrameSource& source, SessionWriter* recorder, bool verbose){
+  // live processing loop, frames and keys come from the source
+
+  IplImage *frame = NULL, *ann_image = NULL;
+  double timestamp = 0.0;
+  long dropped = 0;
+
+  if(!headless)
+    cvNamedWindow("Webcam_Capture", 0 );
+
+  // allocate up front when the source knows its frame size
+  CvSize source_size = source.frame_size();
+  if(source_size.width > 0 && source_size.height > 0)
+    prepare(source_size);
+
+  if(!resume_file.empty())
+    resume(source, verbose);
 
   for(;;){
   
     frame = NULL;
   
-    frame = cvQueryFrame(capture);
+    stats.begin(STAGE_FRAME);
+    stats.begin(STAGE_CAPTURE);
+    frame = source.next_frame(timestamp);
+    stats.end(STAGE_CAPTURE);
     if( !frame )
       break;
 
-    if(!image){	// initialize data structures the first time
-      image = cvCreateImage(cvGetSize(frame), 8, 3);
-      image->origin = frame->origin;
-      grey = cvCreateImage(cvGetSize(frame), 8, 1);
-      prev_grey = cvCreateImage(cvGetSize(frame), 8, 1);
-      pyramid = cvCreateImage(cvGetSize(frame), IPL_DEPTH_8U, 1);	// initially NULL
-      prev_pyramid = cvCreateImage(cvGetSize(frame), IPL_DEPTH_8U, 1);  // initially NULL
+    if(recorder)
+      recorder->write_frame(frame, timestamp);
+
+    process_frame(frame, timestamp);
+
+    // display webcam output, headless runs only annotate for the preview
+    bool show = !headless;
+    bool stream = preview && preview->due();
+    if(show || stream){
+      stats.begin(STAGE_ANNOTATE);
+      // draw on the captured frame, results are in its coordinates
+      ann_image = ImagePool::shared().acquire(cvGetSize(frame), IPL_DEPTH_8U, 3);
+      cvCopy(frame, ann_image, 0);
+      ann_image->origin = frame->origin;
+      annotate_flow(ann_image);
+      annotate_track(ann_image);
+      stats.end(STAGE_ANNOTATE);
+
+      stats.begin(STAGE_OUTPUT);
+      if(show)
+        cvShowImage("Webcam_Capture", ann_image);
+      if(stream)
+        preview->send(ann_image);
+      stats.end(STAGE_OUTPUT);
+      ImagePool::shared().release(ann_image);
     }
 
-    cvCopy(frame, image, 0);
-    cvCvtColor(image, grey, CV_BGR2GRAY);
-
-    // perform operations
-    if (do_flow && flow.point_count() > 0){
-      // update pairs with flow information
-      flow.pair_flow(prev_grey, prev_pyramid, grey, pyramid);
-    }
-
-    if (do_track){
-      // track largest moving object
-      track.update(image);
-      changed = false;
-      focus.update(&track.track_box(), 
-                   track.largest_segment(), 
-                   flow.points, 
-                   flow.point_count(),
-                   cvGetSize(image),
-                   points_decide,
-                   changed);
-      
-      if (changed){
-        int intersect_count = focus.intersect_count(&track.track_box(), 
-                                                    flow.points, 
-                                                    flow.point_count());
-        if (intersect_count > 0){
-          track.reset(flow);
-        }
-        else{
-          track.reset();
+    // Handle keyboard input, recorded sessions bring their own keys and
+    // headless runs read commands without waiting
+    bool quit = false;
+    if(source.interactive()){
+      if(headless){
+        while(commands && commands->poll(key_ch)){
+          if(recorder)
+            recorder->write_key(key_ch, timestamp);
+          quit = handle_key(key_ch) || quit;
         }
       }
+      else{
+        key_ch = cvWaitKey(10);
+        if(recorder && key_ch != (char)-1)
+          recorder->write_key(key_ch, timestamp);
+        quit = handle_key(key_ch);
+      }
     }
-    
-    // prepare for next captured picture
-    CV_SWAP(prev_grey, grey, swap_temp);
-    CV_SWAP(prev_pyramid, pyramid, swap_temp);
-
-    // display webcam output        
-    ann_image = annotate(image);
-    cvShowImage("Webcam_Capture", ann_image);
-    cvReleaseImage(&ann_image);
-
-    // Handle keyboard input
-    key_ch = cvWaitKey(10);
-    if( (char)key_ch == 27 )  // ESC key
-      break;
-    switch( (char) key_ch )
-      {
-      case 'f':
-        flow.init(grey);
-        do_flow = !do_flow;
-        break;
-      case 't':
-        do_track = !do_track;
-        break;
-      case 'r':
-        track.reset(flow);
-        break;
-      case 'p':
-        points_decide = !points_decide;
-        break;
-      default:
-        ;
+    else{
+      if(!headless)
+        cvWaitKey(1);
+      while(source.next_key(key_ch)){
+        quit = handle_key(key_ch) || quit;
       }
+    }
+
+    stats.end(STAGE_FRAME);
+    stats.frame_done(result.points.size(), result.segments.size());
+
+    if(checkpoint_every > 0 && tracker.frame_count() % checkpoint_every == 0)
+      checkpoint(verbose);
+
+    // account for frames the source skipped while we were busy
+    long source_dropped = source.dropped();
+    stats.frames_dropped(source_dropped - dropped);
+    dropped = source_dropped;
+
+    if (stats_signaled())
+      stats.print(cout);
+    if (stop_signaled() || quit)
+      break;
+
+    // nothing moves, so there is no hurry for the next live frame
+    if(idle_poll_ms > 0 && result.idle && source.interactive())
+      usleep(idle_poll_ms * 1000);
+  }
+
+  if(!checkpoint_file.empty())
+    checkpoint(verbose);
+
+  if(verbose && tracker.options().keyframe_interval > 1){
+    const KeyframeCounts& keys = tracker.keyframes();
+    cout << "  * " << keys.keyframes << " keyframes, " << keys.forced_by_loss
+         << " forced by lost points, " << keys.forced_by_drift << " by box drift" << endl;
+  }
+  if(verbose && tracker.options().idle_gate){
+    const IdleCounts& idle = tracker.idle_counts();
+    cout << "  * " << idle.idle_frames << " frames idle (" << idle.idle_seconds
+         << "s), woken " << idle.wakes << " times" << endl;
   }
-        
-  cvReleaseCapture(&capture);
     
   return 0;      
 }
 
+void SatoriApp::resume(FrameSource& source, bool verbose){
+  // continue from a checkpoint; a recorded session is also moved past the
+  // frames the checkpoint covers, whose keys are already in its options
+  if(!tracker.load_checkpoint(resume_file)){
+    cout << "[ERROR] Could not resume from " << resume_file << ", starting over" << endl;
+    tracker.reset();
+    return;
+  }
+
+  long skip = 0;
+  if(!source.interactive()){
+    double timestamp;
+    while(skip < tracker.frame_count() && source.next_frame(timestamp)){
+      while(source.next_key(key_ch))
+        ;
+      ++skip;
+    }
+  }
+
+  if(verbose)
+    cout << "  * " << "Resumed at frame " << tracker.frame_count()
+         << " from " << resume_file << " (skipped " << skip << ")" << endl;
+}
+
+void SatoriApp::checkpoint(bool verbose){
+  if(checkpoint_file.empty())
+    return;
+
+  if(!tracker.save_checkpoint(checkpoint_file) && verbose)
+    cout << "[ERROR] Could not write checkpoint " << checkpoint_file << "!" << endl;
+}
+
+void SatoriApp::prepare(CvSize frame_size){
+  // allocate every working buffer before the first frame arrives
+  tracker.prepare(frame_size);
+}
+
+void SatoriApp::process_frame(IplImage* frame, double timestamp){
+  // run all enabled components on one frame, in place
+  tracker.process(frame_view(frame, timestamp), result);
+
+  if(!index_file.empty()){
+    if(!index.is_open() && !index.open(index_file, cvGetSize(frame))){
+      cout << "[ERROR] Could not open track index " << index_file << "!" << endl;
+      index_file.clear();
+      return;
+    }
+    index.append(result);
+  }
+}
+
+bool SatoriApp::handle_key(char key){
+  // apply a command key, returns true when processing should stop
+  if( key == 27 )  // ESC key
+    return true;
+
+  tracker.command(key);
+  return false;
+}
+
 int SatoriApp::run(bool verbose){
 
   if(orig_images.size() == 0){
@@ -247,10 +569,20 @@ int SatoriApp::run(bool verbose){
     //        flow.pair_flow(img1, img2);
 
     // annotate resulting image
+    stats.begin(STAGE_ANNOTATE);
     annotated_images.push_back(annotate(orig_images[i+1]));	// animate colored second pair
+    stats.end(STAGE_ANNOTATE);
+    stats.frame_done(0, 0);
 
     if(verbose)
       cout << "\t\t\t\t[OK]" << endl;
+
+    if(stats_signaled())
+      stats.print(cout);
+    if(stop_signaled()){
+      cout << "  * " << "Stopped after " << i + 1 << " pairs of images" << endl;
+      return 0; // not marked as run, there is nothing complete to animate
+    }
   }
 
   // mark as run
@@ -293,10 +625,17 @@ void SatoriApp::animate(string outfolder, bool verbose){
     if(i < 100) outfile = "0" + outfile;
     outfile = outfolder + outfile;
 
+    stats.begin(STAGE_OUTPUT);
     cvSaveImage(outfile.c_str(),annotated_images[i]);      // add the frame to a file   
+    stats.end(STAGE_OUTPUT);
 
     if(verbose)
       cout << "\t\t\t\t[OK]" << endl;
+
+    if(stats_signaled())
+      stats.print(cout);
+    if(stop_signaled())
+      break;
   }
 }
 
@@ -304,23 +643,18 @@ IplImage* SatoriApp::annotate(IplImage* img){
   // annotate a copy of the image
   IplImage* ann = cvCloneImage(img);
 
-  if (do_flow){
-    ann = annotate_flow(ann);
-  }
-  
-  if (do_track){
-    ann = annotate_track(ann);
-  }
+  ann = annotate_flow(ann);
+  ann = annotate_track(ann);
   
   return ann;
 }
     
 IplImage* SatoriApp::annotate_flow(IplImage* img){
   // add circles for each tracked point
-  int num_points = flow.point_count();
+  int num_points = result.points.size();
 
   for(int i = 0; i < num_points; ++i) {
-    CvPoint pt = cvPointFrom32f(flow.points[i]);
+    CvPoint pt = cvPointFrom32f(result.points[i]);
     cvCircle(img, pt, 3, CV_RGB(0,255,0), -1, 8, 0);
   }
   
@@ -328,22 +662,13 @@ IplImage* SatoriApp::annotate_flow(IplImage* img){
 }
 
 IplImage* SatoriApp::annotate_track(IplImage* img){
-  // add boxes for each motion segment
+  // add a box for the largest motion segment
 
-//   for(int i = 0; i < segs->total; ++i){
-//     comp_rect = (reinterpret_cast<CvConnectedComp*>(cvGetSeqElem(segs, i)))->rect;
-//     color = CV_RGB(255, 0, 0);
-    
-//     cvRectangle(img, 
-//                 cvPoint(comp_rect.x, comp_rect.y),
-//                 cvPoint(comp_rect.x + comp_rect.width,
-//                         comp_rect.y + comp_rect.height),
-//                 color);
-//  }
-
-  const CvConnectedComp* comp = track.largest_segment();
-  if (comp){
-    CvRect comp_rect = comp->rect;
+  if (!tracker.options().track)
+    return img;
+
+  if (!result.segments.empty()){
+    CvRect comp_rect = result.segments[0];
     cvRectangle(img, 
                 cvPoint(comp_rect.x, comp_rect.y),
                 cvPoint(comp_rect.x + comp_rect.width,
@@ -351,8 +676,7 @@ IplImage* SatoriApp::annotate_track(IplImage* img){
                 CV_RGB(255,0,0));
   }
 
-  const CvBox2D& track_box = track.track_box();
-  cvEllipseBox(img, track_box, CV_RGB(0,0,255), 3, CV_AA, 0);
+  cvEllipseBox(img, result.track_box, CV_RGB(0,0,255), 3, CV_AA, 0);
 
   return img;
 }
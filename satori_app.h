@@ -6,9 +6,18 @@
 #define _SATORI_APP_H_
 
 // includes
-#include "flow.h"
-#include "track.h"
-#include "focus.h"
+#include "tracker.h"
+#include "stats.h"
+#include "source.h"
+#include "capture.h"
+#include "control.h"
+#include "preview.h"
+#include "session.h"
+#include "shmring.h"
+#include "chunk.h"
+#include "batch.h"
+#include "trackindex.h"
+#include "pool.h"
 #include "cv.h"
 #include "highgui.h"
 #include <iostream>
@@ -16,6 +25,7 @@
 #include <sstream>
 #include <vector>
 #include <math.h>
+#include <unistd.h>
 
 // namespaces
 using namespace std;
@@ -28,6 +38,20 @@ public:
 
   // Access Functions
   int get_size();		// returns number of processed images
+  const Stats& get_stats() const;	// timings of processed frames
+
+  // Settings Functions
+  void set_headless(CommandChannel*, PreviewServer*);	// no window in the live loop
+  void set_scale(double scale, double flow_scale, double track_scale);	// live processing resolution
+  void set_history_depth(int bits);	// motion history as 32 bit floats or 16/8 bit stamps
+  void set_keyframes(int interval, bool adaptive);	// segmentation and focus every so many frames
+  void set_trajectory_seeding(bool seed);	// CAMSHIFT windows from point groups moving together
+  void set_motion_threads(int threads);	// motion segmentation split over this many cores
+  bool set_param(string name, double value);	// one TrackParams value, false for unknown names
+  bool set_mask(string mask_file);	// skip regions that are black in this image
+  void set_idle(bool gate, int poll_ms);	// skip quiet frames, sleeping between them when live
+  void set_checkpoint(string save_file, long every, string resume_file);	// save and restore tracker state
+  void set_index(string index_file);	// keep every box and segment in a track index
     
   // Action Functions
   bool add(string);			// add an image
@@ -36,6 +60,15 @@ public:
   void animate(string);			// assumes DEFAULT_VERBOSITY
   void animate(string, bool);		// output a movie of the results
   int run_webcam(bool verbose);
+  int run_webcam(bool verbose, string record_file, int queue_depth);	// record session, capture thread queue
+  int replay(string session_file, bool paced, bool verbose);	// replay a recorded session
+  int replay_chunked(string session_file, int chunks, long overlap, bool compare,
+                     string tracks_file, bool verbose);	// replay on several cores
+  int run_batch(string manifest_file, string journal_file, int workers, string image_format,
+                bool verbose);	// every sequence of a manifest, resuming an earlier run
+  int run_shm(string ring_name, string record_file, bool verbose);	// frames from a shared memory ring
+  int query_index(string index_file, CvRect region, double from, double to);	// print motion in a region
+  void prepare(CvSize);			// allocate all live buffers for a frame size
     
 private:
   // Data representation objects
@@ -48,21 +81,40 @@ private:
   bool need_flow_init;
   bool need_track_init;
   char key_ch;
-  bool do_flow;
-  bool do_track;
   
   // Components
-  Flow flow;
-  Track track;
-  Focus focus;
+  Tracker tracker;
+  TrackResult result;			// of the last live frame
+
+  // Instrumentation
+  Stats stats;
+
+  // Static exclusion mask, read by the tracker and chunked replays
+  IplImage *exclusion_mask;
+
+  // Idle mode
+  int idle_poll_ms;			// sleep after live frames the tracker skipped
+
+  // Track history
+  string index_file;
+  TrackIndex index;
 
-  // Images
-  IplImage *swap_temp;
+  // Checkpoints
+  string checkpoint_file;		// written every checkpoint_every frames and at exit
+  long checkpoint_every;
+  string resume_file;			// read before the first frame
 
-  // Pyramids
-  IplImage *prev_pyramid, *pyramid;
+  // Headless operation (not owned)
+  bool headless;
+  CommandChannel *commands;
+  PreviewServer *preview;
 
   // Action Functions
+  int run_source(FrameSource&, SessionWriter*, bool verbose);	// live loop
+  void process_frame(IplImage*, double timestamp);	// run components on a frame
+  bool handle_key(char);	// true when the loop should stop
+  void resume(FrameSource&, bool verbose);	// restore state, skip frames it covers
+  void checkpoint(bool verbose);	// save state after the last frame
   IplImage* annotate(IplImage*); // returns an annotated copy
   IplImage* annotate_flow(IplImage*); // returns same image with annotation
   IplImage* annotate_track(IplImage*); // returns same image with annotation
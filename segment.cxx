@@ -0,0 +1,419 @@
+/*
+ * segment.cxx - Implementation of BandSegmenter class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "segment.h"
+#include "pool.h"
+#include "img_template.tpl"
+#include <algorithm>
+#include <string.h>
+
+// types
+struct StampTimes{
+  // frame time of each stamp
+  const float* times;
+  float operator()(int v) const {return times[v];}
+};
+
+struct FloatTimes{
+  // cvUpdateMotionHistory() stores the time itself
+  float operator()(float v) const {return v;}
+};
+
+template<class T, class Times> struct BandSegmenter::Job{
+  BandSegmenter* owner;
+  const IplImage* history;
+  Times times;
+  T seed; // value of pixels that moved in the last frame
+  float seg_thresh;
+  int bottom; // row below the last band
+};
+
+int band_count(int rows, int threads){
+  if (threads <= 1)
+    return 1;
+  return MAX(MIN(threads * BANDS_PER_THREAD, rows / MIN_BAND_ROWS), 1);
+}
+
+vector<CvRect> split_rows(const CvRect& area, int count){
+  vector<CvRect> bands;
+  count = MAX(MIN(count, area.height), 1);
+  for (int i = 0; i < count; ++i){
+    int y0 = area.y + area.height * i / count, y1 = area.y + area.height * (i + 1) / count;
+    bands.push_back(cvRect(area.x, y0, area.width, y1 - y0));
+  }
+  return bands;
+}
+
+// Constructors
+
+BandSegmenter::BandSegmenter(){
+  size = cvSize(0, 0);
+  labels = NULL;
+}
+
+BandSegmenter::~BandSegmenter(){
+  release();
+}
+
+// Action Functions
+
+void BandSegmenter::prepare(const CvSize& size_){
+  if (labels && size_.width == size.width && size_.height == size.height)
+    return;
+
+  release();
+  size = size_;
+  labels = ImagePool::shared().acquire(size, IPL_DEPTH_32S, 1);
+}
+
+void BandSegmenter::release(){
+  ImagePool::shared().release(labels);
+  size = cvSize(0, 0);
+}
+
+CvSeq* BandSegmenter::segment(const IplImage* stamps, const vector<float>& times, int stamp,
+                              const CvRect& area, double seg_thresh, CvMemStorage* storage,
+                              WorkerPool& workers){
+  if (stamp == 0)
+    return cvCreateSeq(0, sizeof(CvSeq), sizeof(CvConnectedComp), storage);
+
+  StampTimes lookup;
+  lookup.times = &times[0];
+  if (stamps->depth == IPL_DEPTH_16U)
+    return run<unsigned short>(stamps, lookup, (unsigned short)stamp, area,
+                               (float)seg_thresh, storage, workers);
+  return run<unsigned char>(stamps, lookup, (unsigned char)stamp, area,
+                            (float)seg_thresh, storage, workers);
+}
+
+CvSeq* BandSegmenter::segment(const IplImage* mhi, double timestamp,
+                              const CvRect& area, double seg_thresh, CvMemStorage* storage,
+                              WorkerPool& workers){
+  return run<float>(mhi, FloatTimes(), (float)timestamp, area, (float)seg_thresh,
+                    storage, workers);
+}
+
+template<class T, class Times> CvSeq* BandSegmenter::run(const IplImage* history, const Times& times,
+                                                         T seed, const CvRect& area, float seg_thresh,
+                                                         CvMemStorage* storage, WorkerPool& workers){
+  CvSeq* segs = cvCreateSeq(0, sizeof(CvSeq), sizeof(CvConnectedComp), storage);
+  prepare(cvGetSize(history));
+  if (area.width <= 0 || area.height <= 0 || seed == 0)
+    return segs; // a seed of 0 is no motion
+
+  // every band on its own
+  vector<CvRect> rects = split_rows(area, band_count(area.height, workers.threads()));
+  bands.resize(rects.size());
+  band_of_row.assign(size.height, -1);
+  for (size_t b = 0; b < bands.size(); ++b){
+    bands[b].rect = rects[b];
+    for (int y = rects[b].y; y < rects[b].y + rects[b].height; ++y){
+      band_of_row[y] = (int)b;
+    }
+  }
+  Job<T, Times> job;
+  job.owner = this;
+  job.history = history;
+  job.times = times;
+  job.seed = seed;
+  job.seg_thresh = seg_thresh;
+  job.bottom = area.y + area.height;
+  workers.run(fill_band<T, Times>, &job, (int)bands.size());
+
+  segments.clear();
+  for (size_t b = 0; b < bands.size(); ++b){
+    bands[b].first = (int)segments.size();
+    segments.insert(segments.end(), bands[b].segments.begin(), bands[b].segments.end());
+  }
+
+  // pixels only reachable across a seam, then which segments touch
+  for (int b = 0; b + 1 < (int)bands.size(); ++b){
+    cross_seam<T>(history, times, area, b, seg_thresh);
+  }
+  owner.resize(segments.size());
+  for (size_t i = 0; i < owner.size(); ++i){
+    owner[i] = (int)i;
+  }
+  if (bands.size() > 1){
+    workers.run(find_edges<T, Times>, &job, (int)bands.size());
+    merge();
+  }
+
+  // groups within a band stand as filled, the others are filled again
+  found.clear();
+  for (size_t i = 0; i < segments.size(); ++i){
+    if (bands.size() == 1 || !crosses_seam(root_of((int)i)))
+      found.push_back(segments[i]);
+  }
+  for (size_t i = 0; bands.size() > 1 && i < segments.size(); ++i){
+    if (owner[i] == (int)i && crosses_seam((int)i))
+      refill<T>(history, times, seed, area, (int)i, seg_thresh);
+  }
+  sort(found.begin(), found.end(), first_found);
+
+  for (size_t i = 0; i < found.size(); ++i){
+    const Segment& s = found[i];
+    CvConnectedComp comp;
+    comp.area = (double)s.area;
+    comp.value = cvRealScalar(segs->total + 1);
+    comp.rect = cvRect(s.x0, s.y0, s.x1 - s.x0 + 1, s.y1 - s.y0 + 1);
+    comp.contour = NULL;
+    cvSeqPush(segs, &comp);
+  }
+
+  return segs;
+}
+
+template<class T, class Times> void BandSegmenter::fill_band(void* arg, int b){
+  // the fill of CompactHistory::segment(), kept within the band's rows
+  const Job<T, Times>& job = *static_cast<Job<T, Times>*>(arg);
+  BandSegmenter& owner = *job.owner;
+  Band& band = owner.bands[b];
+  const CvRect& r = band.rect;
+  int width = owner.size.width;
+  Image<T> history(job.history);
+  Image<int> labels(owner.labels);
+  const int dx[4] = {1, -1, 0, 0};
+  const int dy[4] = {0, 0, 1, -1};
+
+  for (int y = r.y; y < r.y + r.height; ++y){
+    memset(&labels[y][r.x], 0, r.width * sizeof(int));
+  }
+
+  band.segments.clear();
+  for (int y = r.y; y < r.y + r.height; ++y){
+    const T* row = history[y];
+    for (int x = r.x; x < r.x + r.width; ++x){
+      if (row[x] != job.seed || labels[y][x])
+        continue;
+
+      // labels are unique over all bands and lead back to the band
+      int label = r.y * width + (int)band.segments.size() + 1;
+      Segment s;
+      s.x0 = s.x1 = x;
+      s.y0 = s.y1 = y;
+      s.area = 0;
+      s.seed = y * width + x;
+      labels[y][x] = label;
+      band.stack.clear();
+      band.stack.push_back(y * width + x);
+      while (!band.stack.empty()){
+        int px = band.stack.back() % width, py = band.stack.back() / width;
+        band.stack.pop_back();
+        ++s.area;
+        s.x0 = MIN(s.x0, px);
+        s.x1 = MAX(s.x1, px);
+        s.y0 = MIN(s.y0, py);
+        s.y1 = MAX(s.y1, py);
+
+        float reach = job.times(history[py][px]) - job.seg_thresh;
+        for (int i = 0; i < 4; ++i){
+          int nx = px + dx[i], ny = py + dy[i];
+          if (nx < r.x || ny < r.y || nx >= r.x + r.width || ny >= r.y + r.height ||
+              labels[ny][nx])
+            continue;
+          T v = history[ny][nx];
+          if (v == 0 || job.times(v) < reach)
+            continue;
+          labels[ny][nx] = label;
+          band.stack.push_back(ny * width + nx);
+        }
+      }
+      band.segments.push_back(s);
+    }
+  }
+}
+
+template<class T, class Times> void BandSegmenter::find_edges(void* arg, int b){
+  // segments that touch, below and to the right of each pixel of the band
+  const Job<T, Times>& job = *static_cast<Job<T, Times>*>(arg);
+  BandSegmenter& owner = *job.owner;
+  Band& band = owner.bands[b];
+  const CvRect& r = band.rect;
+  Image<int> labels(owner.labels);
+  const int dx[2] = {1, 0};
+  const int dy[2] = {0, 1};
+
+  band.edges.clear();
+  for (int y = r.y; y < r.y + r.height; ++y){
+    for (int x = r.x; x < r.x + r.width; ++x){
+      int label = labels[y][x];
+      if (!label)
+        continue;
+      for (int i = 0; i < 2; ++i){
+        int nx = x + dx[i], ny = y + dy[i];
+        if (nx >= r.x + r.width || ny >= job.bottom)
+          continue;
+        int other = labels[ny][nx];
+        if (other && other != label)
+          band.edges.push_back(make_pair(owner.index_of(label), owner.index_of(other)));
+      }
+    }
+  }
+  sort(band.edges.begin(), band.edges.end());
+  band.edges.erase(unique(band.edges.begin(), band.edges.end()), band.edges.end());
+}
+
+template<class T, class Times> void BandSegmenter::cross_seam(const IplImage* history_, const Times& times,
+                                                              const CvRect& area, int above,
+                                                              float seg_thresh){
+  // pixels across the seam that no band claimed, grown from the segment
+  // that reaches them, both ways
+  Image<T> history(history_);
+  Image<int> labels(this->labels);
+  int y0 = bands[above + 1].rect.y - 1, y1 = y0 + 1;
+  for (int x = area.x; x < area.x + area.width; ++x){
+    for (int i = 0; i < 2; ++i){
+      int from = i ? y1 : y0, to = i ? y0 : y1;
+      T v = history[to][x];
+      int label = labels[from][x];
+      if (!label || labels[to][x] || v == 0 || times(v) < times(history[from][x]) - seg_thresh)
+        continue;
+      claim<T>(history_, times, area, x, to, label, seg_thresh);
+    }
+  }
+}
+
+template<class T, class Times> void BandSegmenter::claim(const IplImage* history_, const Times& times,
+                                                         const CvRect& area, int x, int y, int label,
+                                                         float seg_thresh){
+  // grow a segment from a pixel its band fill could not reach, over
+  // every band
+  Image<T> history(history_);
+  Image<int> labels(this->labels);
+  Segment& s = segments[index_of(label)];
+  const int dx[4] = {1, -1, 0, 0};
+  const int dy[4] = {0, 0, 1, -1};
+
+  labels[y][x] = label;
+  stack.clear();
+  stack.push_back(y * size.width + x);
+  while (!stack.empty()){
+    int px = stack.back() % size.width, py = stack.back() / size.width;
+    stack.pop_back();
+    ++s.area;
+    s.x0 = MIN(s.x0, px);
+    s.x1 = MAX(s.x1, px);
+    s.y0 = MIN(s.y0, py);
+    s.y1 = MAX(s.y1, py);
+
+    float reach = times(history[py][px]) - seg_thresh;
+    for (int i = 0; i < 4; ++i){
+      int nx = px + dx[i], ny = py + dy[i];
+      if (nx < area.x || ny < area.y || nx >= area.x + area.width || ny >= area.y + area.height)
+        continue;
+      T v = history[ny][nx];
+      if (labels[ny][nx] || v == 0 || times(v) < reach)
+        continue;
+      labels[ny][nx] = label;
+      stack.push_back(ny * size.width + nx);
+    }
+  }
+}
+
+template<class T, class Times> void BandSegmenter::refill(const IplImage* history_, const Times& times,
+                                                          T seed, const CvRect& area, int root,
+                                                          float seg_thresh){
+  // the fill of CompactHistory::segment() over one group, which holds
+  // every pixel it can reach; pixels filled again are labelled -1
+  Image<T> history(history_);
+  Image<int> labels(this->labels);
+  const Segment& g = groups[root];
+  const int dx[4] = {1, -1, 0, 0};
+  const int dy[4] = {0, 0, 1, -1};
+
+  for (int y = g.y0; y <= g.y1; ++y){
+    for (int x = g.x0; x <= g.x1; ++x){
+      int label = labels[y][x];
+      if (history[y][x] != seed || label <= 0 || root_of(index_of(label)) != root)
+        continue;
+
+      Segment s;
+      s.x0 = s.x1 = x;
+      s.y0 = s.y1 = y;
+      s.area = 0;
+      s.seed = y * size.width + x;
+      labels[y][x] = -1;
+      stack.clear();
+      stack.push_back(s.seed);
+      while (!stack.empty()){
+        int px = stack.back() % size.width, py = stack.back() / size.width;
+        stack.pop_back();
+        ++s.area;
+        s.x0 = MIN(s.x0, px);
+        s.x1 = MAX(s.x1, px);
+        s.y0 = MIN(s.y0, py);
+        s.y1 = MAX(s.y1, py);
+
+        float reach = times(history[py][px]) - seg_thresh;
+        for (int i = 0; i < 4; ++i){
+          int nx = px + dx[i], ny = py + dy[i];
+          if (nx < area.x || ny < area.y || nx >= area.x + area.width || ny >= area.y + area.height ||
+              labels[ny][nx] <= 0)
+            continue;
+          T v = history[ny][nx];
+          if (v == 0 || times(v) < reach)
+            continue;
+          labels[ny][nx] = -1;
+          stack.push_back(ny * size.width + nx);
+        }
+      }
+      found.push_back(s);
+    }
+  }
+}
+
+int BandSegmenter::index_of(int label) const{
+  int pixel = label - 1;
+  const Band& band = bands[band_of_row[pixel / size.width]];
+  return band.first + pixel - band.rect.y * size.width;
+}
+
+int BandSegmenter::root_of(int segment){
+  while (owner[segment] != segment){
+    owner[segment] = owner[owner[segment]];
+    segment = owner[segment];
+  }
+  return segment;
+}
+
+void BandSegmenter::merge(){
+  // segments that touch join the group of the earlier one, and each
+  // root gets the bounds of its group
+  edges.clear();
+  for (size_t b = 0; b < bands.size(); ++b){
+    edges.insert(edges.end(), bands[b].edges.begin(), bands[b].edges.end());
+  }
+  for (size_t i = 0; i < edges.size(); ++i){
+    int a = root_of(edges[i].first), b = root_of(edges[i].second);
+    if (a < b)
+      owner[b] = a;
+    else if (b < a)
+      owner[a] = b;
+  }
+
+  groups = segments;
+  for (size_t i = 0; i < segments.size(); ++i){
+    Segment& to = groups[root_of((int)i)];
+    const Segment& from = segments[i];
+    to.x0 = MIN(to.x0, from.x0);
+    to.y0 = MIN(to.y0, from.y0);
+    to.x1 = MAX(to.x1, from.x1);
+    to.y1 = MAX(to.y1, from.y1);
+  }
+}
+
+bool BandSegmenter::crosses_seam(int root) const{
+  return band_of_row[groups[root].y0] != band_of_row[groups[root].y1];
+}
+
+bool BandSegmenter::first_found(const Segment& a, const Segment& b){
+  return a.seed < b.seed;
+}
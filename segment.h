@@ -0,0 +1,122 @@
+/*
+ * segment.h - Motion segmentation in bands, in parallel
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _SEGMENT_H_
+#define _SEGMENT_H_
+
+// includes
+#include "workers.h"
+#include "cv.h"
+#include <utility>
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+// constants
+const int BANDS_PER_THREAD = 2;	// more bands than threads evens out uneven motion
+const int MIN_BAND_ROWS = 16;	// below this seams cost more than the bands save
+
+// bands to cut rows into for a pool of so many threads
+int band_count(int rows, int threads);
+// the rows of area cut into count bands of nearly equal height, top first
+vector<CvRect> split_rows(const CvRect& area, int count);
+
+class BandSegmenter{
+  /* Motion segments of a motion history found the way cvSegmentMotion()
+     finds them, with the frame cut into horizontal bands that are
+     segmented at the same time on a WorkerPool.
+
+     Each band grows segments from its own pixels that moved in the last
+     frame, without leaving the band, labelling every pixel it claims.
+     Then, one seam at a time, pixels the fill would have reached from
+     across the seam but no band claimed are grown from as part of the
+     segment on the other side, so every pixel any fill reaches is
+     labelled.  Each band lists the segments its pixels touch, and
+     segments that touch are grouped.
+
+     A group within one band is what a single fill over the frame finds
+     there, since no fill can leave it.  Groups that cross a seam are
+     filled again, one at a time, the way the single fill does it.  The
+     result is one CvConnectedComp per segment, in the order their
+     first pixels come in the frame, the same list a single fill gives.
+
+     Stamped histories (8 or 16 bit, with a time per stamp) and float
+     times (as cvUpdateMotionHistory() writes them) are both handled.
+  */
+ public:
+  BandSegmenter();
+  ~BandSegmenter();
+
+  void prepare(const CvSize&); // label buffer for this frame size
+  void release();
+
+  CvSeq* segment(const IplImage* stamps, const vector<float>& times, int stamp,
+                 const CvRect& area, double seg_thresh, CvMemStorage*, WorkerPool&);
+  CvSeq* segment(const IplImage* mhi, double timestamp,
+                 const CvRect& area, double seg_thresh, CvMemStorage*, WorkerPool&);
+
+ private:
+  struct Segment{
+    int x0, y0, x1, y1;
+    long area;
+    int seed; // pixel it was grown from, y * width + x
+  };
+
+  struct Band{
+    CvRect rect;
+    vector<Segment> segments;
+    vector<int> stack; // pixels waiting to be grown from
+    int first; // index of its first segment over all bands
+    vector<pair<int, int> > edges; // segments that touch, from its rows down
+  };
+
+  template<class T, class Times> struct Job;
+
+  CvSize size;
+  IplImage* labels; // 32 bit, 0 for unclaimed, else the label of a segment
+  vector<Band> bands;
+  vector<int> band_of_row; // band holding each frame row, -1 for none
+  vector<Segment> segments; // of all bands, in scan order
+  vector<pair<int, int> > edges; // of all bands
+  vector<int> owner; // segments that touch lead to the same root
+  vector<Segment> groups; // bounds of the group of each root
+  vector<Segment> found; // the result, by seed
+  vector<int> stack; // seam fills and filling again
+
+  // methods
+  template<class T, class Times> CvSeq* run(const IplImage* history, const Times& times, T seed,
+                                            const CvRect& area, float seg_thresh,
+                                            CvMemStorage*, WorkerPool&);
+  template<class T, class Times> static void fill_band(void* job, int band);
+  template<class T, class Times> static void find_edges(void* job, int band);
+  template<class T, class Times> void cross_seam(const IplImage* history, const Times& times,
+                                                 const CvRect& area, int above, float seg_thresh);
+  template<class T, class Times> void claim(const IplImage* history, const Times& times,
+                                            const CvRect& area, int x, int y, int label,
+                                            float seg_thresh);
+  template<class T, class Times> void refill(const IplImage* history, const Times& times, T seed,
+                                             const CvRect& area, int root, float seg_thresh);
+  int index_of(int label) const; // segment index of a pixel label
+  int root_of(int segment);
+  void merge(); // groups of segments that touch
+  bool crosses_seam(int root) const;
+  static bool first_found(const Segment&, const Segment&);
+
+  // not copyable
+  BandSegmenter(const BandSegmenter&);
+  BandSegmenter& operator=(const BandSegmenter&);
+};
+
+#endif
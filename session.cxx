@@ -0,0 +1,221 @@
+/*
+ * session.cxx - Implementation of session recording and replay
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "session.h"
+#include "stats.h"	// monotonic clock
+#include <unistd.h>
+
+static const char SESSION_MAGIC[8] = {'S', 'A', 'T', 'S', 'E', 'S', 'S', '1'};
+static const char FRAME_RECORD = 'F';
+static const char KEY_RECORD = 'K';
+
+template<class T> static void write_value(ofstream& out, const T& value){
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<class T> static bool read_value(ifstream& in, T& value){
+  in.read(reinterpret_cast<char*>(&value), sizeof(value));
+  return in.good();
+}
+
+static int row_bytes(const IplImage* img){
+  // bytes of pixel data in a row, without padding
+  return img->width * img->nChannels * ((img->depth & 255) / 8);
+}
+
+// SessionWriter
+
+SessionWriter::SessionWriter(){
+  frames = 0;
+}
+
+SessionWriter::~SessionWriter(){
+  close();
+}
+
+bool SessionWriter::open(const string& filename){
+  out.open(filename.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out)
+    return false;
+
+  out.write(SESSION_MAGIC, sizeof(SESSION_MAGIC));
+  frames = 0;
+  return out.good();
+}
+
+void SessionWriter::close(){
+  if (out.is_open())
+    out.close();
+}
+
+bool SessionWriter::is_open() const{
+  return out.is_open();
+}
+
+void SessionWriter::write_frame(const IplImage* frame, double timestamp){
+  write_value(out, FRAME_RECORD);
+  write_value(out, timestamp);
+  write_value(out, (int)frame->width);
+  write_value(out, (int)frame->height);
+  write_value(out, (int)frame->depth);
+  write_value(out, (int)frame->nChannels);
+  write_value(out, (int)frame->origin);
+
+  int bytes = row_bytes(frame);
+  for (int y = 0; y < frame->height; ++y){
+    out.write(frame->imageData + y * frame->widthStep, bytes);
+  }
+
+  ++frames;
+}
+
+void SessionWriter::write_key(char key, double timestamp){
+  write_value(out, KEY_RECORD);
+  write_value(out, timestamp);
+  write_value(out, frames - 1);
+  write_value(out, key);
+}
+
+// SessionReplay
+
+SessionReplay::SessionReplay(bool paced_){
+  frame = NULL;
+  first_size = cvSize(0, 0);
+  paced = paced_;
+  started = false;
+  first_timestamp = 0.0;
+  replay_start = 0.0;
+}
+
+SessionReplay::~SessionReplay(){
+  if (frame)
+    cvReleaseImage(&frame);
+}
+
+bool SessionReplay::open(const string& filename){
+  in.open(filename.c_str(), ios::in | ios::binary);
+  if (!in)
+    return false;
+
+  char magic[sizeof(SESSION_MAGIC)];
+  in.read(magic, sizeof(magic));
+  if (!in.good() || memcmp(magic, SESSION_MAGIC, sizeof(magic)) != 0)
+    return false;
+
+  // peek at the first frame header so buffers can be prepared up front
+  streampos records = in.tellg();
+  char type;
+  double time;
+  int key_frame, width, height;
+  char key;
+  while (read_value(in, type) && type == KEY_RECORD){
+    if (!read_value(in, time) || !read_value(in, key_frame) || !read_value(in, key))
+      break;
+  }
+  if (in.good() && type == FRAME_RECORD && read_value(in, time) &&
+      read_value(in, width) && read_value(in, height))
+    first_size = cvSize(width, height);
+
+  in.clear();
+  in.seekg(records);
+  return in.good();
+}
+
+CvSize SessionReplay::frame_size() const{
+  return first_size;
+}
+
+bool SessionReplay::interactive() const{
+  return false;
+}
+
+IplImage* SessionReplay::next_frame(double& timestamp){
+  char type;
+  double key_time;
+  int key_frame;
+  char key;
+
+  // skip keys nobody asked for, up to the next frame
+  while (read_value(in, type) && type == KEY_RECORD){
+    if (!read_value(in, key_time) || !read_value(in, key_frame) || !read_value(in, key))
+      return NULL;
+  }
+  if (!in.good() || type != FRAME_RECORD)
+    return NULL;
+
+  int width, height, depth, channels, origin;
+  if (!read_value(in, timestamp) || !read_value(in, width) || !read_value(in, height) ||
+      !read_value(in, depth) || !read_value(in, channels) || !read_value(in, origin))
+    return NULL;
+
+  if (!frame || frame->width != width || frame->height != height ||
+      frame->depth != depth || frame->nChannels != channels){
+    if (frame)
+      cvReleaseImage(&frame);
+    frame = cvCreateImage(cvSize(width, height), depth, channels);
+  }
+  frame->origin = origin;
+
+  int bytes = row_bytes(frame);
+  for (int y = 0; y < height; ++y){
+    in.read(frame->imageData + y * frame->widthStep, bytes);
+  }
+  if (!in.good())
+    return NULL;
+
+  // wait until the frame is due when replaying at the recorded pace
+  if (!started){
+    started = true;
+    first_timestamp = timestamp;
+    replay_start = monotonic_seconds();
+  }
+  else if (paced){
+    double wait = (timestamp - first_timestamp) - (monotonic_seconds() - replay_start);
+    if (wait > 0.0)
+      usleep((useconds_t)(wait * 1e6));
+  }
+
+  return frame;
+}
+
+bool SessionReplay::skip_frame(double& timestamp){
+  char type;
+  double key_time;
+  int key_frame;
+  char key;
+
+  while (read_value(in, type) && type == KEY_RECORD){
+    if (!read_value(in, key_time) || !read_value(in, key_frame) || !read_value(in, key))
+      return false;
+  }
+  if (!in.good() || type != FRAME_RECORD)
+    return false;
+
+  int width, height, depth, channels, origin;
+  if (!read_value(in, timestamp) || !read_value(in, width) || !read_value(in, height) ||
+      !read_value(in, depth) || !read_value(in, channels) || !read_value(in, origin))
+    return false;
+
+  // seek past the pixels, keys after the frame stay readable
+  streamoff bytes = (streamoff)width * channels * ((depth & 255) / 8) * height;
+  in.seekg(bytes, ios::cur);
+  return in.good();
+}
+
+bool SessionReplay::next_key(char& key){
+  if (in.peek() != KEY_RECORD)
+    return false;
+
+  char type;
+  double key_time;
+  int key_frame;
+  return read_value(in, type) && read_value(in, key_time) &&
+         read_value(in, key_frame) && read_value(in, key);
+}
@@ -0,0 +1,82 @@
+/*
+ * session.h - Record and replay live sessions
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _SESSION_H_
+#define _SESSION_H_
+
+// includes
+#include "common.h"
+#include "source.h"
+#include "cv.h"
+#include <fstream>
+#include <string>
+
+// namespace preparation
+using namespace std;
+
+/* A session file is a magic string followed by records in the order
+   they happened, in host byte order:
+
+     'F' timestamp(double) width height depth channels origin(int32 each)
+         then the raw pixel rows, without row padding
+     'K' timestamp(double) frame index(int32) key(char)
+
+   A key record belongs to the frame record before it, which is when the
+   live loop read the key.
+*/
+
+class SessionWriter{
+ public:
+  SessionWriter();
+  ~SessionWriter();
+
+  bool open(const string& filename);
+  void close();
+  bool is_open() const;
+
+  void write_frame(const IplImage* frame, double timestamp);
+  void write_key(char key, double timestamp);
+
+ private:
+  ofstream out;
+  int frames; // frames written so far
+};
+
+class SessionReplay : public FrameSource{
+  /* Feeds a recorded session back frame by frame, either as fast as
+     possible or sleeping so frames come at their recorded pace.
+  */
+ public:
+  SessionReplay(bool paced = true);
+  ~SessionReplay();
+
+  bool open(const string& filename);
+
+  IplImage* next_frame(double& timestamp);
+  bool skip_frame(double& timestamp); // step over the next frame without reading it
+  bool next_key(char& key);
+  bool interactive() const;
+  CvSize frame_size() const; // size of the first recorded frame
+
+ private:
+  ifstream in;
+  CvSize first_size;
+  IplImage* frame; // last frame read, reused while the size stays the same
+  bool paced;
+  bool started;
+  double first_timestamp; // session time of the first frame
+  double replay_start; // monotonic time the first frame was handed out
+};
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * shmprod.cxx - Test producer for the shared memory frame ring
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * Creates a ring and fills it with a SyntheticScene at a fixed frame
+ * rate, rendering straight into the ring slots, until stopped or the
+ * requested number of frames is out.  Start it before satori -B and
+ * stop it with ^C; satori sees the ring close and exits.
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "shmring.h"
+#include "synth.h"
+#include "stats.h"
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+// constants
+static const char* DEFAULT_RING = "/satori";
+
+static int display_shmprod_syntax(){
+  cout << endl;
+  cout << "satori_shmprod: Feed a synthetic scene to satori through shared memory." << endl;
+  cout << endl;
+  cout << "Syntax: satori_shmprod [-n name -r WxH -f fps -c frames -k slots -o objects -v speed -s seed]" << endl;
+  cout << "  " << "-n (name)" << ": Shared memory ring name (default " << DEFAULT_RING << ")" << endl;
+  cout << "  " << "-r (WxH)" << ": Frame size (default 640x480)" << endl;
+  cout << "  " << "-f (fps)" << ": Frames per second, 0 for as fast as possible (default 30)" << endl;
+  cout << "  " << "-c (frames)" << ": Stop after this many frames, 0 for never (default 0)" << endl;
+  cout << "  " << "-k (slots)" << ": Frames the ring holds (default 4)" << endl;
+  cout << "  " << "-o (objects)" << ": Moving objects in the scene (default 3)" << endl;
+  cout << "  " << "-v (speed)" << ": Object speed in pixels per frame at 640x480 (default 4)" << endl;
+  cout << "  " << "-s (seed)" << ": Scene seed (default 1)" << endl;
+  cout << "  " << "-?" << ": Display this screen" << endl;
+  cout << endl;
+
+  return 0;
+}
+
+int main(int argc, char *argv[]){
+  string name = DEFAULT_RING;
+  CvSize size = cvSize(640, 480);
+  double fps = 30.0;
+  long count = 0;
+  int slots = 4, objects = 3;
+  float speed = 4.f;
+  unsigned int seed = 1;
+
+  int optchar;
+  while((optchar = getopt(argc, argv, "n:r:f:c:k:o:v:s:?")) != -1){
+    switch(optchar){
+      case 'n':
+        name = optarg;
+        break;
+      case 'r':
+        if (sscanf(optarg, "%dx%d", &size.width, &size.height) != 2)
+          return display_shmprod_syntax();
+        break;
+      case 'f':
+        fps = atof(optarg);
+        break;
+      case 'c':
+        count = atol(optarg);
+        break;
+      case 'k':
+        slots = atoi(optarg);
+        break;
+      case 'o':
+        objects = atoi(optarg);
+        break;
+      case 'v':
+        speed = (float)atof(optarg);
+        break;
+      case 's':
+        seed = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      default:
+      case '?':
+        return display_shmprod_syntax();
+    }
+  }
+
+  ShmRingWriter ring;
+  if (!ring.create(name, size.width, size.height, 3, slots)){
+    cout << "[ERROR] Could not create ring " << name << "!" << endl;
+    return 1;
+  }
+
+  // ^C stops cleanly so the ring is closed and unlinked
+  install_stats_signals();
+
+  SyntheticScene scene(size, objects, speed, seed);
+  IplImage slot;
+  cvInitImageHeader(&slot, size, IPL_DEPTH_8U, 3, IPL_ORIGIN_TL, 4);
+
+  double start = monotonic_seconds();
+  for (long i = 0; (count == 0 || i < count) && !stop_signaled(); ++i){
+    // hold frames to their time in the sequence
+    if (fps > 0.0){
+      double wait = start + i / fps - monotonic_seconds();
+      if (wait > 0.0)
+        usleep((useconds_t)(wait * 1e6));
+    }
+
+    cvSetData(&slot, ring.begin_frame(), ring.stride());
+    scene.render(i, &slot);
+    ring.publish(monotonic_seconds() - start);
+  }
+
+  ring.close();
+  return 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * shmring.cxx - Implementation of the shared memory frame ring
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "shmring.h"
+#include "stats.h"	// monotonic clock, stop requests
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+static const char RING_MAGIC[8] = {'S', 'A', 'T', 'R', 'I', 'N', 'G', '1'};
+static const useconds_t RING_POLL_US = 500;	// reader sleep while no frame is new
+
+static size_t align64(size_t bytes){
+  return (bytes + 63) & ~(size_t)63;
+}
+
+static size_t ring_bytes(const ShmRingHeader* header){
+  return align64(sizeof(ShmRingHeader)) + (size_t)header->slots * header->slot_size;
+}
+
+static ShmSlotHeader* ring_slot(ShmRingHeader* header, uint64_t number){
+  char* base = reinterpret_cast<char*>(header) + align64(sizeof(ShmRingHeader));
+  return reinterpret_cast<ShmSlotHeader*>(base + ((number - 1) % header->slots) * header->slot_size);
+}
+
+static unsigned char* slot_pixels(ShmSlotHeader* slot){
+  return reinterpret_cast<unsigned char*>(slot) + align64(sizeof(ShmSlotHeader));
+}
+
+// ShmRingWriter
+
+ShmRingWriter::ShmRingWriter(){
+  header = NULL;
+  mapped = 0;
+  writing = 0;
+}
+
+ShmRingWriter::~ShmRingWriter(){
+  close();
+}
+
+bool ShmRingWriter::create(const string& name_, int width, int height, int channels, int slots){
+  close();
+  if (width <= 0 || height <= 0 || (channels != 1 && channels != 3) || slots < 1)
+    return false;
+
+  ShmRingHeader layout;
+  memset(&layout, 0, sizeof(layout));
+  layout.width = width;
+  layout.height = height;
+  layout.channels = channels;
+  layout.stride = (width * channels + 3) & ~3;
+  layout.slots = slots;
+  layout.slot_size = align64(sizeof(ShmSlotHeader)) + align64((size_t)layout.stride * height);
+
+  int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+  if (fd < 0)
+    return false;
+
+  size_t bytes = ring_bytes(&layout);
+  void* memory = MAP_FAILED;
+  if (ftruncate(fd, bytes) == 0)
+    memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED){
+    shm_unlink(name_.c_str());
+    return false;
+  }
+
+  // slots start zeroed, so no sequence word claims a frame yet; the
+  // magic goes in last so readers never see a half written header
+  name = name_;
+  mapped = bytes;
+  header = reinterpret_cast<ShmRingHeader*>(memory);
+  memcpy(header, &layout, sizeof(layout));
+  __sync_synchronize();
+  memcpy(header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+  return true;
+}
+
+void ShmRingWriter::close(){
+  if (!header)
+    return;
+
+  header->closed = 1;
+  __sync_synchronize();
+  munmap(header, mapped);
+  shm_unlink(name.c_str());
+  header = NULL;
+  mapped = 0;
+  writing = 0;
+}
+
+unsigned char* ShmRingWriter::begin_frame(){
+  if (!header)
+    return NULL;
+
+  writing = header->head + 1;
+  ShmSlotHeader* slot = ring_slot(header, writing);
+  slot->sequence = 2 * writing - 1;
+  __sync_synchronize();
+  return slot_pixels(slot);
+}
+
+void ShmRingWriter::publish(double timestamp){
+  if (!header || !writing)
+    return;
+
+  ShmSlotHeader* slot = ring_slot(header, writing);
+  slot->timestamp = timestamp;
+  __sync_synchronize();
+  slot->sequence = 2 * writing;
+  __sync_synchronize();
+  header->head = writing;
+  writing = 0;
+}
+
+int ShmRingWriter::stride() const{
+  return header ? header->stride : 0;
+}
+
+// ShmRingSource
+
+ShmRingSource::ShmRingSource(bool in_order_, double timeout_){
+  header = NULL;
+  mapped = 0;
+  in_order = in_order_;
+  timeout = timeout_;
+  current = 0;
+  _dropped = 0;
+  _overwritten = 0;
+}
+
+ShmRingSource::~ShmRingSource(){
+  close();
+}
+
+bool ShmRingSource::open(const string& name){
+  close();
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  void* memory = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(ShmRingHeader))
+    memory = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED)
+    return false;
+
+  header = reinterpret_cast<ShmRingHeader*>(memory);
+  mapped = info.st_size;
+  __sync_synchronize();
+  if (memcmp(header->magic, RING_MAGIC, sizeof(RING_MAGIC)) != 0 ||
+      header->slots < 1 || ring_bytes(header) > mapped ||
+      (header->channels != 1 && header->channels != 3)){
+    close();
+    return false;
+  }
+
+  cvInitImageHeader(&frame, frame_size(), IPL_DEPTH_8U, header->channels, IPL_ORIGIN_TL, 4);
+  current = 0;
+  return true;
+}
+
+void ShmRingSource::close(){
+  if (header)
+    munmap(header, mapped);
+  header = NULL;
+  mapped = 0;
+}
+
+IplImage* ShmRingSource::next_frame(double& timestamp){
+  if (!header)
+    return NULL;
+
+  // the frame handed out last may have been lapped while it was in use
+  if (current && slot(current)->sequence != 2 * current)
+    ++_overwritten;
+
+  double started = monotonic_seconds();
+  for (;;){
+    __sync_synchronize();
+    uint64_t head = header->head;
+
+    if (head > current){
+      uint64_t oldest = head > header->slots ? head - header->slots + 1 : 1;
+      uint64_t next = head;
+      if (in_order){
+        if (current == 0)
+          current = oldest - 1; // frames from before we attached are not ours
+        next = MAX(current + 1, oldest);
+      }
+
+      // read the slot between two checks of its sequence word
+      ShmSlotHeader* s = slot(next);
+      uint64_t sequence = s->sequence;
+      __sync_synchronize();
+      double stamp = s->timestamp;
+      __sync_synchronize();
+      if (sequence != 2 * next || s->sequence != sequence){
+        if (in_order){ // lapped before we got to it
+          _dropped += next - current;
+          current = next;
+        }
+        continue;
+      }
+
+      if (current)
+        _dropped += next - current - 1;
+      current = next;
+      timestamp = stamp;
+      cvSetData(&frame, slot_pixels(s), header->stride);
+      return &frame;
+    }
+
+    if (header->closed || stop_signaled())
+      return NULL;
+    if (timeout > 0.0 && monotonic_seconds() - started > timeout)
+      return NULL;
+    usleep(RING_POLL_US);
+  }
+}
+
+long ShmRingSource::dropped() const{
+  return _dropped;
+}
+
+long ShmRingSource::overwritten() const{
+  return _overwritten;
+}
+
+CvSize ShmRingSource::frame_size() const{
+  if (!header)
+    return cvSize(0, 0);
+
+  return cvSize(header->width, header->height);
+}
+
+ShmSlotHeader* ShmRingSource::slot(uint64_t number) const{
+  return ring_slot(header, number);
+}
@@ -0,0 +1,109 @@
+/*
+ * shmring.h - Frames handed over through a POSIX shared memory ring
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _SHMRING_H_
+#define _SHMRING_H_
+
+// includes
+#include "common.h"
+#include "source.h"
+#include "cv.h"
+#include <string>
+#include <stdint.h>
+
+// namespace preparation
+using namespace std;
+
+/* The ring is one shared memory object: a header followed by a fixed
+   number of equally sized slots, each a slot header and one frame of
+   pixels (8 bit, 1 or 3 channels, top row first).
+
+   Frames are numbered from 1.  Frame n goes to slot (n - 1) % slots.
+   The producer marks the slot's sequence word 2n - 1 while it writes
+   and 2n once the frame is complete, then advances the ring's head to
+   n.  Readers never lock anything: a frame is intact as long as its
+   slot still reads 2n, which readers check before and after using it.
+*/
+
+struct ShmRingHeader{
+  char magic[8];
+  uint32_t width, height, channels, stride; // stride in bytes
+  uint32_t slots;
+  uint32_t slot_size; // bytes from one slot to the next
+  volatile uint64_t head; // last published frame, 0 for none yet
+  volatile uint32_t closed; // the producer is done
+};
+
+struct ShmSlotHeader{
+  volatile uint64_t sequence; // 2n when frame n is complete, odd while written
+  double timestamp; // seconds
+};
+
+class ShmRingWriter{
+  /* The producer side, used by satori_shmring and meant to be copied
+     into capture programs that feed satori. */
+ public:
+  ShmRingWriter();
+  ~ShmRingWriter(); // closes, and unlinks a ring it created
+
+  bool create(const string& name, int width, int height, int channels, int slots);
+  void close();
+
+  unsigned char* begin_frame(); // pixels of the next slot to fill
+  void publish(double timestamp); // make the frame from begin_frame() visible
+  int stride() const;
+
+ private:
+  string name;
+  ShmRingHeader* header;
+  size_t mapped;
+  uint64_t writing; // frame number being written, 0 for none
+};
+
+class ShmRingSource : public FrameSource{
+  /* Reads frames in place from a ring filled by another process.  By
+     default the newest frame is taken and any in between counted as
+     dropped; in order, every frame still in the ring is read.
+
+     Frames handed out point into the ring, so a producer that laps the
+     reader can overwrite a frame while it is processed.  That is
+     noticed on the next call and counted in overwritten(); give the
+     ring enough slots for the reader to stay ahead.
+  */
+ public:
+  ShmRingSource(bool in_order = false, double timeout = 0.0); // timeout 0 waits forever
+  ~ShmRingSource();
+
+  bool open(const string& name);
+  void close();
+
+  IplImage* next_frame(double& timestamp); // NULL when the producer closed the ring
+  long dropped() const;
+  long overwritten() const; // frames changed by the producer while in use
+  CvSize frame_size() const;
+
+ private:
+  ShmRingHeader* header;
+  size_t mapped;
+  bool in_order;
+  double timeout;
+  IplImage frame; // header over the slot in use
+  uint64_t current; // frame number handed out last, 0 for none
+  long _dropped, _overwritten;
+
+  // methods
+  ShmSlotHeader* slot(uint64_t number) const;
+};
+
+#endif
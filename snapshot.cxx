@@ -0,0 +1,46 @@
+/*
+ * snapshot.cxx - Image blocks of component snapshots
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "snapshot.h"
+
+static int row_bytes(const IplImage* img){
+  // bytes of pixel data in a row, without padding
+  return img->width * img->nChannels * ((img->depth & 255) / 8);
+}
+
+void put_image(ostream& out, const IplImage* img){
+  int width = img->width, height = img->height;
+  int depth = img->depth, channels = img->nChannels;
+  put_value(out, width);
+  put_value(out, height);
+  put_value(out, depth);
+  put_value(out, channels);
+
+  int bytes = row_bytes(img);
+  for (int y = 0; y < height; ++y){
+    out.write(img->imageData + y * img->widthStep, bytes);
+  }
+}
+
+bool get_image(istream& in, IplImage* img){
+  int width, height, depth, channels;
+  if (!get_value(in, width) || !get_value(in, height) ||
+      !get_value(in, depth) || !get_value(in, channels))
+    return false;
+  if (width != img->width || height != img->height ||
+      depth != img->depth || channels != img->nChannels)
+    return false;
+
+  int bytes = row_bytes(img);
+  for (int y = 0; y < height && in.good(); ++y){
+    in.read(img->imageData + y * img->widthStep, bytes);
+  }
+  return in.good();
+}
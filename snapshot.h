@@ -0,0 +1,44 @@
+/*
+ * snapshot.h - Binary snapshots of component state
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+// includes
+#include "cv.h"
+#include <iostream>
+
+// namespace preparation
+using namespace std;
+
+/* Snapshots are written in host byte order and only read back by the
+   same build on the same kind of machine; they carry warm state across
+   a restart, not data between systems.  Each component writes its own
+   block with put_value() and put_image() and reads it back the same
+   way, failing the whole load on the first short or mismatched read.
+*/
+
+template<class T> void put_value(ostream& out, const T& value){
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<class T> bool get_value(istream& in, T& value){
+  in.read(reinterpret_cast<char*>(&value), sizeof(value));
+  return in.good();
+}
+
+void put_image(ostream&, const IplImage*); // size, format, then packed rows
+bool get_image(istream&, IplImage*); // must match the saved size and format
+
+#endif
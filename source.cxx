@@ -0,0 +1,60 @@
+/*
+ * source.cxx - Implementation of frame sources
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "source.h"
+#include "stats.h"	// monotonic clock
+
+// FrameSource
+
+bool FrameSource::next_key(char& key){
+  return false;
+}
+
+bool FrameSource::interactive() const{
+  return true;
+}
+
+long FrameSource::dropped() const{
+  return 0;
+}
+
+CvSize FrameSource::frame_size() const{
+  return cvSize(0, 0);
+}
+
+// CameraSource
+
+CameraSource::CameraSource(int device){
+  capture = cvCaptureFromCAM(device);
+  start = monotonic_seconds();
+}
+
+CameraSource::~CameraSource(){
+  if (capture)
+    cvReleaseCapture(&capture);
+}
+
+bool CameraSource::opened() const{
+  return capture != NULL;
+}
+
+IplImage* CameraSource::next_frame(double& timestamp){
+  IplImage* frame = cvQueryFrame(capture);
+  timestamp = monotonic_seconds() - start;
+  return frame;
+}
+
+CvSize CameraSource::frame_size() const{
+  if (!capture)
+    return cvSize(0, 0);
+
+  return cvSize((int)cvGetCaptureProperty(capture, CV_CAP_PROP_FRAME_WIDTH),
+                (int)cvGetCaptureProperty(capture, CV_CAP_PROP_FRAME_HEIGHT));
+}
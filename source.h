@@ -0,0 +1,56 @@
+/*
+ * source.h - Sources of frames for the live processing loop
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _SOURCE_H_
+#define _SOURCE_H_
+
+// includes
+#include "common.h"
+#include "cv.h"
+#include "highgui.h"
+
+// namespace preparation
+using namespace std;
+
+class FrameSource{
+  /* Something that hands the live loop one frame at a time.  Frames are
+     owned by the source and stay valid until the next call to
+     next_frame().  Timestamps are in seconds from the start of the
+     source on a monotonic clock.
+  */
+ public:
+  virtual ~FrameSource(){}
+
+  virtual IplImage* next_frame(double& timestamp) = 0; // NULL when done
+  virtual bool next_key(char& key); // keys that came with the last frame
+  virtual bool interactive() const; // should the keyboard be read?
+  virtual long dropped() const; // frames skipped so far, never processed
+  virtual CvSize frame_size() const; // 0x0 when not known before the first frame
+};
+
+class CameraSource : public FrameSource{
+ public:
+  CameraSource(int device = 0); // capture from a camera
+  ~CameraSource();
+
+  bool opened() const;
+  IplImage* next_frame(double& timestamp);
+  CvSize frame_size() const;
+
+ private:
+  CvCapture* capture;
+  double start; // monotonic time the source was opened
+};
+
+#endif
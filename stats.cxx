@@ -0,0 +1,236 @@
+/*
+ * stats.cxx - Implementation of latency and throughput statistics
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ */
+
+#include "stats.h"
+#include <fstream>
+#include <iomanip>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+
+static const char* STAGE_NAMES[NUM_STAGES] = {
+  "capture", "convert", "gate", "flow", "segment", "camshift",
+  "focus", "annotate", "output", "frame"
+};
+
+static volatile sig_atomic_t stats_requests = 0;
+static volatile sig_atomic_t stop_requests = 0;
+static sig_atomic_t stats_seen = 0;
+
+double monotonic_seconds(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// LatencyHistogram
+
+LatencyHistogram::LatencyHistogram(){
+  reset();
+}
+
+void LatencyHistogram::reset(){
+  for (int i = 0; i < NUM_BUCKETS; ++i){
+    buckets[i] = 0;
+  }
+  _count = 0;
+  _total = 0.0;
+  _max = 0.0;
+}
+
+static double bucket_upper(int bucket){
+  // upper edge of a bucket in seconds
+  return 1e-6 * pow(2.0, (bucket + 1) / 4.0);
+}
+
+void LatencyHistogram::add(double seconds){
+  int bucket = 0;
+  double us = seconds * 1e6;
+  if (us > 1.0){
+    bucket = (int)(log2(us) * 4.0);
+    if (bucket >= NUM_BUCKETS)
+      bucket = NUM_BUCKETS - 1;
+  }
+
+  ++buckets[bucket];
+  ++_count;
+  _total += seconds;
+  if (seconds > _max)
+    _max = seconds;
+}
+
+long LatencyHistogram::count() const{
+  return _count;
+}
+
+double LatencyHistogram::total() const{
+  return _total;
+}
+
+double LatencyHistogram::max() const{
+  return _max;
+}
+
+double LatencyHistogram::percentile(double p) const{
+  if (_count == 0)
+    return 0.0;
+
+  long rank = (long)ceil(p * _count);
+  if (rank < 1)
+    rank = 1;
+
+  long seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; ++i){
+    seen += buckets[i];
+    if (seen >= rank)
+      return i == NUM_BUCKETS - 1 ? _max : (bucket_upper(i) < _max ? bucket_upper(i) : _max);
+  }
+
+  return _max;
+}
+
+// Stats
+
+Stats::Stats(){
+  reset();
+}
+
+void Stats::reset(){
+  for (int i = 0; i < NUM_STAGES; ++i){
+    hist[i].reset();
+    started[i] = 0.0;
+    skipped[i] = 0;
+  }
+  first_frame = last_frame = 0.0;
+  frames = points = segments = dropped = 0;
+}
+
+void Stats::begin(Stage stage){
+  started[stage] = monotonic_seconds();
+}
+
+void Stats::end(Stage stage){
+  double now = monotonic_seconds();
+  hist[stage].add(now - started[stage]);
+}
+
+void Stats::skip(Stage stage){
+  ++skipped[stage];
+}
+
+void Stats::frame_done(int num_points, int num_segments){
+  double now = monotonic_seconds();
+  if (frames == 0)
+    first_frame = now;
+  last_frame = now;
+
+  ++frames;
+  points += num_points;
+  segments += num_segments;
+}
+
+void Stats::frames_dropped(long count){
+  dropped += count;
+}
+
+const char* Stats::stage_name(Stage stage){
+  return STAGE_NAMES[stage];
+}
+
+void Stats::print(ostream& out) const{
+  double elapsed = last_frame - first_frame;
+  double rate = elapsed > 0.0 ? 1.0 / elapsed : 0.0;
+
+  out << endl << "  * " << "Processed " << frames << " frames in "
+      << setprecision(3) << fixed << elapsed << "s" << endl;
+  out << "    * " << (frames > 1 ? (frames - 1) * rate : 0.0) << " frames/s, "
+      << points * rate << " points/s, "
+      << segments * rate << " segments/s" << endl;
+  if (dropped > 0)
+    out << "    * " << dropped << " frames dropped ("
+        << 100.0 * dropped / (dropped + frames) << "% of captured)" << endl;
+
+  out << "    * " << setw(10) << left << "stage" << right
+      << setw(8) << "count"
+      << setw(10) << "p50 ms" << setw(10) << "p95 ms"
+      << setw(10) << "p99 ms" << setw(10) << "max ms"
+      << setw(10) << "skipped" << endl;
+
+  for (int i = 0; i < NUM_STAGES; ++i){
+    const LatencyHistogram& h = hist[i];
+    if (h.count() == 0 && skipped[i] == 0)
+      continue;
+
+    out << "      " << setw(10) << left << STAGE_NAMES[i] << right
+        << setw(8) << h.count()
+        << setw(10) << h.percentile(0.50) * 1e3
+        << setw(10) << h.percentile(0.95) * 1e3
+        << setw(10) << h.percentile(0.99) * 1e3
+        << setw(10) << h.max() * 1e3
+        << setw(10) << skipped[i] << endl;
+  }
+
+  out.unsetf(ios::fixed);
+  out << setprecision(6);
+}
+
+bool Stats::dump(const string& filename) const{
+  // one record per line, space separated key=value pairs, times in us
+  ofstream out(filename.c_str());
+  if (!out)
+    return false;
+
+  double elapsed = last_frame - first_frame;
+  out << "frames=" << frames
+      << " elapsed_s=" << elapsed
+      << " points=" << points
+      << " segments=" << segments
+      << " dropped=" << dropped << endl;
+
+  for (int i = 0; i < NUM_STAGES; ++i){
+    const LatencyHistogram& h = hist[i];
+    out << "stage=" << STAGE_NAMES[i]
+        << " count=" << h.count()
+        << " mean_us=" << (h.count() ? h.total() / h.count() * 1e6 : 0.0)
+        << " p50_us=" << h.percentile(0.50) * 1e6
+        << " p95_us=" << h.percentile(0.95) * 1e6
+        << " p99_us=" << h.percentile(0.99) * 1e6
+        << " max_us=" << h.max() * 1e6
+        << " skipped=" << skipped[i] << endl;
+  }
+
+  return out.good();
+}
+
+// Signals
+
+static void on_stats_signal(int){
+  stats_requests = stats_requests + 1;
+}
+
+static void on_stop_signal(int){
+  stop_requests = 1;
+}
+
+void install_stats_signals(){
+  signal(SIGUSR1, on_stats_signal);
+  signal(SIGINT, on_stop_signal);
+  signal(SIGTERM, on_stop_signal);
+}
+
+bool stats_signaled(){
+  if (stats_requests == stats_seen)
+    return false;
+
+  stats_seen = stats_requests;
+  return true;
+}
+
+bool stop_signaled(){
+  return stop_requests != 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * stats.h - Per-stage latency histograms and throughput counters
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+// includes
+#include <iostream>
+#include <string>
+
+// namespace preparation
+using namespace std;
+
+// pipeline stages that are timed
+enum Stage{
+  STAGE_CAPTURE,	// grabbing or loading a frame
+  STAGE_CONVERT,	// copying and color conversion
+  STAGE_GATE,		// the idle mode motion check
+  STAGE_FLOW,		// Flow::pair_flow
+  STAGE_SEGMENT,	// Track::update_motion_segments
+  STAGE_CAMSHIFT,	// Track::update_camshift
+  STAGE_FOCUS,		// Focus::update and any track reset
+  STAGE_ANNOTATE,	// drawing results
+  STAGE_OUTPUT,		// showing or saving results
+  STAGE_FRAME,		// the whole frame, end to end
+  NUM_STAGES
+};
+
+double monotonic_seconds(); // seconds on a clock that never steps back
+
+class LatencyHistogram{
+  /* Fixed log-spaced buckets, four per octave from 1us to ~16s, so
+     adding a sample is a couple of arithmetic ops and percentiles are
+     accurate to about 20%.  The exact maximum is kept separately.
+  */
+ public:
+  static const int NUM_BUCKETS = 24 * 4 + 1;	// last bucket is overflow
+
+  LatencyHistogram();
+
+  void add(double seconds);
+  void reset();
+
+  long count() const;
+  double total() const;
+  double max() const;
+  double percentile(double p) const;	// p in [0,1], in seconds
+
+ private:
+  long buckets[NUM_BUCKETS];
+  long _count;
+  double _total, _max;
+};
+
+class Stats{
+ public:
+  Stats();
+
+  // Action Functions
+  void begin(Stage);			// start timing a stage
+  void end(Stage);			// stop timing a stage and record it
+  void skip(Stage);			// count a stage left out of a frame
+  void frame_done(int points, int segments);	// count a finished frame
+  void frames_dropped(long count);	// count frames that were never processed
+  void reset();
+
+  // Output Functions
+  void print(ostream&) const;		// human readable summary
+  bool dump(const string& filename) const;	// machine readable stats
+
+  static const char* stage_name(Stage);
+
+ private:
+  LatencyHistogram hist[NUM_STAGES];
+  double started[NUM_STAGES];
+  long skipped[NUM_STAGES];		// runs of each stage saved by scheduling
+  double first_frame, last_frame;	// monotonic times of the first and last frame
+  long frames, points, segments, dropped;
+};
+
+// signal handling for long runs: SIGUSR1 asks for a summary,
+// SIGINT/SIGTERM ask the processing loop to stop cleanly
+void install_stats_signals();
+bool stats_signaled();	// true once for every SIGUSR1 received
+bool stop_signaled();
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * synth.cxx - Implementation of SyntheticScene class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "synth.h"
+#include "img_template.tpl"	// provides efficient access to pixels
+
+static const int TEXTURE_SIZE = 64;	// must be a power of two
+static const int NOISE_SIZE = 1024;	// must be a power of two
+static const int NOISE_LEVEL = 3;	// well below Track's diff_threshold
+
+unsigned int synth_random(unsigned int& state){
+  // xorshift32
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static inline unsigned char clamp_byte(int v){
+  return (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static float bounce(float p, int lo, int hi){
+  // fold an unbounded coordinate back into [lo, hi]
+  float len = (float)(hi - lo);
+  if (len <= 0.f)
+    return (float)lo;
+
+  float u = fmodf(p - lo, 2.f * len);
+  if (u < 0.f)
+    u += 2.f * len;
+  if (u > len)
+    u = 2.f * len - u;
+
+  return lo + u;
+}
+
+// Constructors
+
+SyntheticScene::SyntheticScene(const CvSize& size, int num_objects,
+                               float speed, unsigned int seed){
+  unsigned int state = seed ? seed : 1;
+  _size = size;
+
+  // background: smooth gradient plus blocky texture so that LK has
+  // corners to follow everywhere, and the motion mask stays quiet
+  background = cvCreateImage(size, IPL_DEPTH_8U, 3);
+  RgbImage bg(background);
+  int tiles_x = size.width / 16 + 1;
+  vector<int> tile_shade(tiles_x * (size.height / 16 + 1));
+  for (size_t i = 0; i < tile_shade.size(); ++i){
+    tile_shade[i] = (int)(synth_random(state) % 48) - 24;
+  }
+  for (int y = 0; y < size.height; ++y){
+    for (int x = 0; x < size.width; ++x){
+      int shade = 96 + 64 * x / size.width + tile_shade[(y / 16) * tiles_x + x / 16];
+      bg[y][x].b = clamp_byte(shade + 20);
+      bg[y][x].g = clamp_byte(shade);
+      bg[y][x].r = clamp_byte(shade - 10);
+    }
+  }
+
+  texture = new signed char[TEXTURE_SIZE * TEXTURE_SIZE];
+  for (int ty = 0; ty < TEXTURE_SIZE; ty += 8){
+    for (int tx = 0; tx < TEXTURE_SIZE; tx += 8){
+      int amp = (int)(synth_random(state) % 81) - 40;
+      for (int y = ty; y < ty + 8; ++y){
+        for (int x = tx; x < tx + 8; ++x){
+          texture[y * TEXTURE_SIZE + x] = (signed char)amp;
+        }
+      }
+    }
+  }
+
+  noise = new signed char[NOISE_SIZE];
+  for (int i = 0; i < NOISE_SIZE; ++i){
+    noise[i] = (signed char)((int)(synth_random(state) % (2 * NOISE_LEVEL + 1)) - NOISE_LEVEL);
+  }
+
+  // objects scale with the frame so every resolution sees the same scene
+  float scale = size.width / 640.f;
+  for (int i = 0; i < num_objects; ++i){
+    Blob blob;
+    blob.rx = (int)((20 + synth_random(state) % 40) * scale);
+    blob.ry = (int)((20 + synth_random(state) % 40) * scale);
+    blob.x0 = (float)(synth_random(state) % MAX(size.width, 1));
+    blob.y0 = (float)(synth_random(state) % MAX(size.height, 1));
+
+    float angle = (synth_random(state) % 3600) * (float)CV_PI / 1800.f;
+    blob.vx = cosf(angle) * speed * scale;
+    blob.vy = sinf(angle) * speed * scale;
+
+    // saturated hues so CAMSHIFT has a color model to follow
+    int hue = synth_random(state) % 3;
+    blob.b = hue == 0 ? 220 : 40;
+    blob.g = hue == 1 ? 220 : 40;
+    blob.r = hue == 2 ? 220 : 40;
+    blobs.push_back(blob);
+  }
+}
+
+SyntheticScene::~SyntheticScene(){
+  cvReleaseImage(&background);
+  delete [] texture;
+  delete [] noise;
+}
+
+// Access Functions
+
+const CvSize& SyntheticScene::size() const{
+  return _size;
+}
+
+int SyntheticScene::object_count() const{
+  return (int)blobs.size();
+}
+
+void SyntheticScene::center(const Blob& blob, int frame, int& x, int& y) const{
+  x = cvRound(bounce(blob.x0 + blob.vx * frame, blob.rx, _size.width - 1 - blob.rx));
+  y = cvRound(bounce(blob.y0 + blob.vy * frame, blob.ry, _size.height - 1 - blob.ry));
+}
+
+CvRect SyntheticScene::object_rect(int object, int frame) const{
+  const Blob& blob = blobs[object];
+  int cx, cy;
+  center(blob, frame, cx, cy);
+
+  return cvRect(cx - blob.rx, cy - blob.ry, 2 * blob.rx + 1, 2 * blob.ry + 1);
+}
+
+// Action Functions
+
+void SyntheticScene::render(int frame, IplImage* dst){
+  RgbImage out(dst);
+  RgbImage bg(background);
+  unsigned int state = 0x9e3779b9u ^ (unsigned int)frame;
+  synth_random(state);
+
+  // background with sensor noise, the noise table is read at a random
+  // offset per row so no two frames are the same
+  for (int y = 0; y < _size.height; ++y){
+    int offset = synth_random(state) & (NOISE_SIZE - 1);
+    for (int x = 0; x < _size.width; ++x){
+      int n = noise[(x + offset) & (NOISE_SIZE - 1)];
+      out[y][x].b = clamp_byte(bg[y][x].b + n);
+      out[y][x].g = clamp_byte(bg[y][x].g + n);
+      out[y][x].r = clamp_byte(bg[y][x].r + n);
+    }
+  }
+
+  // blobs, with the texture fixed to the blob so features move with it
+  for (size_t i = 0; i < blobs.size(); ++i){
+    const Blob& blob = blobs[i];
+    int cx, cy;
+    center(blob, frame, cx, cy);
+
+    for (int dy = -blob.ry; dy <= blob.ry; ++dy){
+      int y = cy + dy;
+      if (y < 0 || y >= _size.height)
+        continue;
+      float fy = (float)dy / blob.ry;
+
+      for (int dx = -blob.rx; dx <= blob.rx; ++dx){
+        int x = cx + dx;
+        float fx = (float)dx / blob.rx;
+        if (x < 0 || x >= _size.width || fx * fx + fy * fy > 1.f)
+          continue;
+
+        int t = texture[((dy + blob.ry) & (TEXTURE_SIZE - 1)) * TEXTURE_SIZE +
+                        ((dx + blob.rx) & (TEXTURE_SIZE - 1))];
+        out[y][x].b = clamp_byte(blob.b + t);
+        out[y][x].g = clamp_byte(blob.g + t);
+        out[y][x].r = clamp_byte(blob.r + t);
+      }
+    }
+  }
+}
@@ -0,0 +1,68 @@
+/*
+ * synth.h - Deterministic synthetic scenes for benchmarking
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _SYNTH_H_
+#define _SYNTH_H_
+
+// includes
+#include "common.h"
+#include "cv.h"
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+class SyntheticScene{
+  /* Textured elliptical blobs moving at constant velocity over a
+     textured, noisy background, bouncing off the frame borders.  Every
+     frame is a pure function of (size, objects, speed, seed, frame index)
+     so any frame can be rendered in any order and the same sequence is
+     produced on every machine.
+  */
+ public:
+  SyntheticScene(const CvSize& size, int num_objects,
+                 float speed, // pixels per frame at 640 pixels wide
+                 unsigned int seed = 1);
+  ~SyntheticScene();
+
+  // Action Functions
+  void render(int frame, IplImage* dst); // dst is 8 bit, 3 channel BGR
+
+  // Access Functions
+  const CvSize& size() const;
+  int object_count() const;
+  CvRect object_rect(int object, int frame) const; // ground truth bounds
+
+ private:
+  struct Blob{
+    float x0, y0; // center at frame 0
+    float vx, vy; // pixels per frame
+    int rx, ry; // radii
+    int b, g, r; // base color
+  };
+
+  CvSize _size;
+  vector<Blob> blobs;
+  IplImage *background; // static textured background
+  signed char *texture; // 64x64 blob texture
+  signed char *noise; // per-frame sensor noise table
+
+  // methods
+  void center(const Blob&, int frame, int& x, int& y) const;
+};
+
+// repeatable pseudo random numbers, independent of the C library
+unsigned int synth_random(unsigned int& state);
+
+#endif
@@ -9,128 +9,565 @@
  */
 
 #include "track.h"
+#include "pool.h"
+#include "snapshot.h"
 #include "img_template.tpl"
+#include <string.h>
 
-const double Track::MHI_DURATION = 1;
-const double Track::MAX_TIME_DELTA = 0.5;
 const double Track::MIN_TIME_DELTA = 0.05;
-const int Track::FBSIZE = 4;
+
+static IplImage band_view(const IplImage* img, const CvRect& r){
+  // a header over a part of img, so bands need no shared ROI
+  IplImage view;
+  cvInitImageHeader(&view, cvSize(r.width, r.height), img->depth, img->nChannels,
+                    img->origin, img->align);
+  cvSetData(&view, img->imageData + r.y * img->widthStep +
+            r.x * img->nChannels * ((img->depth & 255) / 8), img->widthStep);
+  return view;
+}
 
 Track::Track(){
+  // buffers are allocated by prepare(), for the first frame at the latest
+  frame_size = cvSize(0, 0);
+
   // init for motion segmentation
-  last = 0;
+  silh = NULL;
+  mhi = NULL;
+  segmask = NULL;
+  storage = NULL;
+  segs = NULL;
   diff_threshold = 30;
+  mhi_duration = 1.0;
+  max_time_delta = 0.5;
+  last_time = 0.0;
+  _history_depth = IPL_DEPTH_32F;
   segs_sorted = false;
 
   // init for camshift
   track_object = false;
-  hsv = NULL;
+  memset(&track_comp, 0, sizeof(track_comp));
+  frame = NULL;
+  backproject = NULL;
+  hist = NULL;
+  _track_box.center = cvPoint2D32f(0, 0);
+  _track_box.size = cvSize2D32f(0, 0);
+  _track_box.angle = 0;
   hdims = 16;
   vmin = 10;
   vmax = 256;
   smin = 30;
-  tmp1 = cvCreateImage(FRAME_SIZE, 8, 1);
-  tmp2 = cvCreateImage(FRAME_SIZE, 8, 1);
-  tmp3 = cvCreateImage(FRAME_SIZE, 8, 1);
+
+  // init for re-acquisition
+  lost_density = 0.05;
+  reacquire_density = 0.3;
+  reacquire_scale = 0.25;
+  max_models = 4;
+  _reacquired = false;
+  search_hue = search_mask = search_backproject = search_sum = NULL;
 }
 
 Track::~Track(){  
-  cvReleaseImage(&hsv);
-  cvReleaseImage(&hue);
-  cvReleaseImage(&backproject);
-  cvReleaseImage(&mask);
-  cvReleaseImage(&tmp1);
-  cvReleaseImage(&tmp2);
-  cvReleaseImage(&tmp3);
-}
-
-void Track::update(IplImage *img){
-  update_motion_segments(img);
-  update_camshift(img);
-}
-
-void Track::update_motion_segments(IplImage *img){
-  double timestamp = (double)clock()/CLOCKS_PER_SEC; // current time in seconds
-  CvSize size = cvSize(img->width, img->height); // current frame size
-  int index1 = last, index2;
-  IplImage *silh;
-    
-  if (!mhi || mhi->width != size.width || mhi->height != size.height){
-    if (buf == 0){
-      buf = (IplImage**)malloc(FBSIZE*sizeof(buf[0]));
-      memset(buf, 0, FBSIZE*sizeof(buf[0]));
-    }
+  release_buffers();
 
-    // clear out buffers
-    for (int i = 0; i < FBSIZE; ++i){
-      cvReleaseImage(&buf[i]);
-      buf[i] = cvCreateImage(size, IPL_DEPTH_8U, 1);
-      cvZero(buf[i]);
-    }
-        
-    cvReleaseImage(&mhi);
-    cvReleaseImage(&segmask);
+  if (hist)
+    cvReleaseHist(&hist);
+  if (storage)
+    cvReleaseMemStorage(&storage);
+}
+
+void Track::set_history_depth(int depth){
+  // the history is dropped when its representation changes
+  if (depth != IPL_DEPTH_8U && depth != IPL_DEPTH_16U)
+    depth = IPL_DEPTH_32F;
+  if (depth == _history_depth)
+    return;
+
+  release_buffers();
+  _history_depth = depth;
+  frame_size = cvSize(0, 0);
+}
+
+int Track::history_depth() const{
+  return _history_depth;
+}
+
+void Track::set_threads(int threads){
+  workers.set_threads(threads);
+}
+
+void Track::set_params(const TrackParams& params){
+  diff_threshold = params.diff_threshold;
+  mhi_duration = params.mhi_duration > 0.0 ? params.mhi_duration : 1.0;
+  max_time_delta = params.max_time_delta;
+  vmin = params.vmin;
+  vmax = params.vmax;
+  smin = params.smin;
+  lost_density = params.lost_density;
+  reacquire_density = params.reacquire_density;
+  reacquire_scale = params.reacquire_scale > 0.0 ? MIN(params.reacquire_scale, 1.0) : 0.25;
+  max_models = MAX(params.reacquire_models, 0);
+  if ((int)models.size() > max_models)
+    models.resize(max_models);
+
+  // the histogram is rebuilt with the new bins from the next selection
+  if (params.hdims != hdims && params.hdims > 0){
+    hdims = params.hdims;
+    if (hist)
+      cvReleaseHist(&hist);
+    float range[] = {0, 180};
+    float *ranges = range;
+    hist = cvCreateHist(1, &hdims, CV_HIST_ARRAY, &ranges, 1);
+    track_object = false;
+    models.clear(); // remembered with the old bins
+  }
+}
+
+void Track::prepare(const CvSize& size){
+  // allocate every working buffer for frames of the given size
+  if (silh && size.width == frame_size.width && size.height == frame_size.height)
+    return;
 
-    mhi = cvCreateImage(size, IPL_DEPTH_32F, 1);
+  release_buffers();
+  ImagePool& pool = ImagePool::shared();
+  frame_size = size;
+
+  // motion segmentation
+  silh = pool.acquire(size, IPL_DEPTH_8U, 1);
+  if (_history_depth == IPL_DEPTH_32F){
+    mhi = pool.acquire(size, IPL_DEPTH_32F, 1);
     cvZero(mhi);
-    segmask = cvCreateImage(size, IPL_DEPTH_32F, 1);
+    segmask = pool.acquire(size, IPL_DEPTH_32F, 1);
   }
+  else{
+    compact.set_depth(_history_depth);
+    compact.prepare(size);
+  }
+  if (!storage)
+    storage = cvCreateMemStorage(0);
 
-  // convert to grayscale
-  cvCvtColor(img, buf[last], CV_BGR2GRAY);
+  // camshift, a window from another frame size means nothing here
+  backproject = pool.acquire(size, IPL_DEPTH_8U, 1);
+  if (!hist){
+    float range[] = {0, 180};
+    float *ranges = range;
+    hist = cvCreateHist(1, &hdims, CV_HIST_ARRAY, &ranges, 1);
+  }
+  track_object = false;
+  prepare_mask();
+}
 
-  index2 = (last + 1) % FBSIZE;
-  last = index2;
+void Track::set_mask(const IplImage* mask){
+  exclusion.set_source(mask);
+  search_exclusion.set_source(mask);
+  if (silh)
+    prepare_mask();
+}
 
-  silh = buf[index2];
-  cvAbsDiff(buf[index1], buf[index2], silh); // get frame difference
+void Track::prepare_mask(){
+  // history outside the kept area is never updated again, so none may be left
+  exclusion.prepare(frame_size);
+  if (!exclusion.active()){
+    // nothing outside the old area moved, so widening it needs no clear
+    if (!mhi)
+      compact.set_area(cvRect(0, 0, frame_size.width, frame_size.height));
+    return;
+  }
 
-  // threshold difference
-  cvThreshold(silh, silh, diff_threshold, 1, CV_THRESH_BINARY);
-  // update MHI
-  cvUpdateMotionHistory(silh, mhi, timestamp, MHI_DURATION);
+  cvZero(silh);
+  if (mhi)
+    cvZero(mhi);
+  else{
+    compact.clear();
+    compact.set_area(exclusion.bounds());
+  }
+}
 
-  if (!storage){
-    storage = cvCreateMemStorage(0);
+void Track::release_buffers(){
+  // hand working images back to the pool
+  ImagePool& pool = ImagePool::shared();
+
+  pool.release(silh);
+  pool.release(mhi);
+  pool.release(segmask);
+  compact.release();
+  pool.release(backproject);
+  exclusion.release();
+  band_segmenter.release();
+  pool.release(search_hue);
+  pool.release(search_mask);
+  pool.release(search_backproject);
+  pool.release(search_sum);
+  search_exclusion.release();
+  segs = NULL;
+}
+
+void Track::update(FrameContext& f){
+  update_motion_segments(f);
+  update_camshift(f);
+}
+
+void Track::update_motion_segments(FrameContext& f){
+  prepare(f.size()); // no-op unless the frame size changed
+  double timestamp = f.timestamp(); // current time in seconds
+  IplImage* prev = f.gray_ago(GRAY_HISTORY); // differenced across frames, as in motempl
+  const CvRect& area = exclusion.bounds(); // the whole frame without a mask
+  bool masked = exclusion.active();
+
+  if (workers.threads() > 1 && area.width > 0 && area.height > 0){
+    update_motion_bands(f);
+    return;
+  }
+
+  if (prev && area.width > 0 && area.height > 0){
+    // rows and columns around the kept area are left alone, silh stays 0 there
+    IplImage* curr = f.gray();
+    if (masked){
+      cvSetImageROI(prev, area);
+      cvSetImageROI(curr, area);
+      cvSetImageROI(silh, area);
+    }
+    cvAbsDiff(prev, curr, silh); // get frame difference
+
+    // threshold difference
+    cvThreshold(silh, silh, diff_threshold, 1, CV_THRESH_BINARY);
+    if (masked){
+      cvResetImageROI(prev);
+      cvResetImageROI(curr);
+      cvResetImageROI(silh);
+      exclusion.apply_within_bounds(silh);
+    }
   }
-  else {
-    cvClearMemStorage(storage);
+  else{
+    f.gray(); // so the next frame has something to difference against
+    cvZero(silh);
   }
 
-  segs = cvSegmentMotion(mhi, segmask, storage, timestamp, MAX_TIME_DELTA);
+  // update MHI
+  if (!loaded_ages.empty())
+    rebase(timestamp);
+  cvClearMemStorage(storage);
+  if (mhi){
+    if (!masked){
+      cvUpdateMotionHistory(silh, mhi, timestamp, mhi_duration);
+    }
+    else if (area.width > 0 && area.height > 0){
+      cvSetImageROI(silh, area);
+      cvSetImageROI(mhi, area);
+      cvUpdateMotionHistory(silh, mhi, timestamp, mhi_duration);
+      cvResetImageROI(silh);
+      cvResetImageROI(mhi);
+    }
+    segs = cvSegmentMotion(mhi, segmask, storage, timestamp, max_time_delta);
+  }
+  else{
+    compact.update(silh, timestamp, mhi_duration);
+    segs = compact.segment(storage, max_time_delta);
+  }
+  last_time = timestamp;
 
   segs_sorted = false;
 }
 
-void Track::update_camshift(IplImage *img){
-  if (!hsv){
-    hsv = cvCreateImage(cvGetSize(img), 8, 3);
-    hue = cvCreateImage(cvGetSize(img), 8, 1);
-    mask = cvCreateImage(cvGetSize(img), 8, 1);
-    backproject = cvCreateImage(cvGetSize(img), 8, 1);
-    float range[] = {0, 180};
-    float *ranges = range;
-    hist = cvCreateHist(1, &hdims, CV_HIST_ARRAY, &ranges, 1);
+void Track::update_motion_bands(FrameContext& f){
+  // the same steps, each band of rows differenced, thresholded, masked and
+  // stamped by one thread, then segmented in bands as well
+  const CvRect& area = exclusion.bounds();
+  MotionJob job;
+  job.track = this;
+  job.prev = f.gray_ago(GRAY_HISTORY); // both made here, FrameContext is not for threads
+  job.curr = f.gray();
+  job.timestamp = f.timestamp();
+  job.bands = split_rows(area, band_count(area.height, workers.threads()));
+
+  if (!loaded_ages.empty())
+    rebase(job.timestamp);
+  cvClearMemStorage(storage);
+  if (!mhi)
+    compact.begin_update(frame_size, job.timestamp, mhi_duration);
+  workers.run(update_band, &job, (int)job.bands.size());
+
+  if (mhi)
+    segs = band_segmenter.segment(mhi, job.timestamp, area, max_time_delta, storage, workers);
+  else
+    segs = compact.segment(storage, max_time_delta, band_segmenter, workers);
+  last_time = job.timestamp;
+
+  segs_sorted = false;
+}
+
+void Track::update_band(void* arg, int band){
+  const MotionJob& job = *static_cast<MotionJob*>(arg);
+  Track& t = *job.track;
+  const CvRect& r = job.bands[band];
+  IplImage silh = band_view(t.silh, r);
+
+  if (job.prev){
+    IplImage prev = band_view(job.prev, r), curr = band_view(job.curr, r);
+    cvAbsDiff(&prev, &curr, &silh);
+    cvThreshold(&silh, &silh, t.diff_threshold, 1, CV_THRESH_BINARY);
+    t.exclusion.apply_within(t.silh, r);
   }
+  else{
+    cvZero(&silh);
+  }
+
+  if (t.mhi){
+    IplImage mhi = band_view(t.mhi, r);
+    cvUpdateMotionHistory(&silh, &mhi, job.timestamp, t.mhi_duration);
+  }
+  else{
+    t.compact.update_rows(t.silh, r);
+  }
+}
 
-  cvCvtColor(img, hsv, CV_BGR2HSV);
+void Track::update_camshift(FrameContext& f){
+  prepare(f.size()); // no-op unless the frame size changed
+  frame = &f;
 
-  if (track_object){
-    int _vmin = vmin, _vmax = vmax;
+  // a lost object may be back, CAMSHIFT takes over from where it is found
+  _reacquired = false;
+  if (!track_object && !models.empty())
+    reacquire(f);
 
-    cvInRangeS(hsv, cvScalar(0, smin, MIN(_vmin,_vmax), 0),
-                cvScalar(180, 256, MAX(_vmin, _vmax), 0), mask);
-    cvSplit(hsv, hue, 0, 0, 0);
+  if (track_object){
+    IplImage* hue = f.hue();
+    IplImage* mask = f.mask(smin, vmin, vmax);
 
     cvCalcBackProject(&hue, backproject, hist);
     cvAnd(backproject, mask, backproject, 0);
+    exclusion.apply(backproject);
     cvCamShift(backproject, track_window, 
                cvTermCriteria(CV_TERMCRIT_EPS | CV_TERMCRIT_ITER, 10, 1),
                &track_comp, &_track_box);
     track_window = track_comp.rect;
 
-    if (!img->origin)
+    if (!f.color()->origin)
       _track_box.angle = -_track_box.angle;
+
+    // the object's color has left the window: it is lost, but its color
+    // model is kept to look for it
+    double window_area = MAX(track_window.width * track_window.height, 1);
+    if (track_window.width <= 1 || track_window.height <= 1 ||
+        track_comp.area < lost_density * 255.0 * window_area){
+      remember_model();
+      track_object = false;
+    }
+  }
+}
+
+void Track::remember_model(){
+  // most recent first; a model much like one remembered replaces it
+  if (max_models == 0)
+    return;
+
+  ColorModel model;
+  model.bins.resize(hdims);
+  float total = 0.f;
+  for (int i = 0; i < hdims; ++i){
+    model.bins[i] = cvQueryHistValue_1D(hist, i);
+    total += model.bins[i];
+  }
+  if (total <= 0.f)
+    return; // nothing of the object had a usable color
+  model.size = cvSize(track_comp.rect.width, track_comp.rect.height);
+
+  size_t same = models.size();
+  for (size_t m = 0; m < models.size() && same == models.size(); ++m){
+    float shared = 0.f;
+    for (int i = 0; i < hdims; ++i){
+      shared += MIN(models[m].bins[i], model.bins[i]);
+    }
+    if (shared >= 0.9f * total)
+      same = m;
+  }
+  if (same < models.size())
+    models.erase(models.begin() + same);
+  else if ((int)models.size() >= max_models)
+    models.pop_back();
+  models.insert(models.begin(), model);
+}
+
+void Track::reacquire(FrameContext& f){
+  // every remembered model is backprojected at the search resolution
+  // and the window of its object's size with the most of its color is
+  // found with an integral image; the best window over all models, if
+  // it has enough of that color, becomes the CAMSHIFT window
+  CvSize size = scale_size(frame_size, reacquire_scale);
+  if (!search_hue || search_hue->width != size.width || search_hue->height != size.height){
+    ImagePool& pool = ImagePool::shared();
+    pool.release(search_hue);
+    pool.release(search_mask);
+    pool.release(search_backproject);
+    pool.release(search_sum);
+    search_hue = pool.acquire(size, IPL_DEPTH_8U, 1);
+    search_mask = pool.acquire(size, IPL_DEPTH_8U, 1);
+    search_backproject = pool.acquire(size, IPL_DEPTH_8U, 1);
+    search_sum = pool.acquire(cvSize(size.width + 1, size.height + 1), IPL_DEPTH_32S, 1);
+  }
+  search_exclusion.prepare(size);
+
+  // nearest neighbor keeps hues hues, averaging them would invent colors
+  cvResize(f.hue(), search_hue, CV_INTER_NN);
+  cvResize(f.mask(smin, vmin, vmax), search_mask, CV_INTER_NN);
+
+  double best_density = reacquire_density;
+  int best_model = -1;
+  CvRect best_window = cvRect(0, 0, 0, 0);
+  for (size_t m = 0; m < models.size(); ++m){
+    for (int i = 0; i < hdims; ++i){
+      *cvGetHistValue_1D(hist, i) = models[m].bins[i];
+    }
+    cvCalcBackProject(&search_hue, search_backproject, hist);
+    cvAnd(search_backproject, search_mask, search_backproject, 0);
+    search_exclusion.apply(search_backproject);
+    cvIntegral(search_backproject, search_sum);
+
+    // windows of the object's last size, half a window apart
+    int w = MIN(MAX(cvRound(models[m].size.width * reacquire_scale), 2), size.width);
+    int h = MIN(MAX(cvRound(models[m].size.height * reacquire_scale), 2), size.height);
+    int step_x = MAX(w / 2, 1), step_y = MAX(h / 2, 1);
+    double area = 255.0 * w * h;
+    Image<int> sum(search_sum);
+    for (int y = 0; y + h <= size.height; y += step_y){
+      const int* top = sum[y];
+      const int* bottom = sum[y + h];
+      for (int x = 0; x + w <= size.width; x += step_x){
+        double density = (bottom[x + w] - bottom[x] - top[x + w] + top[x]) / area;
+        if (density > best_density){
+          best_density = density;
+          best_model = (int)m;
+          best_window = cvRect(x, y, w, h);
+        }
+      }
+    }
+  }
+
+  if (best_model < 0){
+    // the live model is rebuilt on the next selection anyway, but it
+    // should not be left holding the last one searched for
+    cvClearHist(hist);
+    return;
+  }
+
+  // the model found is the live one again
+  for (int i = 0; i < hdims; ++i){
+    *cvGetHistValue_1D(hist, i) = models[best_model].bins[i];
+  }
+  models.erase(models.begin() + best_model);
+  CvRect window = scale_rect(best_window, 1.0 / reacquire_scale);
+  int x1 = MIN(window.x + window.width, frame_size.width);
+  int y1 = MIN(window.y + window.height, frame_size.height);
+  track_window = cvRect(window.x, window.y, x1 - window.x, y1 - window.y);
+  track_object = true;
+  _reacquired = true;
+}
+
+void Track::save(ostream& out) const{
+  // motion history as the age in ms of each pixel's last motion (0 for
+  // none), so it does not depend on the clock of the stream
+  CvSize size = silh ? frame_size : cvSize(0, 0);
+  put_value(out, size);
+  if (!silh)
+    return;
+
+  vector<unsigned short> ages(size.width);
+  for (int y = 0; y < size.height; ++y){
+    get_ages(y, &ages[0]);
+    out.write(reinterpret_cast<const char*>(&ages[0]), size.width * sizeof(ages[0]));
+  }
+
+  // camshift window and color model
+  put_value(out, track_object);
+  put_value(out, track_window);
+  put_value(out, _track_box);
+  put_value(out, hdims);
+  for (int i = 0; i < hdims; ++i){
+    float bin = cvQueryHistValue_1D(hist, i);
+    put_value(out, bin);
+  }
+}
+
+bool Track::load(istream& in){
+  CvSize size;
+  if (!get_value(in, size))
+    return false;
+  if (size.width <= 0 || size.height <= 0)
+    return true; // nothing had been tracked
+
+  // kept as ages until the next frame says what time it is
+  prepare(size);
+  loaded_ages.resize(size.width * size.height);
+  in.read(reinterpret_cast<char*>(&loaded_ages[0]), loaded_ages.size() * sizeof(loaded_ages[0]));
+  if (!in.good()){
+    loaded_ages.clear();
+    return false;
+  }
+  segs = NULL;
+
+  int bins;
+  if (!get_value(in, track_object) || !get_value(in, track_window) ||
+      !get_value(in, _track_box) || !get_value(in, bins) || bins != hdims)
+    return false;
+  for (int i = 0; i < hdims; ++i){
+    float bin;
+    if (!get_value(in, bin))
+      return false;
+    *cvGetHistValue_1D(hist, i) = bin;
+  }
+
+  return true;
+}
+
+void Track::rebase(double timestamp){
+  // turn loaded ages back into times on the clock of the current stream
+  if (loaded_ages.size() != (size_t)(frame_size.width * frame_size.height)){
+    loaded_ages.clear();
+    return;
+  }
+
+  // motion the mask excludes is not brought back
+  if (exclusion.active()){
+    const IplImage* keep = exclusion.image();
+    for (int y = 0; y < frame_size.height; ++y){
+      const unsigned char* kept = (const unsigned char*)(keep->imageData + y * keep->widthStep);
+      unsigned short* ages = &loaded_ages[y * frame_size.width];
+      for (int x = 0; x < frame_size.width; ++x){
+        if (!kept[x])
+          ages[x] = 0;
+      }
+    }
+  }
+
+  if (mhi){
+    BwImageFloat history(mhi);
+    for (int y = 0; y < frame_size.height; ++y){
+      float* row = history[y];
+      const unsigned short* ages = &loaded_ages[y * frame_size.width];
+      for (int x = 0; x < frame_size.width; ++x){
+        row[x] = ages[x] ? (float)(timestamp - (ages[x] - 1) / 1000.0) : 0.f;
+      }
+    }
+  }
+  else{
+    compact.set_ages(&loaded_ages[0], timestamp, mhi_duration);
+  }
+  loaded_ages.clear();
+}
+
+void Track::get_ages(int y, unsigned short* ages) const{
+  // ms from each pixel's last motion to the last update, plus one; 0 for none
+  if (!mhi){
+    compact.get_ages(y, ages, mhi_duration);
+    return;
+  }
+
+  const float* row = reinterpret_cast<const float*>(mhi->imageData + y * mhi->widthStep);
+  for (int x = 0; x < frame_size.width; ++x){
+    double age = last_time - row[x];
+    if (row[x] > 0.f && age >= 0.0 && age < mhi_duration)
+      ages[x] = (unsigned short)(1 + MIN(cvRound(age * 1000), 65534));
+    else
+      ages[x] = 0;
   }
 }
 
@@ -159,10 +596,17 @@ const CvBox2D& Track::track_box() const{
   return _track_box;
 }
 
-void Track::select_window(CvRect& rect){
-  const CvConnectedComp* comp = largest_segment();
+bool Track::tracking() const{
+  return track_object;
+}
+
+bool Track::reacquired() const{
+  return _reacquired;
+}
+
+void Track::select_window(CvRect& rect, const CvConnectedComp* comp){
   if (comp){
-    CvRect comp_rect = largest_segment()->rect;
+    CvRect comp_rect = comp->rect;
     rect = comp_rect;
   }
   else{
@@ -170,26 +614,10 @@ void Track::select_window(CvRect& rect){
   }
 }
 
-void Track::select_window(CvRect& rect, Flow& flow){
-  cvZero(tmp1);
-  cvZero(tmp2);
-  cvZero(tmp3);
-
-  const CvConnectedComp* comp = largest_segment();
-
+void Track::select_window(CvRect& rect, const CvConnectedComp* comp, Flow& flow){
   if (comp){
-    cvRectangle(tmp1, 
-                cvPoint(comp->rect.x, comp->rect.y),
-                cvPoint(comp->rect.x + comp->rect.width,
-                        comp->rect.y + comp->rect.height),
-                cvScalar(255),
-                CV_FILLED);
-  
-    draw_points(flow.points, flow.point_count(), tmp2, cvScalar(255));
-
-    cvAnd(tmp1, tmp2, tmp3);
-  
-    CvRect pts_bounds = cvBoundingRect(tmp3);
+    // bounds of the feature points inside the segment
+    CvRect pts_bounds = flow.grid().bounds_in_rect(comp->rect);
 
     rect = pts_bounds;
 
@@ -206,27 +634,66 @@ void Track::select_window(CvRect& rect, Flow& flow){
   }
 }                                                    
 
+void Track::clear(){
+  // a new stream, no motion or object of the last one may carry over
+  if (mhi)
+    cvZero(mhi);
+  compact.clear();
+  loaded_ages.clear();
+  last_time = 0.0;
+  segs = NULL;
+  segs_sorted = false;
+  track_object = false;
+  frame = NULL;
+  models.clear();
+  _reacquired = false;
+  _track_box.center = cvPoint2D32f(0, 0);
+  _track_box.size = cvSize2D32f(0, 0);
+  _track_box.angle = 0;
+}
+
 void Track::reset(){
-  select_window(track_window);
+  select_window(track_window, largest_segment());
   init_camshift();
 }
 
 void Track::reset(Flow& flow){
   if (flow.point_count() > 0){
-    select_window(track_window, flow);
+    select_window(track_window, largest_segment(), flow);
   }
   else{
-    select_window(track_window);
+    select_window(track_window, largest_segment());
+  }
+
+  init_camshift();
+}
+
+void Track::reset(const CvConnectedComp& seed){
+  select_window(track_window, &seed);
+  init_camshift();
+}
+
+void Track::reset(const CvConnectedComp& seed, Flow& flow){
+  if (flow.point_count() > 0){
+    select_window(track_window, &seed, flow);
+  }
+  else{
+    select_window(track_window, &seed);
   }
 
   init_camshift();
 }
 
 void Track::init_camshift(){
-  int _vmin = vmin, _vmax = vmax;
-  cvInRangeS(hsv, cvScalar(0,smin,MIN(_vmin, _vmax),0),
-              cvScalar(180,256,MAX(_vmin, _vmax),0), mask);
-  cvSplit(hsv, hue, 0, 0, 0);
+  if (!frame)
+    return; // no frame to take the color model from yet
+
+  // the model being replaced may be wanted again
+  if (track_object)
+    remember_model();
+
+  IplImage* hue = frame->hue();
+  IplImage* mask = frame->mask(smin, vmin, vmax);
   
   float max_val = 0.f;
   cvSetImageROI(hue, track_window);
@@ -237,5 +704,6 @@ void Track::init_camshift(){
   cvResetImageROI(hue);
   cvResetImageROI(mask);
 
+  track_comp.rect = track_window; // until CAMSHIFT moves it
   track_object = true;
 }
@@ -18,6 +18,12 @@
 // includes
 #include "common.h"
 #include "flow.h"
+#include "frame.h"
+#include "history.h"
+#include "mask.h"
+#include "params.h"
+#include "segment.h"
+#include "workers.h"
 #include "cv.h"
 #include "highgui.h"
 #include <iostream>
@@ -30,35 +36,66 @@
 using namespace std;
 
 class Track{
-  static const double MHI_DURATION;
-  static const double MAX_TIME_DELTA;
   static const double MIN_TIME_DELTA;
-  static const int FBSIZE;
 
  public:
   Track();
   ~Track();
   
-  void update(IplImage*); // update the motion segments        
+  void set_history_depth(int depth); // IPL_DEPTH_32F (default), IPL_DEPTH_16U or IPL_DEPTH_8U
+  int history_depth() const;
+  void set_params(const TrackParams&); // a new bin count drops the color model
+  void set_mask(const IplImage*); // static exclusion mask, zero pixels are ignored (not owned)
+  void set_threads(int threads); // segment motion in bands on this many cores, 1 for in one pass
+  void prepare(const CvSize&); // allocate all buffers for this frame size
+  void update(FrameContext&); // update the motion segments and camshift
+  void update_motion_segments(FrameContext&);
+  void update_camshift(FrameContext&);
+  void clear(); // forget the stream so far, buffers and color model settings are kept
   void reset(); // reset to largest segment
   void reset(Flow&);
+  void reset(const CvConnectedComp&); // reset to the given segment
+  void reset(const CvConnectedComp&, Flow&);
+  void save(ostream&) const; // snapshot of the MHI and color model
+  bool load(istream&); // times resume from the next frame
   CvSeq* segments(); // return found motion segments
   const CvConnectedComp* largest_segment();
   const CvBox2D& track_box() const; // return ref to tracked area
+  bool tracking() const; // whether camshift has an object to follow
+  bool reacquired() const; // the last update found a lost object again by a remembered color
 
  private:
+  CvSize frame_size; // size buffers were prepared for
+
   // variables for motion segmentation
-  IplImage **buf;
-  int last;
+  IplImage *silh; // thresholded frame difference
   int diff_threshold;
-  IplImage *mhi;
-  IplImage *segmask; // motion segmentation map
+  double mhi_duration; // seconds motion stays in the history
+  double max_time_delta; // seconds between neighbors of one segment
+  double last_time; // timestamp of the last motion update
+  int _history_depth;
+  IplImage *mhi; // float times, NULL when the compact history is used
+  IplImage *segmask; // motion segmentation map, only written by cvSegmentMotion
+  CompactHistory compact; // integer stamps in place of mhi
+  vector<unsigned short> loaded_ages; // snapshot ages awaiting a timestamp
+  ExclusionMask exclusion; // pixels never differenced, stamped or backprojected
   CvMemStorage* storage; // temp storage
   CvSeq *segs;
   bool segs_sorted;
 
+  // variables for segmenting motion in bands of rows on several cores
+  struct MotionJob{
+    Track* track;
+    IplImage *prev, *curr; // prev is NULL until GRAY_HISTORY frames were seen
+    double timestamp;
+    vector<CvRect> bands;
+  };
+  WorkerPool workers;
+  BandSegmenter band_segmenter;
+
   // variables for camshift
-  IplImage *hsv, *hue, *backproject, *mask, *tmp1, *tmp2, *tmp3;
+  FrameContext *frame; // frame of the last update_camshift()
+  IplImage *backproject;
   CvHistogram *hist;
   CvBox2D _track_box;
   CvConnectedComp track_comp;
@@ -67,12 +104,32 @@ class Track{
   bool track_object;
   CvRect track_window;
 
+  // variables for re-acquisition: the color models of objects followed
+  // before, most recent first, searched for at a low resolution while
+  // nothing is followed
+  struct ColorModel{
+    vector<float> bins;
+    CvSize size; // window the object last had
+  };
+  vector<ColorModel> models;
+  double lost_density, reacquire_density, reacquire_scale;
+  int max_models;
+  bool _reacquired;
+  IplImage *search_hue, *search_mask, *search_backproject, *search_sum;
+  ExclusionMask search_exclusion; // the exclusion mask at the search resolution
+
   // methods
-  void update_motion_segments(IplImage*);
-  void update_camshift(IplImage*);
-  void select_window(CvRect&);
-  void select_window(CvRect&, Flow&);
+  void release_buffers();
+  void prepare_mask(); // scale the mask to the frame size, dropping the history
+  void rebase(double timestamp); // loaded ages to times
+  void get_ages(int row, unsigned short* ages) const;
+  void update_motion_bands(FrameContext&); // update_motion_segments() on the worker pool
+  static void update_band(void* job, int band);
+  void select_window(CvRect&, const CvConnectedComp*);
+  void select_window(CvRect&, const CvConnectedComp*, Flow&);
   void init_camshift();
+  void remember_model(); // the current color model joins the remembered ones
+  void reacquire(FrameContext&); // follow the best remembered model found in the frame
 };
 
 #endif
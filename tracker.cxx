@@ -0,0 +1,749 @@
+/*
+ * tracker.cxx - Implementation of Tracker class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "tracker.h"
+#include "pool.h"
+#include "snapshot.h"
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// constants
+static const int MAX_KEYFRAME_STRETCH = 4;	// adaptive intervals stay below this many base intervals
+static const char CHECKPOINT_MAGIC[8] = {'S', 'A', 'T', 'C', 'K', 'P', 'T', '3'};
+
+static void put_options(ostream& out, const TrackerOptions& o){
+  // field by field, TrackParams by name; the mask and thread count
+  // belong to the process, not to the stream, and are not saved
+  put_value(out, o.flow);
+  put_value(out, o.track);
+  put_value(out, o.points_decide);
+  put_value(out, o.scale);
+  put_value(out, o.flow_scale);
+  put_value(out, o.track_scale);
+  put_value(out, o.history_depth);
+  put_value(out, o.keyframe_interval);
+  put_value(out, o.adaptive_keyframes);
+  put_value(out, o.keyframe_point_loss);
+  put_value(out, o.keyframe_drift);
+  put_value(out, o.seed_from_trajectories);
+  put_value(out, o.idle_gate);
+  put_value(out, o.idle_scale);
+  put_value(out, o.idle_motion);
+  put_value(out, o.idle_after);
+
+  vector<string> names = TrackParams::names();
+  int count = (int)names.size();
+  put_value(out, count);
+  for (int i = 0; i < count; ++i){
+    double value = 0.0;
+    o.params.get(names[i], value);
+    int length = (int)names[i].size();
+    put_value(out, length);
+    out.write(names[i].data(), length);
+    put_value(out, value);
+  }
+}
+
+static bool get_options(istream& in, TrackerOptions& o){
+  // parameters this build does not know are skipped, missing ones keep
+  // their current values
+  if (!get_value(in, o.flow) || !get_value(in, o.track) || !get_value(in, o.points_decide) ||
+      !get_value(in, o.scale) || !get_value(in, o.flow_scale) || !get_value(in, o.track_scale) ||
+      !get_value(in, o.history_depth) || !get_value(in, o.keyframe_interval) ||
+      !get_value(in, o.adaptive_keyframes) || !get_value(in, o.keyframe_point_loss) ||
+      !get_value(in, o.keyframe_drift) || !get_value(in, o.seed_from_trajectories) ||
+      !get_value(in, o.idle_gate) || !get_value(in, o.idle_scale) ||
+      !get_value(in, o.idle_motion) || !get_value(in, o.idle_after))
+    return false;
+
+  int count;
+  if (!get_value(in, count) || count < 0)
+    return false;
+  for (int i = 0; i < count; ++i){
+    int length;
+    double value;
+    if (!get_value(in, length) || length < 0 || length > 256)
+      return false;
+    string name(length, ' ');
+    if ((length > 0 && !in.read(&name[0], length)) || !get_value(in, value))
+      return false;
+    o.params.set(name, value);
+  }
+  return true;
+}
+
+FrameView frame_view(const unsigned char* data, int width, int height, int stride,
+                     PixelFormat format, double timestamp){
+  FrameView view;
+  view.data = data;
+  view.width = width;
+  view.height = height;
+  view.stride = stride;
+  view.format = format;
+  view.bottom_up = false;
+  view.timestamp = timestamp;
+  return view;
+}
+
+FrameView frame_view(const IplImage* img, double timestamp){
+  FrameView view = frame_view((const unsigned char*)img->imageData,
+                              img->width, img->height, img->widthStep,
+                              img->nChannels == 1 ? PIXEL_GRAY8 : PIXEL_BGR8,
+                              timestamp);
+  view.bottom_up = img->origin == IPL_ORIGIN_BL;
+  return view;
+}
+
+TrackerOptions::TrackerOptions(){
+  flow = false;
+  track = false;
+  points_decide = false;
+  scale = flow_scale = track_scale = 1.0;
+  history_depth = IPL_DEPTH_32F;
+  motion_threads = 1;
+  keyframe_interval = 1;
+  adaptive_keyframes = false;
+  keyframe_point_loss = 0.3;
+  keyframe_drift = 0.5;
+  seed_from_trajectories = false;
+  idle_gate = false;
+  idle_scale = 1.0 / 16;
+  idle_motion = 0.002;
+  idle_after = 15;
+  mask = NULL;
+}
+
+KeyframeCounts::KeyframeCounts(){
+  keyframes = 0;
+  forced_by_loss = 0;
+  forced_by_drift = 0;
+}
+
+IdleCounts::IdleCounts(){
+  idle_frames = 0;
+  idle_seconds = 0.0;
+  wakes = 0;
+}
+
+TrackResult::TrackResult(){
+  frame = 0;
+  timestamp = 0.0;
+  tracking = false;
+  reacquired = false;
+  track_box.center = cvPoint2D32f(0, 0);
+  track_box.size = cvSize2D32f(0, 0);
+  track_box.angle = 0;
+  focus_changed = false;
+  idle = false;
+}
+
+// Constructors
+
+Tracker::Tracker(){
+  _stats = &own_stats;
+  need_flow_init = false;
+  need_track_init = false;
+  frames = 0;
+  source_size = cvSize(0, 0);
+  source_channels = 3;
+  image = flow_image = track_image = NULL;
+  mask = NULL;
+  track_context = &flow_frame;
+  gate_frame = gate_gray = gate_reference = gate_diff = NULL;
+  have_reference = false;
+  quiet_frames = 0;
+  _idle = false;
+  last_timestamp = 0.0;
+  init_schedule();
+}
+
+Tracker::Tracker(const TrackerOptions& options_){
+  _stats = &own_stats;
+  need_flow_init = false;
+  need_track_init = false;
+  frames = 0;
+  source_size = cvSize(0, 0);
+  source_channels = 3;
+  image = flow_image = track_image = NULL;
+  mask = NULL;
+  track_context = &flow_frame;
+  gate_frame = gate_gray = gate_reference = gate_diff = NULL;
+  have_reference = false;
+  quiet_frames = 0;
+  _idle = false;
+  last_timestamp = 0.0;
+  init_schedule();
+  set_options(options_);
+}
+
+Tracker::~Tracker(){
+  release_buffers();
+  if (mask)
+    cvReleaseImage(&mask);
+}
+
+// Settings Functions
+
+void Tracker::set_options(const TrackerOptions& options_){
+  TrackerOptions old = _options;
+  _options = options_;
+  if (_options.scale <= 0.0)
+    _options.scale = 1.0;
+  if (_options.flow_scale <= 0.0)
+    _options.flow_scale = 1.0;
+  if (_options.track_scale <= 0.0)
+    _options.track_scale = 1.0;
+
+  if (_options.flow && !old.flow)
+    need_flow_init = true;
+  if (_options.keyframe_interval < 1)
+    _options.keyframe_interval = 1;
+  if (_options.keyframe_interval != old.keyframe_interval ||
+      _options.adaptive_keyframes != old.adaptive_keyframes)
+    init_schedule();
+
+  if (_options.mask != old.mask)
+    copy_mask(_options.mask);
+  flow.set_params(_options.params);
+  track.set_params(_options.params);
+  track.set_threads(_options.motion_threads); // no-op unless the count changed
+  focus.set_params(_options.params);
+  if (_options.params.hdims != old.params.hdims)
+    need_track_init = true; // the color model was dropped
+
+  if (!_options.idle_gate)
+    _idle = false;
+
+  // buffers are sized for the old scales
+  if (_options.scale != old.scale || _options.flow_scale != old.flow_scale ||
+      _options.track_scale != old.track_scale || _options.history_depth != old.history_depth ||
+      _options.idle_scale != old.idle_scale){
+    release_buffers();
+    source_size = cvSize(0, 0);
+  }
+}
+
+const TrackerOptions& Tracker::options() const{
+  return _options;
+}
+
+void Tracker::set_stats(Stats* stats_){
+  _stats = stats_ ? stats_ : &own_stats;
+}
+
+const Stats& Tracker::stats() const{
+  return *_stats;
+}
+
+const KeyframeCounts& Tracker::keyframes() const{
+  return key_counts;
+}
+
+const IdleCounts& Tracker::idle_counts() const{
+  return idle_stats;
+}
+
+void Tracker::set_flow(bool on){
+  if (on)
+    need_flow_init = true;
+  _options.flow = on;
+}
+
+void Tracker::set_track(bool on){
+  _options.track = on;
+}
+
+void Tracker::set_points_decide(bool on){
+  _options.points_decide = on;
+}
+
+void Tracker::reset(){
+  need_track_init = true;
+}
+
+void Tracker::restart(){
+  // everything learned from the last stream goes, the buffers stay for
+  // the next one and are only replaced if its frames differ in size
+  flow.clear();
+  track.clear();
+  focus.clear();
+  flow_frame.clear();
+  track_frame.clear();
+  need_flow_init = _options.flow;
+  need_track_init = false;
+  frames = 0;
+  init_schedule();
+  key_counts = KeyframeCounts();
+  have_reference = false;
+  quiet_frames = 0;
+  _idle = false;
+  last_timestamp = 0.0;
+  idle_stats = IdleCounts();
+}
+
+bool Tracker::command(char key){
+  switch (key){
+    case 'f':
+      set_flow(!_options.flow);
+      return true;
+    case 't':
+      set_track(!_options.track);
+      return true;
+    case 'r':
+      reset();
+      return true;
+    case 'p':
+      set_points_decide(!_options.points_decide);
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Access Functions
+
+long Tracker::frame_count() const{
+  return frames;
+}
+
+bool Tracker::idle() const{
+  return _idle;
+}
+
+// Action Functions
+
+void Tracker::prepare(const CvSize& size){
+  // allocate every working buffer before the first frame arrives
+  if (source_size.width == size.width && source_size.height == size.height)
+    return;
+
+  release_buffers();
+  ImagePool& pool = ImagePool::shared();
+  CvSize proc_size = scale_size(size, _options.scale);
+  CvSize flow_size = scale_size(proc_size, _options.flow_scale);
+  CvSize track_size = scale_size(proc_size, _options.track_scale);
+
+  source_size = size;
+  if (_options.scale != 1.0)
+    image = pool.acquire(proc_size, IPL_DEPTH_8U, source_channels);
+  if (_options.flow_scale != 1.0)
+    flow_image = pool.acquire(flow_size, IPL_DEPTH_8U, source_channels);
+  flow_frame.prepare(flow_size);
+
+  // tracking shares the flow frame when both work at the same scale
+  if (_options.track_scale == _options.flow_scale){
+    track_context = &flow_frame;
+  }
+  else{
+    if (_options.track_scale != 1.0)
+      track_image = pool.acquire(track_size, IPL_DEPTH_8U, source_channels);
+    track_frame.prepare(track_size);
+    track_context = &track_frame;
+  }
+
+  // flow points are indexed in track coordinates for Track and Focus
+  flow.set_grid_scale(_options.track_scale / _options.flow_scale);
+  flow.prepare(flow_size);
+  track.set_history_depth(_options.history_depth);
+  track.prepare(track_size);
+  focus.prepare(track_size);
+}
+
+void Tracker::release_buffers(){
+  ImagePool& pool = ImagePool::shared();
+  pool.release(image);
+  pool.release(flow_image);
+  pool.release(track_image);
+  pool.release(gate_frame);
+  pool.release(gate_gray);
+  pool.release(gate_reference);
+  pool.release(gate_diff);
+  have_reference = false;
+}
+
+void Tracker::copy_mask(const IplImage* mask_){
+  // components scale the copy to the size they work at
+  if (mask)
+    cvReleaseImage(&mask);
+  if (mask_){
+    mask = cvCreateImage(cvGetSize(mask_), IPL_DEPTH_8U, 1);
+    if (mask_->nChannels == 1)
+      cvCopy(mask_, mask);
+    else
+      cvCvtColor(mask_, mask, CV_BGR2GRAY);
+  }
+
+  flow.set_mask(mask);
+  track.set_mask(mask);
+  gate_mask.set_source(mask);
+}
+
+IplImage* Tracker::scaled(IplImage* src, IplImage* dst){
+  if (!dst)
+    return src;
+
+  cvResize(src, dst, CV_INTER_AREA);
+  dst->origin = src->origin;
+  return dst;
+}
+
+TrackResult Tracker::process(const FrameView& frame){
+  TrackResult result;
+  process(frame, result);
+  return result;
+}
+
+bool Tracker::process(const FrameView& frame, TrackResult& result){
+  // run all enabled components on one frame
+  int channels = frame.format == PIXEL_GRAY8 ? 1 : 3;
+  if (!frame.data || frame.width <= 0 || frame.height <= 0 ||
+      frame.stride < frame.width * channels)
+    return false;
+
+  CvSize size = cvSize(frame.width, frame.height);
+  if (channels != source_channels){
+    source_channels = channels;
+    source_size = cvSize(0, 0);
+  }
+  prepare(size); // no-op unless the frame size changed
+
+  // wrap the caller's pixels, they are only copied when resized
+  cvInitImageHeader(&view, size, IPL_DEPTH_8U, channels,
+                    frame.bottom_up ? IPL_ORIGIN_BL : IPL_ORIGIN_TL, 4);
+  cvSetData(&view, (void*)frame.data, frame.stride);
+
+  // a quiet scene costs nothing but the gate
+  if (_options.idle_gate){
+    _stats->begin(STAGE_GATE);
+    bool wanted = gate(&view, frame.timestamp);
+    _stats->end(STAGE_GATE);
+    if (!wanted){
+      if (_options.flow)
+        _stats->skip(STAGE_FLOW);
+      if (_options.track){
+        _stats->skip(STAGE_SEGMENT);
+        if (channels == 3){
+          _stats->skip(STAGE_CAMSHIFT);
+          _stats->skip(STAGE_FOCUS);
+        }
+      }
+      ++frames;
+      fill_result(result, frame.timestamp, false);
+      return true;
+    }
+  }
+
+  _stats->begin(STAGE_CONVERT);
+
+  bool shared = track_context == &flow_frame;
+  bool want_flow = _options.flow || need_flow_init;
+  IplImage* proc = scaled(&view, image);
+  if (want_flow || (_options.track && shared))
+    flow_frame.set_frame(scaled(proc, flow_image), frame.timestamp);
+  if (_options.track && !shared)
+    track_frame.set_frame(scaled(proc, track_image), frame.timestamp);
+  _stats->end(STAGE_CONVERT);
+
+  // perform operations
+  if (need_flow_init){
+    _stats->begin(STAGE_FLOW);
+    flow.init(flow_frame);
+    need_flow_init = false;
+    _stats->end(STAGE_FLOW);
+  }
+  else if (_options.flow && flow.point_count() > 0){
+    // update pairs with flow information
+    _stats->begin(STAGE_FLOW);
+    flow.pair_flow(flow_frame);
+    _stats->end(STAGE_FLOW);
+  }
+
+  bool changed = false;
+  if (_options.track){
+    // track largest moving object, segments are refreshed on keyframes
+    bool keyframe = keyframe_due();
+    if (keyframe){
+      _stats->begin(STAGE_SEGMENT);
+      track.update_motion_segments(*track_context);
+      _stats->end(STAGE_SEGMENT);
+    }
+    else{
+      _stats->skip(STAGE_SEGMENT);
+    }
+
+    // CAMSHIFT follows color, gray frames only get motion segments
+    if (channels == 3){
+      _stats->begin(STAGE_CAMSHIFT);
+      track.update_camshift(*track_context);
+      if (need_track_init){
+        CvConnectedComp seed;
+        if (seed_window(seed))
+          track.reset(seed);
+        else
+          track.reset(flow);
+        need_track_init = false;
+      }
+      _stats->end(STAGE_CAMSHIFT);
+
+      if (keyframe){
+        _stats->begin(STAGE_FOCUS);
+        focus.update(&track.track_box(),
+                     track.segments(),
+                     flow.grid(),
+                     *track_context,
+                     _options.points_decide,
+                     changed);
+
+        CvConnectedComp seed;
+        if (changed && seed_window(seed, &focus.focus_area().rect)){
+          track.reset(seed);
+        }
+        else if (changed){
+          int intersect_count = focus.intersect_count(&track.track_box(),
+                                                      flow.grid());
+          if (intersect_count > 0){
+            track.reset(focus.focus_area(), flow);
+          }
+          else{
+            track.reset(focus.focus_area());
+          }
+        }
+        _stats->end(STAGE_FOCUS);
+      }
+      else{
+        _stats->skip(STAGE_FOCUS);
+      }
+    }
+
+    schedule(keyframe, changed);
+  }
+
+  ++frames;
+  fill_result(result, frame.timestamp, changed);
+  return true;
+}
+
+bool Tracker::gate(IplImage* frame, double timestamp){
+  // sample the frame at the gate resolution and compare it with the last
+  // processed one, so slow changes add up until they wake the pipeline
+  if (!gate_frame){
+    ImagePool& pool = ImagePool::shared();
+    CvSize size = scale_size(cvGetSize(frame), _options.idle_scale);
+    gate_frame = pool.acquire(size, IPL_DEPTH_8U, frame->nChannels);
+    gate_gray = pool.acquire(size, IPL_DEPTH_8U, 1);
+    gate_reference = pool.acquire(size, IPL_DEPTH_8U, 1);
+    gate_diff = pool.acquire(size, IPL_DEPTH_8U, 1);
+    have_reference = false;
+  }
+  gate_mask.prepare(cvGetSize(gate_diff));
+
+  cvResize(frame, gate_frame, CV_INTER_NN); // reads only the sampled pixels
+  if (gate_frame->nChannels == 3)
+    cvCvtColor(gate_frame, gate_gray, CV_BGR2GRAY);
+  else
+    cvCopy(gate_frame, gate_gray);
+
+  bool moved = true;
+  if (have_reference){
+    cvAbsDiff(gate_gray, gate_reference, gate_diff);
+    cvThreshold(gate_diff, gate_diff, _options.params.diff_threshold, 255, CV_THRESH_BINARY);
+    gate_mask.apply(gate_diff);
+    moved = cvCountNonZero(gate_diff) > _options.idle_motion * gate_diff->width * gate_diff->height;
+  }
+
+  if (!moved && quiet_frames >= _options.idle_after){
+    _idle = true;
+    ++idle_stats.idle_frames;
+    idle_stats.idle_seconds += timestamp - last_timestamp;
+    last_timestamp = timestamp;
+    return false;
+  }
+
+  // motion wakes everything on this very frame, starting with a keyframe
+  if (_idle){
+    _idle = false;
+    ++idle_stats.wakes;
+    force_key = true;
+  }
+
+  IplImage* swap_gray;
+  CV_SWAP(gate_gray, gate_reference, swap_gray);
+  have_reference = true;
+  quiet_frames = moved ? 0 : quiet_frames + 1;
+  last_timestamp = timestamp;
+  return true;
+}
+
+bool Tracker::seed_window(CvConnectedComp& seed, const CvRect* near){
+  // the points' own motion finds the object without touching the frame
+  if (!_options.seed_from_trajectories || !_options.flow)
+    return false;
+
+  CvRect window;
+  if (!flow.motion_window(window, near))
+    return false;
+
+  memset(&seed, 0, sizeof(seed));
+  seed.rect = window;
+  seed.area = window.width * window.height;
+  return true;
+}
+
+bool Tracker::keyframe_due() const{
+  // keyframes are also taken while nothing is followed, so a target is
+  // found as soon as it moves
+  return since_key + 1 >= key_interval || force_key || need_track_init ||
+         !track.tracking();
+}
+
+void Tracker::schedule(bool keyframe, bool focus_changed){
+  int base = _options.keyframe_interval;
+  if (keyframe){
+    ++key_counts.keyframes;
+    since_key = 0;
+    force_key = false;
+    key_points = flow.point_count();
+    key_box = track.track_box();
+    if (_options.adaptive_keyframes)
+      key_interval = focus_changed ? base : MIN(key_interval * 2, base * MAX_KEYFRAME_STRETCH);
+  }
+  else{
+    ++since_key;
+
+    // bring the next keyframe forward when flow or CAMSHIFT lose their grip
+    if (_options.flow && key_points > 0 &&
+        flow.point_count() < key_points * (1.0 - _options.keyframe_point_loss)){
+      force_key = true;
+      ++key_counts.forced_by_loss;
+    }
+    else if (track.tracking()){
+      const CvBox2D& box = track.track_box();
+      double dx = box.center.x - key_box.center.x;
+      double dy = box.center.y - key_box.center.y;
+      double size = MAX(key_box.size.width, key_box.size.height);
+      if (size > 0.0 && sqrt(dx * dx + dy * dy) > size * _options.keyframe_drift){
+        force_key = true;
+        ++key_counts.forced_by_drift;
+      }
+    }
+    if (force_key)
+      key_interval = base;
+  }
+
+  // keyframes difference against the gray image GRAY_HISTORY frames
+  // back, and a forced one can come on any frame, so every frame keeps
+  // its gray; converting costs little next to segmenting
+  if (base > 1)
+    track_context->gray();
+}
+
+void Tracker::init_schedule(){
+  key_interval = _options.keyframe_interval;
+  since_key = 0;
+  force_key = true;
+  key_points = 0;
+  key_box.center = cvPoint2D32f(0, 0);
+  key_box.size = cvSize2D32f(0, 0);
+  key_box.angle = 0;
+}
+
+void Tracker::fill_result(TrackResult& result, double timestamp, bool focus_changed){
+  // map everything back to the coordinates of the frame passed in
+  double from_flow = 1.0 / (_options.scale * _options.flow_scale);
+  double from_track = 1.0 / (_options.scale * _options.track_scale);
+
+  result.frame = frames;
+  result.timestamp = timestamp;
+  result.tracking = _options.track && track.tracking();
+  result.reacquired = result.tracking && !_idle && track.reacquired();
+  result.track_box = scale_box(track.track_box(), from_track);
+  result.focus_changed = focus_changed;
+  result.idle = _idle;
+
+  // segments are motion of the last processed frame, there is none while idle
+  result.segments.clear();
+  CvSeq* segs = _options.track && !_idle ? track.segments() : NULL;
+  if (segs && segs->total > 0){
+    track.largest_segment(); // sorts the segments
+    for (int i = 0; i < segs->total; ++i){
+      CvConnectedComp* comp = reinterpret_cast<CvConnectedComp*>(cvGetSeqElem(segs, i));
+      result.segments.push_back(scale_rect(comp->rect, from_track));
+    }
+  }
+
+  result.points.clear();
+  if (_options.flow){
+    int num_points = flow.point_count();
+    for (int i = 0; i < num_points; ++i){
+      result.points.push_back(scale_point(flow.points[i], from_flow));
+    }
+  }
+}
+
+bool Tracker::save_checkpoint(const string& file) const{
+  // written aside and renamed, so a crash never leaves half a checkpoint
+  string temp = file + ".tmp";
+  {
+    ofstream out(temp.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out)
+      return false;
+
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    put_value(out, frames);
+    put_options(out, _options);
+    put_value(out, source_size);
+    put_value(out, source_channels);
+    flow.save(out);
+    track.save(out);
+    focus.save(out);
+    flow_frame.save(out);
+    if (track_context != &flow_frame)
+      track_frame.save(out);
+    if (!out.good())
+      return false;
+  }
+
+  return rename(temp.c_str(), file.c_str()) == 0;
+}
+
+bool Tracker::load_checkpoint(const string& file){
+  ifstream in(file.c_str(), ios::in | ios::binary);
+  char magic[sizeof(CHECKPOINT_MAGIC)];
+  if (!in.read(magic, sizeof(magic)) ||
+      memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0)
+    return false;
+
+  long saved_frames;
+  TrackerOptions saved_options = _options; // keeps this process's mask and threads
+  CvSize size;
+  int channels;
+  if (!get_value(in, saved_frames) || !get_options(in, saved_options) ||
+      !get_value(in, size) || !get_value(in, channels))
+    return false;
+
+  // buffers for the saved size and scales, then the state to put in them
+  set_options(saved_options);
+  if (size.width > 0 && size.height > 0){
+    source_channels = channels;
+    source_size = cvSize(0, 0);
+    prepare(size);
+  }
+  if (!flow.load(in) || !track.load(in) || !focus.load(in) || !flow_frame.load(in))
+    return false;
+  if (track_context != &flow_frame && !track_frame.load(in))
+    return false;
+
+  frames = saved_frames;
+  need_flow_init = _options.flow && flow.point_count() == 0;
+  need_track_init = false;
+  return true;
+}
@@ -0,0 +1,221 @@
+/*
+ * tracker.h - Embeddable per-frame tracking (libsatori)
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _TRACKER_H_
+#define _TRACKER_H_
+
+// includes
+#include "common.h"
+#include "flow.h"
+#include "track.h"
+#include "focus.h"
+#include "frame.h"
+#include "params.h"
+#include "mask.h"
+#include "stats.h"
+#include "cv.h"
+#include <string>
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+// types
+enum PixelFormat{
+  PIXEL_BGR8, // 3 interleaved bytes per pixel, blue first
+  PIXEL_GRAY8 // 1 byte per pixel, tracks motion only
+};
+
+struct FrameView{
+  /* Caller owned pixels, read in place for the length of one process()
+     call. */
+  const unsigned char* data;
+  int width, height;
+  int stride; // bytes from one row to the next
+  PixelFormat format;
+  bool bottom_up; // first row in memory is the bottom of the image
+  double timestamp; // seconds, increasing
+};
+
+FrameView frame_view(const unsigned char* data, int width, int height, int stride,
+                     PixelFormat format, double timestamp);
+FrameView frame_view(const IplImage*, double timestamp); // 8 bit, 1 or 3 channels
+
+struct TrackerOptions{
+  TrackerOptions();
+
+  bool flow; // track feature points with optical flow
+  bool track; // segment motion and follow an object with CAMSHIFT
+  bool points_decide; // use feature point density for focus changes
+  double scale; // processing resolution as a fraction of the frame
+  double flow_scale, track_scale; // further fractions for flow and tracking
+  int history_depth; // motion history: IPL_DEPTH_32F, or compact IPL_DEPTH_16U/8U
+  int motion_threads; // cores motion segmentation is split over, in bands of rows
+
+  // segmentation and focus run on keyframes only, CAMSHIFT and flow on
+  // every frame
+  int keyframe_interval; // frames from one keyframe to the next, 1 for every frame
+  bool adaptive_keyframes; // stretch the interval while focus holds still
+  double keyframe_point_loss; // fraction of points lost that forces a keyframe
+  double keyframe_drift; // box movement, in box sizes, that forces a keyframe
+
+  // seed CAMSHIFT from the largest group of feature points moving
+  // together, when there is one, instead of the largest motion segment
+  bool seed_from_trajectories;
+
+  // idle mode: while a heavily downsampled difference against the last
+  // processed frame stays quiet, nothing else runs
+  bool idle_gate;
+  double idle_scale; // gate resolution as a fraction of the frame
+  double idle_motion; // fraction of gate pixels that must change to wake
+  int idle_after; // quiet frames before going idle
+
+  TrackParams params; // thresholds and sizes used by the components
+
+  // static exclusion mask of the stream, any size, zero pixels are never
+  // differenced, stamped, backprojected or searched for corners; copied
+  // by set_options() whenever the pointer changes, NULL for none
+  const IplImage* mask;
+};
+
+struct KeyframeCounts{
+  KeyframeCounts();
+
+  long keyframes; // frames segmentation and focus ran on
+  long forced_by_loss; // keyframes brought forward by lost points
+  long forced_by_drift; // keyframes brought forward by box movement
+};
+
+struct IdleCounts{
+  IdleCounts();
+
+  long idle_frames; // frames only the gate looked at
+  double idle_seconds; // stream time spent idle
+  long wakes; // times motion ended an idle stretch
+};
+
+struct TrackResult{
+  /* Everything found in one frame, in the coordinates of the frame that
+     was passed in. */
+  TrackResult();
+
+  long frame; // frames processed so far, this one included
+  double timestamp;
+  bool tracking; // CAMSHIFT is following an object
+  bool reacquired; // a lost object was found again by its color this frame
+  CvBox2D track_box; // the object followed
+  bool focus_changed; // tracking moved to a new motion segment this frame
+  bool idle; // nothing moved, only the idle gate ran
+  vector<CvRect> segments; // motion segments, largest first
+  vector<CvPoint2D32f> points; // feature points followed by flow
+};
+
+class Tracker{
+  /* One stream's worth of tracking state.  Trackers share nothing but the
+     image pool, so each stream (or thread) can have its own.  Frames are
+     never copied when they are processed at their own resolution.
+  */
+ public:
+  // Constructors
+  Tracker();
+  Tracker(const TrackerOptions&);
+  ~Tracker();
+
+  // Settings Functions
+  void set_options(const TrackerOptions&); // scale changes take effect on the next frame
+  const TrackerOptions& options() const;
+  void set_stats(Stats*); // record stage timings here instead (not owned)
+  const Stats& stats() const;
+  const KeyframeCounts& keyframes() const;
+  const IdleCounts& idle_counts() const;
+
+  // Action Functions
+  void prepare(const CvSize&); // allocate everything for frames of this size
+  TrackResult process(const FrameView&);
+  bool process(const FrameView&, TrackResult&); // false for unusable frames
+  void set_flow(bool); // features are found on the next frame when turned on
+  void set_track(bool);
+  void set_points_decide(bool);
+  void reset(); // follow the largest motion segment from the next frame on
+  void restart(); // begin a new stream with the same options, keeping every buffer
+  bool command(char key); // live command key (f, t, r, p), false for any other
+  bool save_checkpoint(const string& file) const; // state after the last frame
+  bool load_checkpoint(const string& file); // continue from a saved state
+
+  // Access Functions
+  long frame_count() const; // frames processed, counting checkpointed ones
+  bool idle() const; // the last frame was skipped by the idle gate
+
+ private:
+  TrackerOptions _options;
+  Stats own_stats;
+  Stats* _stats;
+  bool need_flow_init;
+  bool need_track_init;
+  long frames;
+
+  // Keyframe schedule
+  int key_interval; // current interval, stretched when adaptive
+  int since_key; // frames since the last keyframe
+  bool force_key; // next frame is a keyframe whatever the interval
+  int key_points; // flow points at the last keyframe
+  CvBox2D key_box; // track box at the last keyframe
+  KeyframeCounts key_counts;
+
+  // Idle gate
+  IplImage *gate_frame; // frame at the gate resolution, source channels
+  IplImage *gate_gray, *gate_reference; // this frame and the last processed one
+  IplImage *gate_diff;
+  ExclusionMask gate_mask; // the exclusion mask at the gate resolution
+  bool have_reference;
+  int quiet_frames; // processed frames in a row the gate found quiet
+  bool _idle;
+  double last_timestamp;
+  IdleCounts idle_stats;
+
+  // Components
+  Flow flow;
+  Track track;
+  Focus focus;
+
+  // Images
+  CvSize source_size; // frame size buffers were prepared for
+  int source_channels;
+  IplImage view; // header over the caller's pixels
+  IplImage *image; // frame at the processing scale, NULL at 1.0
+  IplImage *flow_image, *track_image; // frame at the flow/track scale, NULL when not needed
+  IplImage *mask; // 8 bit copy of the exclusion mask, NULL for none
+
+  // Frames with derived images, shared by the components
+  FrameContext flow_frame;
+  FrameContext track_frame; // unused when track and flow scales match
+  FrameContext *track_context; // track_frame or flow_frame
+
+  // methods
+  void release_buffers();
+  void copy_mask(const IplImage*);
+  IplImage* scaled(IplImage* src, IplImage* dst); // dst resized from src, or src
+  void fill_result(TrackResult&, double timestamp, bool focus_changed);
+  bool keyframe_due() const;
+  bool seed_window(CvConnectedComp& seed, const CvRect* near = NULL); // from point trajectories
+  void schedule(bool keyframe, bool focus_changed); // after each tracked frame
+  void init_schedule();
+  bool gate(IplImage* frame, double timestamp); // false when the frame can be skipped
+
+  // not copyable
+  Tracker(const Tracker&);
+  Tracker& operator=(const Tracker&);
+};
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * trackindex.cxx - Implementation of TrackIndex class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "trackindex.h"
+#include "snapshot.h"	// put_value, get_value
+#include <stdio.h>
+#include <string.h>
+
+// constants
+static const char INDEX_MAGIC[8] = {'S', 'A', 'T', 'I', 'D', 'X', '0', '1'};
+static const int GRID_CELLS = 8;	// grid is GRID_CELLS x GRID_CELLS over the frame
+static const streamoff HEADER_BYTES = sizeof(INDEX_MAGIC) + 2 * sizeof(int32_t) + sizeof(double);
+
+static bool rects_touch(const CvRect& a, const CvRect& b){
+  return a.x < b.x + b.width && b.x < a.x + a.width &&
+         a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+// Constructors
+
+TrackIndex::TrackIndex(double partition_seconds_){
+  partition_seconds = partition_seconds_ > 0.0 ? partition_seconds_ : 10.0;
+  _frame_size = cvSize(0, 0);
+  have_open = false;
+  _entries = 0;
+  time_offset = 0.0;
+}
+
+TrackIndex::~TrackIndex(){
+  close();
+}
+
+// Action Functions
+
+bool TrackIndex::open(const string& path_, const CvSize& size){
+  close();
+
+  // start a new index unless one is there to continue
+  ifstream existing(path_.c_str(), ios::in | ios::binary);
+  if (!existing){
+    ofstream out(path_.c_str(), ios::out | ios::binary | ios::trunc);
+    int32_t width = size.width, height = size.height;
+    out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    put_value(out, width);
+    put_value(out, height);
+    put_value(out, partition_seconds);
+    if (!out.good())
+      return false;
+    out.close();
+    remove((path_ + ".parts").c_str()); // left over from an index that is gone
+  }
+  existing.close();
+
+  if (!open(path_))
+    return false;
+  if (_frame_size.width != size.width || _frame_size.height != size.height){
+    close();
+    return false;
+  }
+
+  // rewrite the summaries, including any rebuilt by the scan
+  parts_out.open((path_ + ".parts").c_str(), ios::out | ios::binary | ios::trunc);
+  size_t closed = parts.size() - (have_open ? 1 : 0);
+  for (size_t i = 0; i < closed; ++i){
+    put_value(parts_out, parts[i]);
+  }
+  parts_out.flush();
+  return parts_out.good();
+}
+
+bool TrackIndex::open(const string& path_){
+  close();
+
+  data.open(path_.c_str(), ios::in | ios::out | ios::binary);
+  if (!data)
+    return false;
+
+  char magic[sizeof(INDEX_MAGIC)];
+  int32_t width, height;
+  data.read(magic, sizeof(magic));
+  if (!data.good() || memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 ||
+      !get_value(data, width) || !get_value(data, height) ||
+      !get_value(data, partition_seconds) || partition_seconds <= 0.0){
+    data.close();
+    return false;
+  }
+  path = path_;
+  _frame_size = cvSize(width, height);
+
+  // whole entries only, a torn last write is overwritten by the next one
+  data.seekg(0, ios::end);
+  streamoff bytes = (streamoff)data.tellg() - HEADER_BYTES;
+  _entries = bytes > 0 ? bytes / (streamoff)sizeof(IndexEntry) : 0;
+
+  read_parts(path + ".parts");
+  return scan_tail();
+}
+
+void TrackIndex::close(){
+  if (have_open)
+    close_partition();
+  if (data.is_open())
+    data.close();
+  if (parts_out.is_open())
+    parts_out.close();
+  data.clear();
+  parts_out.clear();
+
+  parts.clear();
+  have_open = false;
+  _entries = 0;
+  time_offset = 0.0;
+  _frame_size = cvSize(0, 0);
+}
+
+bool TrackIndex::is_open() const{
+  return data.is_open();
+}
+
+bool TrackIndex::read_parts(const string& parts_path){
+  // keep summaries only as long as they agree with the entries on disk
+  ifstream in(parts_path.c_str(), ios::in | ios::binary);
+  if (!in)
+    return false;
+
+  int64_t next = 0;
+  Partition p;
+  while (get_value(in, p)){
+    if (p.first != next || p.count <= 0 || p.first + p.count > _entries)
+      break;
+    parts.push_back(p);
+    next = p.first + p.count;
+  }
+  return true;
+}
+
+bool TrackIndex::scan_tail(){
+  // rebuild partitions for entries written after the last summary
+  int64_t start = parts.empty() ? 0 : parts.back().first + parts.back().count;
+  int64_t total = _entries;
+  data.clear();
+  data.seekg(HEADER_BYTES + start * (streamoff)sizeof(IndexEntry));
+
+  IndexEntry e;
+  for (int64_t i = start; i < total; ++i){
+    if (!get_value(data, e))
+      return false;
+    _entries = i;
+    add_to_partition(e);
+  }
+  _entries = total;
+  data.clear();
+  return true;
+}
+
+void TrackIndex::append(const TrackResult& result){
+  IndexEntry e;
+  e.timestamp = result.timestamp;
+  e.frame = (int32_t)result.frame;
+
+  if (result.tracking){
+    e.kind = ENTRY_TRACK;
+    e.rect = box_rect(result.track_box);
+    append(e);
+  }
+  e.kind = ENTRY_SEGMENT;
+  for (size_t i = 0; i < result.segments.size(); ++i){
+    e.rect = result.segments[i];
+    append(e);
+  }
+}
+
+void TrackIndex::append(const IndexEntry& entry){
+  if (!data.is_open())
+    return;
+
+  // a timestamp going back is a new run, continuing from the last entry
+  IndexEntry e = entry;
+  e.timestamp += time_offset;
+  bool new_run = false;
+  if (!parts.empty() && e.timestamp < parts.back().last_time){
+    time_offset += parts.back().last_time - e.timestamp;
+    e.timestamp = parts.back().last_time;
+    new_run = true;
+  }
+
+  add_to_partition(e, new_run);
+  data.clear();
+  data.seekp(HEADER_BYTES + _entries * (streamoff)sizeof(IndexEntry));
+  put_value(data, e);
+  ++_entries;
+}
+
+void TrackIndex::add_to_partition(const IndexEntry& e, bool new_run){
+  // entry number _entries goes to the open partition, or starts one
+  if (!have_open || new_run || e.timestamp < parts.back().last_time ||
+      e.timestamp >= parts.back().first_time + partition_seconds){
+    if (have_open)
+      close_partition();
+
+    Partition p;
+    p.first_time = p.last_time = e.timestamp;
+    p.cells = 0;
+    p.first = _entries;
+    p.count = 0;
+    parts.push_back(p);
+    have_open = true;
+  }
+
+  Partition& p = parts.back();
+  p.last_time = MAX(p.last_time, e.timestamp);
+  p.cells |= cells_of(e.rect);
+  ++p.count;
+}
+
+void TrackIndex::close_partition(){
+  if (parts_out.is_open()){
+    put_value(parts_out, parts.back());
+    parts_out.flush();
+  }
+  have_open = false;
+}
+
+uint64_t TrackIndex::cells_of(const CvRect& rect) const{
+  int w = MAX(_frame_size.width, 1), h = MAX(_frame_size.height, 1);
+  int x0 = rect.x * GRID_CELLS / w;
+  int x1 = (rect.x + MAX(rect.width, 1) - 1) * GRID_CELLS / w;
+  int y0 = rect.y * GRID_CELLS / h;
+  int y1 = (rect.y + MAX(rect.height, 1) - 1) * GRID_CELLS / h;
+  x0 = MIN(MAX(x0, 0), GRID_CELLS - 1);
+  x1 = MIN(MAX(x1, 0), GRID_CELLS - 1);
+  y0 = MIN(MAX(y0, 0), GRID_CELLS - 1);
+  y1 = MIN(MAX(y1, 0), GRID_CELLS - 1);
+
+  uint64_t cells = 0;
+  for (int y = y0; y <= y1; ++y){
+    for (int x = x0; x <= x1; ++x){
+      cells |= (uint64_t)1 << (y * GRID_CELLS + x);
+    }
+  }
+  return cells;
+}
+
+int TrackIndex::query(const CvRect& region_, double from, double to,
+                      vector<IndexEntry>& hits, int kinds){
+  if (!data.is_open())
+    return 0;
+
+  CvRect region = region_;
+  region.width = MAX(region.width, 1);
+  region.height = MAX(region.height, 1);
+  uint64_t cells = cells_of(region);
+  int found = 0;
+
+  data.flush(); // entries of the open partition may still be buffered
+  for (size_t i = 0; i < parts.size(); ++i){
+    const Partition& p = parts[i];
+    if (p.first_time > to || p.last_time < from || !(p.cells & cells))
+      continue; // indexes from before runs were shifted may be out of order
+
+    // read the partition's entries in one go
+    block.resize(p.count);
+    data.clear();
+    data.seekg(HEADER_BYTES + p.first * (streamoff)sizeof(IndexEntry));
+    data.read(reinterpret_cast<char*>(&block[0]), p.count * sizeof(IndexEntry));
+    if (!data.good())
+      break;
+
+    for (int64_t j = 0; j < p.count; ++j){
+      const IndexEntry& e = block[j];
+      if ((e.kind & kinds) && e.timestamp >= from && e.timestamp <= to &&
+          rects_touch(e.rect, region)){
+        hits.push_back(e);
+        ++found;
+      }
+    }
+  }
+  data.clear();
+
+  return found;
+}
+
+// Access Functions
+
+long TrackIndex::entries() const{
+  return (long)_entries;
+}
+
+int TrackIndex::partitions() const{
+  return (int)parts.size();
+}
+
+const CvSize& TrackIndex::frame_size() const{
+  return _frame_size;
+}
@@ -0,0 +1,120 @@
+/*
+ * trackindex.h - Persistent index over the history of tracked motion
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifdef _CH_
+#pragma package <opencv>
+#endif
+
+#ifndef _TRACKINDEX_H_
+#define _TRACKINDEX_H_
+
+// includes
+#include "tracker.h"
+#include "cv.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// namespace preparation
+using namespace std;
+
+// types
+enum EntryKind{
+  ENTRY_TRACK = 1, // the box CAMSHIFT followed
+  ENTRY_SEGMENT = 2, // a motion segment
+  ENTRY_ANY = ENTRY_TRACK | ENTRY_SEGMENT
+};
+
+struct IndexEntry{
+  double timestamp;
+  int32_t frame;
+  int32_t kind; // EntryKind
+  CvRect rect; // upright bounds, frame coordinates
+};
+
+class TrackIndex{
+  /* An append-only store of every track box and motion segment, with a
+     time-partitioned grid over it so "when was there motion here"
+     needs no reprocessing.
+
+     Entries are written to the file as they come, in time order.  Time
+     is cut into partitions of a fixed length; each remembers where its
+     entries start in the file, its time span, and which cells of an
+     8x8 grid over the frame its entries touch.  A query reads only the
+     partitions that overlap its time range and whose cells overlap its
+     region, so days of history cost a scan of a few hundred bytes per
+     partition plus the entries actually near the answer.
+
+     Partition summaries go to a second file (path + ".parts") as each
+     partition closes.  On open, the summaries are read back and only
+     the entries after the last good one are scanned, so a crash costs
+     at most a partition's worth of scanning.  Opening with a frame size
+     appends; opening without one is for queries and writes nothing.
+
+     Index times are seconds of history and never go backwards.  Frame
+     timestamps start over with every run, so when one would go back
+     past the last entry, that entry's time becomes the new run's start:
+     later runs are shifted past earlier ones and each starts a partition
+     of its own.
+  */
+ public:
+  TrackIndex(double partition_seconds = 10.0);
+  ~TrackIndex();
+
+  bool open(const string& path, const CvSize& frame_size); // create, or continue an existing index
+  bool open(const string& path); // existing index, for queries
+  void close();
+  bool is_open() const;
+
+  void append(const TrackResult&); // the track box and segments of one frame
+  void append(const IndexEntry&); // timestamps going backwards start a new run
+
+  // entries of the given kinds touching region between from and to (inclusive)
+  int query(const CvRect& region, double from, double to,
+            vector<IndexEntry>& hits, int kinds = ENTRY_ANY);
+
+  // Access Functions
+  long entries() const;
+  int partitions() const;
+  const CvSize& frame_size() const;
+
+ private:
+  struct Partition{
+    double first_time, last_time;
+    uint64_t cells; // bit y * 8 + x for each grid cell touched
+    int64_t first; // index of the first entry
+    int64_t count;
+  };
+
+  double partition_seconds;
+  string path;
+  fstream data;
+  ofstream parts_out;
+  CvSize _frame_size;
+  vector<Partition> parts; // closed partitions, then the open one
+  bool have_open; // parts.back() is still being filled
+  int64_t _entries;
+  double time_offset; // added to timestamps of this run
+  vector<IndexEntry> block; // read buffer for queries
+
+  // methods
+  bool read_parts(const string& parts_path);
+  bool scan_tail();
+  void add_to_partition(const IndexEntry&, bool new_run = false);
+  void close_partition();
+  uint64_t cells_of(const CvRect&) const;
+
+  // not copyable
+  TrackIndex(const TrackIndex&);
+  TrackIndex& operator=(const TrackIndex&);
+};
+
+#endif
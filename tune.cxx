@@ -0,0 +1,365 @@
+/*
+ * tune.cxx - Parameter sweeps over a recorded session with ground truth
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * Every combination of the swept parameter values is run over the same
+ * recorded session by its own Tracker, several settings at a time on a
+ * pool of worker threads.  Keys recorded with the session are applied as
+ * they were, so -t is only needed when tracking was never switched on.
+ *
+ * The ground truth file has one line per annotated frame, frames
+ * counted from 1, with the upright box the object occupies:
+ *
+ *   frame  x  y  width  height
+ *
+ * A box with no area says there is nothing to follow in that frame.
+ * Frames that are not listed are processed but not scored.  A frame
+ * scores the IoU of the tracked box's bounds with its box, or 1 when
+ * both agree there is nothing to follow.
+ *
+ * Results are written one tab separated line per setting:
+ *
+ *   setting  frames  fps  mean_iou  tracked  pareto
+ *
+ * fps counts Tracker::process() time only, measured while the other
+ * workers run; use -j 1 when the timings themselves matter.  Settings
+ * no other setting beats on both fps and mean_iou are marked in the
+ * pareto column and listed again at the end, fastest first.
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "tracker.h"
+#include "session.h"
+#include "stats.h"	// monotonic clock
+#include "highgui.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <pthread.h>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// types
+struct TuneAxis{
+  string name;
+  vector<double> values;
+};
+
+struct TuneResult{
+  TrackParams params;
+  bool ok; // the session could be replayed
+  long frames; // frames processed
+  long scored; // frames with ground truth
+  long tracked; // frames CAMSHIFT followed something
+  double seconds; // spent in Tracker::process()
+  double iou_total;
+  bool pareto;
+
+  double fps() const{ return seconds > 0.0 ? frames / seconds : 0.0; }
+  double mean_iou() const{ return scored > 0 ? iou_total / scored : 0.0; }
+};
+
+struct TuneSweep{
+  string session_file;
+  TrackerOptions options; // params replaced by each setting
+  map<long, CvRect> truth;
+  vector<TuneResult> results;
+  size_t next; // next setting to run
+  pthread_mutex_t lock;
+};
+
+static bool read_truth(const string& file, map<long, CvRect>& truth){
+  ifstream in(file.c_str());
+  if (!in)
+    return false;
+
+  string line;
+  while (getline(in, line)){
+    if (line.empty() || line[0] == '#')
+      continue;
+    istringstream fields(line);
+    long frame;
+    CvRect box;
+    if (!(fields >> frame >> box.x >> box.y >> box.width >> box.height))
+      return false;
+    truth[frame] = box;
+  }
+
+  return !truth.empty();
+}
+
+static bool read_axis(const string& arg, TuneAxis& axis){
+  // name=v1,v2,...
+  size_t eq = arg.find('=');
+  if (eq == string::npos)
+    return false;
+
+  double value;
+  axis.name = arg.substr(0, eq);
+  if (!TrackParams().get(axis.name, value))
+    return false;
+
+  istringstream values(arg.substr(eq + 1));
+  string item;
+  while (getline(values, item, ',')){
+    char* end;
+    value = strtod(item.c_str(), &end);
+    if (item.empty() || *end)
+      return false;
+    axis.values.push_back(value);
+  }
+
+  return !axis.values.empty();
+}
+
+static void expand_grid(const vector<TuneAxis>& axes, vector<TuneResult>& results){
+  // every combination, the last axis changing fastest
+  vector<size_t> at(axes.size(), 0);
+  while (true){
+    TuneResult result;
+    for (size_t a = 0; a < axes.size(); ++a){
+      result.params.set(axes[a].name, axes[a].values[at[a]]);
+    }
+    result.ok = false;
+    result.frames = result.scored = result.tracked = 0;
+    result.seconds = result.iou_total = 0.0;
+    result.pareto = false;
+    results.push_back(result);
+
+    size_t a = axes.size();
+    while (a > 0 && ++at[a - 1] == axes[a - 1].values.size()){
+      at[a - 1] = 0;
+      --a;
+    }
+    if (a == 0)
+      break;
+  }
+}
+
+static void evaluate(const TuneSweep& sweep, TuneResult& result){
+  SessionReplay session(false);
+  if (!session.open(sweep.session_file))
+    return;
+
+  TrackerOptions options = sweep.options;
+  options.params = result.params;
+  Tracker tracker(options);
+
+  TrackResult found;
+  IplImage* frame;
+  double timestamp;
+  char key;
+  while ((frame = session.next_frame(timestamp))){
+    double started = monotonic_seconds();
+    tracker.process(frame_view(frame, timestamp), found);
+    result.seconds += monotonic_seconds() - started;
+    ++result.frames;
+    if (found.tracking)
+      ++result.tracked;
+
+    map<long, CvRect>::const_iterator truth = sweep.truth.find(result.frames);
+    if (truth != sweep.truth.end()){
+      const CvRect& box = truth->second;
+      bool present = box.width > 0 && box.height > 0;
+      if (present && found.tracking)
+        result.iou_total += rect_iou(box_rect(found.track_box), box);
+      else if (!present && !found.tracking)
+        result.iou_total += 1.0;
+      ++result.scored;
+    }
+
+    while (session.next_key(key)){
+      tracker.command(key);
+    }
+  }
+
+  result.ok = true;
+}
+
+static void* run_worker(void* arg){
+  TuneSweep* sweep = static_cast<TuneSweep*>(arg);
+  while (true){
+    pthread_mutex_lock(&sweep->lock);
+    size_t i = sweep->next++;
+    pthread_mutex_unlock(&sweep->lock);
+    if (i >= sweep->results.size())
+      break;
+
+    evaluate(*sweep, sweep->results[i]);
+  }
+  return NULL;
+}
+
+static void mark_pareto(vector<TuneResult>& results){
+  // a setting is on the front unless another is at least as good on
+  // both counts and better on one
+  for (size_t i = 0; i < results.size(); ++i){
+    TuneResult& r = results[i];
+    r.pareto = r.ok;
+    for (size_t j = 0; j < results.size() && r.pareto; ++j){
+      const TuneResult& o = results[j];
+      if (j == i || !o.ok)
+        continue;
+      if (o.fps() >= r.fps() && o.mean_iou() >= r.mean_iou() &&
+          (o.fps() > r.fps() || o.mean_iou() > r.mean_iou()))
+        r.pareto = false;
+    }
+  }
+}
+
+static bool faster(const TuneResult* a, const TuneResult* b){
+  return a->fps() > b->fps();
+}
+
+static void print_result(const TuneResult& r){
+  r.params.print(cout);
+  cout << "\t" << r.frames << "\t" << r.fps() << "\t" << r.mean_iou()
+       << "\t" << r.tracked << "\t" << (r.pareto ? "*" : "") << endl;
+}
+
+static int display_tune_syntax(){
+  cout << endl;
+  cout << "satori_tune: Sweep tracking parameters over a recorded session." << endl;
+  cout << endl;
+  cout << "Syntax: satori_tune -i session -g truth [-p name=v1,v2,... -j workers -t -f -d -s scale -E mask]" << endl;
+  cout << "  " << "-i (session)" << ": Session recorded with satori -R" << endl;
+  cout << "  " << "-g (truth)" << ": Ground truth boxes, one 'frame x y width height' line per frame" << endl;
+  cout << "  " << "-p (name=values)" << ": Values to sweep for one parameter, repeat for more" << endl;
+  cout << "  " << "-j (workers)" << ": Settings run at once (default: one per processor)" << endl;
+  cout << "  " << "-t" << ": Track from the first frame" << endl;
+  cout << "  " << "-f" << ": Follow feature points from the first frame" << endl;
+  cout << "  " << "-d" << ": Use feature point density for focus changes" << endl;
+  cout << "  " << "-s (scale)" << ": Process frames at this fraction of their size" << endl;
+  cout << "  " << "-E (image)" << ": Never process the regions that are black in this image" << endl;
+  cout << "  " << "-?" << ": Display this screen" << endl;
+  cout << endl;
+  cout << "Parameters:";
+  vector<string> names = TrackParams::names();
+  for (size_t i = 0; i < names.size(); ++i){
+    double value;
+    TrackParams().get(names[i], value);
+    cout << (i % 3 == 0 ? "\n  " : "  ") << names[i] << "=" << value;
+  }
+  cout << endl << endl;
+
+  return 0;
+}
+
+int main(int argc, char *argv[]){
+  TuneSweep sweep;
+  string truth_file;
+  vector<TuneAxis> axes;
+  long workers = sysconf(_SC_NPROCESSORS_ONLN);
+  IplImage* mask = NULL;
+
+  int optchar;
+  while((optchar = getopt(argc, argv, "i:g:p:j:tfds:E:?")) != -1){
+    switch(optchar){
+      case 'i':
+        sweep.session_file = optarg;
+        break;
+      case 'g':
+        truth_file = optarg;
+        break;
+      case 'p':{
+        TuneAxis axis;
+        if (!read_axis(optarg, axis)){
+          cerr << "Bad parameter sweep: " << optarg << endl;
+          return 1;
+        }
+        axes.push_back(axis);
+        break;
+      }
+      case 'j':
+        workers = atol(optarg);
+        break;
+      case 't':
+        sweep.options.track = true;
+        break;
+      case 'f':
+        sweep.options.flow = true;
+        break;
+      case 'd':
+        sweep.options.points_decide = true;
+        break;
+      case 's':
+        sweep.options.scale = atof(optarg);
+        break;
+      case 'E':
+        mask = cvLoadImage(optarg, CV_LOAD_IMAGE_GRAYSCALE);
+        if (!mask){
+          cerr << "Could not read mask image " << optarg << endl;
+          return 1;
+        }
+        sweep.options.mask = mask;
+        break;
+      default:
+      case '?':
+        return display_tune_syntax();
+    }
+  }
+
+  if (sweep.session_file.empty() || truth_file.empty())
+    return display_tune_syntax();
+  if (!read_truth(truth_file, sweep.truth)){
+    cerr << "Could not read ground truth from " << truth_file << endl;
+    return 1;
+  }
+
+  expand_grid(axes, sweep.results);
+  sweep.next = 0;
+  pthread_mutex_init(&sweep.lock, NULL);
+
+  // a pool of workers pulls settings until none are left
+  int count = (int)MIN(MAX(workers, 1L), (long)sweep.results.size()) - 1;
+  vector<pthread_t> threads(count);
+  vector<bool> started(count, false);
+  for (int i = 0; i < count; ++i){
+    started[i] = pthread_create(&threads[i], NULL, run_worker, &sweep) == 0;
+  }
+  run_worker(&sweep); // this thread is a worker too, the only one if none started
+  for (int i = 0; i < count; ++i){
+    if (started[i])
+      pthread_join(threads[i], NULL);
+  }
+  pthread_mutex_destroy(&sweep.lock);
+
+  mark_pareto(sweep.results);
+
+  cout << "# setting\tframes\tfps\tmean_iou\ttracked\tpareto" << endl;
+  cout << setprecision(3) << fixed;
+  bool failed = false;
+  vector<const TuneResult*> front;
+  for (size_t i = 0; i < sweep.results.size(); ++i){
+    const TuneResult& r = sweep.results[i];
+    if (!r.ok){
+      failed = true;
+      continue;
+    }
+    print_result(r);
+    if (r.pareto)
+      front.push_back(&r);
+  }
+
+  sort(front.begin(), front.end(), faster);
+  cout << "# pareto front, fastest first" << endl;
+  for (size_t i = 0; i < front.size(); ++i){
+    cout << "# ";
+    print_result(*front[i]);
+  }
+
+  if (mask)
+    cvReleaseImage(&mask);
+  if (failed)
+    cerr << "Could not replay " << sweep.session_file << endl;
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * workers.cxx - Implementation of WorkerPool class
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ * This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#include "workers.h"
+
+// Constructors
+
+WorkerPool::WorkerPool(){
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&work, NULL);
+  pthread_cond_init(&done, NULL);
+  task = NULL;
+  task_arg = NULL;
+  task_count = next_task = finished = 0;
+  generation = 0;
+  quit = false;
+}
+
+WorkerPool::~WorkerPool(){
+  stop();
+  pthread_cond_destroy(&work);
+  pthread_cond_destroy(&done);
+  pthread_mutex_destroy(&lock);
+}
+
+// Settings Functions
+
+void WorkerPool::set_threads(int threads){
+  if (threads < 1)
+    threads = 1;
+  if (threads == (int)pool.size() + 1)
+    return;
+
+  stop();
+  quit = false;
+  for (int i = 1; i < threads; ++i){
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, worker_main, this) != 0)
+      break; // fewer threads, the caller still gets everything done
+    pool.push_back(thread);
+  }
+}
+
+int WorkerPool::threads() const{
+  return (int)pool.size() + 1;
+}
+
+// Action Functions
+
+void WorkerPool::run(Task task_, void* arg, int count){
+  if (count <= 0)
+    return;
+  if (pool.empty()){
+    for (int i = 0; i < count; ++i){
+      task_(arg, i);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&lock);
+  task = task_;
+  task_arg = arg;
+  task_count = count;
+  next_task = 0;
+  finished = 0;
+  ++generation;
+  pthread_cond_broadcast(&work);
+  pthread_mutex_unlock(&lock);
+
+  work_through();
+
+  pthread_mutex_lock(&lock);
+  while (finished < task_count){
+    pthread_cond_wait(&done, &lock);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void* WorkerPool::worker_main(void* arg){
+  WorkerPool* workers = static_cast<WorkerPool*>(arg);
+  long seen = 0;
+  pthread_mutex_lock(&workers->lock);
+  seen = workers->generation;
+  while (true){
+    while (!workers->quit && workers->generation == seen){
+      pthread_cond_wait(&workers->work, &workers->lock);
+    }
+    if (workers->quit)
+      break;
+    seen = workers->generation;
+    pthread_mutex_unlock(&workers->lock);
+    workers->work_through();
+    pthread_mutex_lock(&workers->lock);
+  }
+  pthread_mutex_unlock(&workers->lock);
+  return NULL;
+}
+
+void WorkerPool::work_through(){
+  pthread_mutex_lock(&lock);
+  while (next_task < task_count){
+    int index = next_task++;
+    Task current = task;
+    void* current_arg = task_arg;
+    pthread_mutex_unlock(&lock);
+
+    current(current_arg, index);
+
+    pthread_mutex_lock(&lock);
+    if (++finished == task_count)
+      pthread_cond_broadcast(&done);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void WorkerPool::stop(){
+  pthread_mutex_lock(&lock);
+  quit = true;
+  pthread_cond_broadcast(&work);
+  pthread_mutex_unlock(&lock);
+  for (size_t i = 0; i < pool.size(); ++i){
+    pthread_join(pool[i], NULL);
+  }
+  pool.clear();
+}
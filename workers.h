@@ -0,0 +1,64 @@
+/*
+ * workers.h - Persistent worker threads for per-frame parallel work
+ * (c) 2008 Michael Sullivan and Matt Revelle
+ *
+ * Last Revised: 05/04/08
+ *
+ *  This program uses the Open Computer Vision Library (OpenCV)
+ *
+ */
+
+#ifndef _WORKERS_H_
+#define _WORKERS_H_
+
+// includes
+#include <pthread.h>
+#include <vector>
+
+// namespace preparation
+using namespace std;
+
+class WorkerPool{
+  /* Threads that wait between frames instead of being created for each
+     one.  run() hands a task function every index from 0 to count - 1,
+     each to whichever thread is free, and returns once all are done.
+     The calling thread takes tasks as well, so a pool of one thread has
+     no threads of its own and runs everything in order.
+  */
+ public:
+  typedef void (*Task)(void* arg, int index);
+
+  WorkerPool();
+  ~WorkerPool();
+
+  // Settings Functions
+  void set_threads(int threads); // counting the caller, 1 for none of its own
+  int threads() const;
+
+  // Action Functions
+  void run(Task, void* arg, int count);
+
+ private:
+  vector<pthread_t> pool;
+  pthread_mutex_t lock;
+  pthread_cond_t work; // a new run started, or quit
+  pthread_cond_t done; // the last task of a run finished
+  Task task;
+  void* task_arg;
+  int task_count;
+  int next_task;
+  int finished;
+  long generation; // runs started, so a thread takes part in each at most once
+  bool quit;
+
+  // methods
+  static void* worker_main(void*);
+  void work_through(); // take tasks of the current run until none are left
+  void stop();
+
+  // not copyable
+  WorkerPool(const WorkerPool&);
+  WorkerPool& operator=(const WorkerPool&);
+};
+
+#endif